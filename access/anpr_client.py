@@ -0,0 +1,249 @@
+#!/usr/bin/env python3
+"""
+Batched ANPR inference client
+
+Gates submit images as they arrive (submit() returns a Future); the client
+micro-batches every image that arrives within --window-ms of the first one
+(up to --max-batch) into a single multipart POST to /api/anpr/batch and
+resolves each Future with its own result, so one gate's answer never waits
+for another gate's request. Requests run on a small pool of persistent
+HTTP/1.1 connections, so several batches can be in flight at once.
+
+Batch request: multipart/form-data with one "image" part per image (its
+filename is the image ID, "{index}-{gate}.jpg"); the response is
+{"results": [...]} in part order, each entry shaped like the single-image
+/api/anpr response and echoing its part's filename as "image_id". A batch
+whose echoed IDs do not match the submitted parts fails as a whole, so a
+result is never handed to the wrong gate. If the server answers the batch
+endpoint with 404, the client falls back to one /api/anpr request per image
+over the same connection pool.
+
+Image bodies are sent straight from the caller's buffers (memoryviews from
+image_transport.decode_image() included) without being joined into one
+request body.
+
+Usage:
+    python access/anpr_client.py --url http://127.0.0.1:4000/api/anpr --bench --gates 8
+"""
+import argparse
+import json
+import queue
+import statistics
+import sys
+import threading
+import time
+import uuid
+from collections import deque
+from concurrent.futures import Future, ThreadPoolExecutor
+from typing import List, Optional, Tuple
+from urllib.parse import urlsplit
+
+from http_pool import ConnectionPool
+
+LATENCY_WINDOW = 4096
+
+
+def multipart_body(images: List[Tuple[str, object]], boundary: str) -> Tuple[list, int]:
+    """Multipart parts as a list of buffers (images are not copied) and the total length."""
+    chunks = []
+    for image_id, data in images:
+        chunks.append((f"--{boundary}\r\nContent-Disposition: form-data; name=\"image\"; filename=\"{image_id}\"\r\n"
+                       f"Content-Type: image/jpeg\r\n\r\n").encode())
+        chunks.append(data)
+        chunks.append(b"\r\n")
+    chunks.append(f"--{boundary}--\r\n".encode())
+    return chunks, sum(len(c) for c in chunks)
+
+
+def image_id(index: int, gate: str) -> str:
+    return f"{index}-{gate}.jpg"
+
+
+class _Pending:
+    __slots__ = ("gate", "image", "future", "submitted")
+
+    def __init__(self, gate, image, future, submitted):
+        self.gate = gate
+        self.image = image
+        self.future = future
+        self.submitted = submitted
+
+
+class BatchingANPRClient:
+    def __init__(self, url: str, pool_size: int = 4, max_batch: int = 8, window_ms: float = 5.0,
+                 batch: bool = True):
+        self.url = url.rstrip("/")
+        self.path = urlsplit(self.url).path or "/api/anpr"
+        self.pool = ConnectionPool(self.url, pool_size)
+        self.workers = ThreadPoolExecutor(max_workers=pool_size, thread_name_prefix="anpr")
+        self.max_batch = max_batch
+        self.window = window_ms / 1000.0
+        self.batch = batch
+        self.inbox: "queue.Queue[Optional[_Pending]]" = queue.Queue()
+        self.latency = deque(maxlen=LATENCY_WINDOW)  # s, submit -> result, latest images
+        self.requests = 0
+        self.images = 0
+        self.errors = 0
+        self._lock = threading.Lock()
+        self._collector = threading.Thread(target=self._collect, name="anpr-batcher", daemon=True)
+        self._collector.start()
+
+    def submit(self, gate: str, image) -> Future:
+        """Queue one image; the Future resolves to the ANPR result dict for it."""
+        fut: Future = Future()
+        self.inbox.put(_Pending(gate, image, fut, time.perf_counter()))
+        return fut
+
+    def _collect(self):
+        while True:
+            first = self.inbox.get()
+            if first is None:
+                return
+            batch = [first]
+            if self.batch:
+                deadline = time.perf_counter() + self.window
+                while len(batch) < self.max_batch:
+                    remaining = deadline - time.perf_counter()
+                    try:
+                        item = self.inbox.get(timeout=remaining) if remaining > 0 else self.inbox.get_nowait()
+                    except queue.Empty:
+                        break
+                    if item is None:
+                        self.inbox.put(None)
+                        break
+                    batch.append(item)
+            self.workers.submit(self._send, batch)
+
+    def _send(self, batch: List[_Pending]):
+        try:
+            if len(batch) > 1 and self.batch:
+                results = self._post_batch(batch)
+                if results is None:
+                    # No batch endpoint on this server
+                    self.batch = False
+                    results = [self._post_single(p) for p in batch]
+            else:
+                results = [self._post_single(p) for p in batch]
+        except Exception as e:
+            with self._lock:
+                self.errors += len(batch)
+            for p in batch:
+                p.future.set_exception(e)
+            return
+        done = time.perf_counter()
+        with self._lock:
+            self.images += len(batch)
+            self.latency.extend(done - p.submitted for p in batch)
+        for p, result in zip(batch, results):
+            p.future.set_result(result)
+
+    def _count_request(self):
+        with self._lock:
+            self.requests += 1
+
+    def _post_batch(self, batch: List[_Pending]) -> Optional[list]:
+        self._count_request()
+        boundary = uuid.uuid4().hex
+        ids = [image_id(i, p.gate) for i, p in enumerate(batch)]
+        body, length = multipart_body([(name, p.image) for name, p in zip(ids, batch)], boundary)
+        status, data = self.pool.request("POST", self.path + "/batch", body, {
+            "Content-Type": f"multipart/form-data; boundary={boundary}", "Content-Length": str(length)})
+        if status == 404:
+            return None
+        if status != 200:
+            raise RuntimeError(f"ANPR batch request failed: HTTP {status}")
+        results = json.loads(data)["results"]
+        if len(results) != len(batch):
+            raise RuntimeError(f"ANPR batch returned {len(results)} results for {len(batch)} images")
+        for name, result in zip(ids, results):
+            if result.get("image_id") != name:
+                raise RuntimeError(f"ANPR batch result for {result.get('image_id')!r} in the slot of {name!r}")
+        return results
+
+    def _post_single(self, p: _Pending) -> dict:
+        self._count_request()
+        boundary = uuid.uuid4().hex
+        name = image_id(0, p.gate)
+        body, length = multipart_body([(name, p.image)], boundary)
+        status, data = self.pool.request("POST", self.path, body, {
+            "Content-Type": f"multipart/form-data; boundary={boundary}", "Content-Length": str(length)})
+        if status != 200:
+            raise RuntimeError(f"ANPR request failed: HTTP {status}")
+        result = json.loads(data)
+        # One image per request: the reply cannot belong to another gate, but check an echoed ID anyway
+        if result.get("image_id", name) != name:
+            raise RuntimeError(f"ANPR result for {result.get('image_id')!r}, expected {name!r}")
+        return result
+
+    def stats(self) -> str:
+        with self._lock:
+            lat = sorted(self.latency)
+            requests, images, errors = self.requests, self.images, self.errors
+        if not lat:
+            return f"ANPR client: no results ({errors} errors)"
+        p99 = lat[min(len(lat) - 1, int(0.99 * len(lat)))]
+        return (f"ANPR client: {images} images in {requests} requests ({images / max(requests, 1):.1f} images/request), "
+                f"latency (last {len(lat)}) p50 {statistics.median(lat) * 1000:.1f} ms  p99 {p99 * 1000:.1f} ms  "
+                f"max {lat[-1] * 1000:.1f} ms, {errors} errors")
+
+    def close(self):
+        self.inbox.put(None)
+        self._collector.join()
+        self.workers.shutdown(wait=True)
+        self.pool.close()
+
+
+def bench(args) -> float:
+    """Gates fire together every --period s (peak entry); returns images/s."""
+    image = bytes(range(256)) * (args.image_kb * 4)
+    client = BatchingANPRClient(args.url, args.pool, args.max_batch, args.window_ms, batch=not args.no_batch)
+    futures = []
+    t0 = time.perf_counter()
+    for burst in range(args.bursts):
+        target = t0 + burst * args.period
+        delay = target - time.perf_counter()
+        if delay > 0:
+            time.sleep(delay)
+        for gate in range(1, args.gates + 1):
+            futures.append((str(gate), client.submit(str(gate), memoryview(image))))
+    mismatched = 0
+    for gate, f in futures:
+        try:
+            # The echoed image ID names the gate that submitted the image
+            if f.result(timeout=60).get("image_id", "").split("-", 1)[-1] != image_id(0, gate).split("-", 1)[-1]:
+                mismatched += 1
+        except RuntimeError:
+            pass    # counted in the client's errors
+    elapsed = time.perf_counter() - t0
+    client.close()
+    print(client.stats())
+    print(f"Throughput: {len(futures) / elapsed:.1f} images/s over {elapsed:.2f} s, "
+          f"results for another gate's image: {mismatched}")
+    return len(futures) / elapsed
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Batched ANPR inference client",
+                                     formatter_class=argparse.ArgumentDefaultsHelpFormatter)
+    parser.add_argument("--url", default="http://127.0.0.1:4000/api/anpr", help="Single-image ANPR endpoint")
+    parser.add_argument("--pool", type=int, default=4, help="Persistent connections (requests in flight)")
+    parser.add_argument("--max-batch", type=int, default=8, help="Max images per request")
+    parser.add_argument("--window-ms", type=float, default=5.0, help="Micro-batching window after the first image")
+    parser.add_argument("--no-batch", action="store_true", help="One image per request (baseline)")
+    parser.add_argument("--bench", action="store_true", help="Run the burst benchmark against --url")
+    parser.add_argument("--gates", type=int, default=8, help="Gates firing per burst")
+    parser.add_argument("--bursts", type=int, default=50, help="Number of bursts")
+    parser.add_argument("--period", type=float, default=0.2, help="Seconds between bursts")
+    parser.add_argument("--image-kb", type=int, default=45, help="Synthetic image size (KiB)")
+    args = parser.parse_args()
+    if not args.bench:
+        parser.error("nothing to do (use --bench, or import BatchingANPRClient)")
+    try:
+        bench(args)
+    except (OSError, RuntimeError) as e:
+        print(f"Error: {e}", file=sys.stderr)
+        sys.exit(1)
+
+
+if __name__ == "__main__":
+    main()
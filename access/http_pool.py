@@ -0,0 +1,46 @@
+"""
+Persistent HTTP/1.1 connection pool shared by the gate's clients
+
+Used by the ANPR client (anpr_client.py) and the access-log sync
+(log_sync.py): a fixed set of keep-alive connections to one host, each
+request takes an idle one and returns it afterwards, and a connection the
+server closed while idle is reopened once.
+"""
+import http.client
+import queue
+from typing import Tuple
+from urllib.parse import urlsplit
+
+
+class ConnectionPool:
+    """Persistent HTTP connections to one host, handed out one request at a time."""
+
+    def __init__(self, url: str, size: int = 4, timeout: float = 10.0):
+        parts = urlsplit(url)
+        self.host = parts.hostname
+        self.port = parts.port or (443 if parts.scheme == "https" else 80)
+        self.conn_cls = http.client.HTTPSConnection if parts.scheme == "https" else http.client.HTTPConnection
+        self.timeout = timeout
+        self.idle: "queue.LifoQueue[http.client.HTTPConnection]" = queue.LifoQueue()
+        for _ in range(size):
+            self.idle.put(self.conn_cls(self.host, self.port, timeout=timeout))
+
+    def request(self, method: str, path: str, body, headers: dict) -> Tuple[int, bytes]:
+        conn = self.idle.get()
+        try:
+            for attempt in (0, 1):
+                try:
+                    conn.request(method, path, body=body, headers=headers)
+                    resp = conn.getresponse()
+                    return resp.status, resp.read()
+                except (http.client.HTTPException, ConnectionError, OSError):
+                    # Server closed an idle keep-alive connection: reconnect once
+                    conn.close()
+                    if attempt:
+                        raise
+        finally:
+            self.idle.put(conn)
+
+    def close(self):
+        while not self.idle.empty():
+            self.idle.get_nowait().close()
@@ -0,0 +1,157 @@
+#!/usr/bin/env python3
+"""
+Binary image transport for gate/{id}/access
+
+Gate images used to travel as {"image": "<base64>"} JSON, 33% larger than the
+image and costing a JSON parse plus a base64 decode per frame on the
+receiver. The binary payload is a fixed header followed by the raw image:
+
+    [magic "GI"][version u8 = 1][encoding u8][gate u32][seq u32][time_us u64][image bytes...]
+
+(big endian, 20-byte header; encoding 1 = JPEG, 2 = PNG). decode_image()
+returns the header and a memoryview of the image inside the MQTT payload,
+so the receiver hands the bytes on without copying. Legacy JSON payloads
+are still accepted by decode_any() so gates can be migrated one at a time.
+
+Usage:
+    python access/image_transport.py --bench plate.jpg
+"""
+import argparse
+import base64
+import json
+import struct
+import sys
+import time
+from typing import Callable, Dict, NamedTuple, Optional, Tuple
+
+MAGIC = b"GI"
+VERSION = 1
+ENCODINGS = {"jpeg": 1, "png": 2}
+ENCODING_NAMES = {v: k for k, v in ENCODINGS.items()}
+
+_HEADER = struct.Struct(">2sBBIIQ")
+HEADER_SIZE = _HEADER.size
+
+
+class ImageHeader(NamedTuple):
+    gate: int
+    seq: int
+    time: float  # unix s, set by the gate at capture
+    encoding: str
+
+
+def encode_image(gate: int, seq: int, image: bytes, encoding: str = "jpeg", ts: Optional[float] = None) -> bytes:
+    ts = time.time() if ts is None else ts
+    header = _HEADER.pack(MAGIC, VERSION, ENCODINGS[encoding], gate & 0xFFFFFFFF, seq & 0xFFFFFFFF, int(ts * 1e6))
+    return header + image
+
+
+def decode_image(payload) -> Tuple[ImageHeader, memoryview]:
+    """Header and a zero-copy view of the image; raises ValueError if not a binary image payload."""
+    if len(payload) < HEADER_SIZE:
+        raise ValueError("payload shorter than the image header")
+    magic, version, encoding, gate, seq, ts_us = _HEADER.unpack_from(payload, 0)
+    if magic != MAGIC or version != VERSION:
+        raise ValueError("not a binary image payload")
+    if encoding not in ENCODING_NAMES:
+        raise ValueError(f"unknown image encoding {encoding}")
+    return ImageHeader(gate, seq, ts_us / 1e6, ENCODING_NAMES[encoding]), memoryview(payload)[HEADER_SIZE:]
+
+
+def decode_legacy(payload) -> bytes:
+    """Image bytes from the old {"image": "<base64>"} JSON payload."""
+    return base64.b64decode(json.loads(payload)["image"])
+
+
+def decode_any(payload) -> Tuple[Optional[ImageHeader], memoryview]:
+    """Binary payloads by header; anything starting with '{' as legacy JSON (header None)."""
+    if payload[:2] == MAGIC:
+        return decode_image(payload)
+    if payload[:1] == b"{":
+        try:
+            return None, memoryview(decode_legacy(payload))
+        except (KeyError, TypeError, ValueError) as e:
+            raise ValueError(f"bad legacy image payload: {e}") from e
+    raise ValueError("unrecognised access payload")
+
+
+class AccessImageReceiver:
+    """Subscribes to gate/+/access and passes (gate, header, image view) to `handler`.
+
+    The gate comes from the header, or from the topic for legacy payloads.
+    Sequence gaps per gate are counted as lost images.
+    """
+
+    def __init__(self, client, handler: Callable[[str, Optional[ImageHeader], memoryview], None],
+                 topic: str = "gate/+/access"):
+        self.client = client
+        self.handler = handler
+        self.topic = topic
+        self.last_seq: Dict[str, int] = {}
+        self.images = 0
+        self.legacy = 0
+        self.lost = 0
+        self.invalid = 0
+        client.message_callback_add(topic, self._on_message)
+
+    def subscribe(self, qos: int = 1):
+        self.client.subscribe(self.topic, qos=qos)
+
+    def _on_message(self, client, userdata, msg):
+        try:
+            header, image = decode_any(msg.payload)
+        except ValueError as e:
+            self.invalid += 1
+            print(f"Invalid access payload on {msg.topic}: {e}")
+            return
+        if header is None:
+            self.legacy += 1
+            gate = msg.topic.split("/")[1]
+        else:
+            gate = str(header.gate)
+            last = self.last_seq.get(gate)
+            if last is not None:
+                gap = (header.seq - last - 1) & 0xFFFFFFFF
+                if gap < 0x80000000:
+                    self.lost += gap
+            self.last_seq[gate] = header.seq
+        self.images += 1
+        self.handler(gate, header, image)
+
+
+def bench(path: str, iterations: int):
+    with open(path, "rb") as f:
+        image = f.read()
+    legacy = json.dumps({"image": base64.b64encode(image).decode("utf-8")}).encode()
+    binary = encode_image(1, 0, image)
+
+    def per_call_us(fn, payload):
+        t0 = time.perf_counter()
+        for _ in range(iterations):
+            fn(payload)
+        return (time.perf_counter() - t0) / iterations * 1e6
+
+    t_legacy = per_call_us(decode_legacy, legacy)
+    t_binary = per_call_us(decode_image, binary)
+    print(f"Image: {path} ({len(image)} bytes), {iterations} decodes per format")
+    print(f"  json+base64  {len(legacy):9d} bytes on the wire ({len(legacy) / len(image) - 1:+.1%})  "
+          f"decode {t_legacy:9.2f} us/image")
+    print(f"  binary       {len(binary):9d} bytes on the wire ({len(binary) / len(image) - 1:+.1%})  "
+          f"decode {t_binary:9.2f} us/image")
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Binary gate image payloads")
+    parser.add_argument("--bench", metavar="IMAGE", required=True,
+                        help="Compare wire size and decode time of the JSON/base64 and binary formats")
+    parser.add_argument("--iterations", type=int, default=1000, help="Decodes per format")
+    args = parser.parse_args()
+    try:
+        bench(args.bench, args.iterations)
+    except OSError as e:
+        print(f"Error: {e}", file=sys.stderr)
+        sys.exit(1)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,125 @@
+"""
+Local access-log store of a gate (SQLite)
+
+pending_logs keeps every access decision until the server has it:
+    (id, plate_number, gate_id, timestamp, access_granted, confidence_score, sync_status)
+`id` is AUTOINCREMENT, so it only grows and is never reused, even after rows
+are deleted; the sync engine uses it as its watermark (sync_state.watermark
+= highest id the server has acknowledged). `device` is a random ID created
+with the database, so (device, id) is a globally unique idempotency key.
+
+A database from before the watermark (rows already marked 'synced' by the
+old per-row sync) starts at the highest synced id below its first unsynced
+row, so the first run does not upload the whole history again; synced rows
+above that are re-sent and recognised by their keys.
+
+The class keeps the SQLiteDB name and create_access_log() signature that
+tests/test_log_sync.py uses.
+"""
+import os
+import sqlite3
+import threading
+import uuid
+from datetime import datetime
+from typing import Callable, List, Optional, Tuple
+
+Row = Tuple[int, str, str, str, int, float, str]
+
+_SCHEMA = """
+CREATE TABLE IF NOT EXISTS pending_logs (
+    id INTEGER PRIMARY KEY AUTOINCREMENT,
+    plate_number TEXT NOT NULL,
+    gate_id TEXT NOT NULL,
+    timestamp TEXT NOT NULL,
+    access_granted INTEGER NOT NULL,
+    confidence_score REAL,
+    sync_status TEXT NOT NULL DEFAULT 'pending'
+);
+CREATE TABLE IF NOT EXISTS sync_state (
+    key TEXT PRIMARY KEY,
+    value TEXT NOT NULL
+);
+"""
+
+
+class SQLiteDB:
+    """Thread-safe access-log store; each thread gets its own connection."""
+
+    def __init__(self, path: str = "instance/local_gate.db"):
+        self.path = path
+        if os.path.dirname(path):
+            os.makedirs(os.path.dirname(path), exist_ok=True)
+        self._local = threading.local()
+        self._listeners: List[Callable[[int], None]] = []
+        conn = self._conn()
+        with conn:
+            conn.executescript(_SCHEMA)
+            conn.execute(
+                "INSERT OR IGNORE INTO sync_state (key, value) "
+                "SELECT 'watermark', COALESCE(MAX(id), 0) FROM pending_logs WHERE sync_status = 'synced' "
+                "AND id < COALESCE((SELECT MIN(id) FROM pending_logs WHERE sync_status != 'synced'), "
+                "9223372036854775807)")
+            conn.execute("INSERT OR IGNORE INTO sync_state (key, value) VALUES ('device', ?)", (uuid.uuid4().hex,))
+        self.device = conn.execute("SELECT value FROM sync_state WHERE key = 'device'").fetchone()[0]
+
+    def _conn(self) -> sqlite3.Connection:
+        conn = getattr(self._local, "conn", None)
+        if conn is None:
+            conn = sqlite3.connect(self.path, timeout=10.0)
+            conn.execute("PRAGMA journal_mode=WAL")
+            conn.execute("PRAGMA synchronous=NORMAL")
+            self._local.conn = conn
+        return conn
+
+    def on_new_log(self, callback: Callable[[int], None]):
+        """Call `callback(log_id)` after each committed create_access_log() (wakes the sync engine)."""
+        self._listeners.append(callback)
+
+    def create_access_log(self, plate_number: str, gate_id: str, access_granted: bool,
+                          confidence_score: Optional[float] = None, timestamp: Optional[datetime] = None) -> int:
+        conn = self._conn()
+        with conn:
+            cur = conn.execute(
+                "INSERT INTO pending_logs (plate_number, gate_id, timestamp, access_granted, confidence_score) "
+                "VALUES (?, ?, ?, ?, ?)",
+                (plate_number, gate_id, (timestamp or datetime.now()).isoformat(), int(access_granted),
+                 confidence_score))
+        log_id = cur.lastrowid
+        for callback in self._listeners:
+            callback(log_id)
+        return log_id
+
+    def watermark(self) -> int:
+        return int(self._conn().execute("SELECT value FROM sync_state WHERE key = 'watermark'").fetchone()[0])
+
+    def pending_after(self, watermark: int, limit: int) -> List[Row]:
+        """Rows above the watermark in id order (a primary-key range scan)."""
+        return self._conn().execute(
+            "SELECT id, plate_number, gate_id, timestamp, access_granted, confidence_score, sync_status "
+            "FROM pending_logs WHERE id > ? ORDER BY id LIMIT ?", (watermark, limit)).fetchall()
+
+    def backlog(self, watermark: int) -> Tuple[int, Optional[str]]:
+        """(rows above the watermark, timestamp of the oldest one)."""
+        conn = self._conn()
+        count = conn.execute("SELECT COUNT(*) FROM pending_logs WHERE id > ?", (watermark,)).fetchone()[0]
+        oldest = conn.execute("SELECT timestamp FROM pending_logs WHERE id > ? ORDER BY id LIMIT 1",
+                              (watermark,)).fetchone()
+        return count, oldest[0] if oldest else None
+
+    def acknowledge(self, first_id: int, last_id: int, delete: bool = False):
+        """Mark (or delete) rows first_id..last_id and advance the watermark, in one transaction."""
+        conn = self._conn()
+        with conn:
+            if delete:
+                conn.execute("DELETE FROM pending_logs WHERE id BETWEEN ? AND ?", (first_id, last_id))
+            else:
+                conn.execute("UPDATE pending_logs SET sync_status = 'synced' WHERE id BETWEEN ? AND ?",
+                             (first_id, last_id))
+            conn.execute("UPDATE sync_state SET value = ? WHERE key = 'watermark' AND CAST(value AS INTEGER) < ?",
+                         (str(last_id), last_id))
+
+    def close(self):
+        conn = getattr(self._local, "conn", None)
+        if conn is not None:
+            conn.close()
+            self._local.conn = None
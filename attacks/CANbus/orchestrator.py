@@ -0,0 +1,168 @@
+#!/usr/bin/env python3
+"""
+Multi-process attack fan-out across CAN interfaces
+
+Spawns one can_attacks.py sender process per (interface, stream), releases
+them together through a shared start barrier, and merges their ground-truth
+CSV logs into one time-ordered log with the originating channel and stream.
+
+Usage:
+    python attacks/CANbus/orchestrator.py --channels vcan0,vcan1 --per-channel 2 \
+        -- fuzz --bus-type socketcan --saturate --duration 10 --seed 7
+
+Everything after `--` is a normal can_attacks.py command line; the
+orchestrator overrides --channel, --stream and --log for each sender.
+
+IMPORTANT: Use only on an isolated testbed with explicit authorization.
+"""
+import argparse
+import csv
+import heapq
+import multiprocessing as mp
+import os
+import sys
+import threading
+import time
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+import can_attacks  # noqa: E402
+
+
+START_MARGIN_S = 0.1
+BARRIER_TIMEOUT_S = 30.0
+
+
+def sender_main(attack_argv, channel, stream, log_path, barrier, start_at, cpu):
+    """Child process: parse the attack command line for this stream and run it from the common start time."""
+    if cpu is not None and hasattr(os, "sched_setaffinity"):
+        os.sched_setaffinity(0, {cpu})
+    argv = list(attack_argv) + ["--channel", channel, "--stream", str(stream), "--log", log_path]
+    args = can_attacks.build_parser().parse_args(argv)
+
+    def ready():
+        # The barrier only says every sender has its bus open; wake-up order
+        # after it is up to the scheduler, so all senders also sleep until the
+        # start time the parent publishes once the barrier trips
+        barrier.wait()
+        while start_at.value == 0.0:
+            time.sleep(0.001)
+        delay = start_at.value - time.time()
+        if delay > 0:
+            time.sleep(delay)
+
+    can_attacks.run_attack(args, ready=ready)
+
+
+def merge_logs(streams, out_path):
+    """Merge per-stream attack logs (each already time-ordered) into one CSV; returns per-stream frame counts."""
+    counts = {}
+
+    def rows(channel, stream, path):
+        n = 0
+        with open(path, newline="") as f:
+            reader = csv.reader(f)
+            next(reader, None)
+            for row in reader:
+                n += 1
+                yield float(row[0]), channel, stream, row
+        counts[(channel, stream)] = n
+
+    sources = [rows(ch, st, path) for ch, st, path in streams if os.path.exists(path)]
+    os.makedirs(os.path.dirname(os.path.abspath(out_path)), exist_ok=True)
+    first_ts = last_ts = None
+    with open(out_path, "w", newline="") as f:
+        writer = csv.writer(f)
+        writer.writerow(["timestamp", "channel", "stream", "attack", "id", "is_extended", "dlc", "data_hex", "note"])
+        for ts, channel, stream, row in heapq.merge(*sources, key=lambda r: r[0]):
+            if first_ts is None:
+                first_ts = ts
+            last_ts = ts
+            writer.writerow([row[0], channel, stream] + row[1:])
+    return counts, first_ts, last_ts
+
+
+def main():
+    argv = sys.argv[1:]
+    if "--" not in argv:
+        print("usage: orchestrator.py [options] -- <can_attacks.py attack arguments>", file=sys.stderr)
+        sys.exit(2)
+    split = argv.index("--")
+    own_argv, attack_argv = argv[:split], argv[split + 1:]
+
+    parser = argparse.ArgumentParser(description="Multi-process, multi-interface CAN attack fan-out (research use only)",
+                                     formatter_class=argparse.ArgumentDefaultsHelpFormatter)
+    parser.add_argument("--channels", required=True, help="Comma-separated interfaces (e.g., vcan0,vcan1)")
+    parser.add_argument("--per-channel", type=int, default=1, help="Sender processes (independent streams) per interface")
+    parser.add_argument("--log-dir", default=os.path.join(os.path.dirname(__file__), "logs", "orchestrator"), help="Directory for per-stream logs")
+    parser.add_argument("--out", default=None, help="Merged log path (default: <log-dir>/merged.csv)")
+    parser.add_argument("--pin", action="store_true", help="Pin each sender to its own CPU core")
+    args = parser.parse_args(own_argv)
+    # Validate the attack command line once before spawning anything
+    can_attacks.build_parser().parse_args(attack_argv)
+
+    channels = [c for c in args.channels.split(",") if c]
+    os.makedirs(args.log_dir, exist_ok=True)
+    out_path = args.out or os.path.join(args.log_dir, "merged.csv")
+    streams = []
+    for ch in channels:
+        for k in range(args.per_channel):
+            stream = len(streams)
+            path = os.path.join(args.log_dir, f"{ch}_{stream}.csv")
+            # Never merge a stale log from an earlier run
+            if os.path.exists(path):
+                os.remove(path)
+            streams.append((ch, stream, path))
+
+    ncpu = os.cpu_count() or 1
+    barrier = mp.Barrier(len(streams) + 1)
+    start_at = mp.Value("d", 0.0)
+    procs = []
+    for i, (ch, stream, path) in enumerate(streams):
+        cpu = i % ncpu if args.pin else None
+        p = mp.Process(target=sender_main, args=(attack_argv, ch, stream, path, barrier, start_at, cpu), name=f"sender-{ch}-{stream}")
+        p.start()
+        procs.append(p)
+    print(f"Started {len(procs)} senders on {', '.join(channels)}")
+
+    def watch_startup():
+        # A sender that dies before the barrier (e.g., the bus failed to open)
+        # would leave everyone waiting; abort the barrier instead
+        while start_at.value == 0.0:
+            if any(p.exitcode is not None for p in procs):
+                barrier.abort()
+                return
+            time.sleep(0.05)
+
+    threading.Thread(target=watch_startup, daemon=True).start()
+    try:
+        try:
+            barrier.wait(timeout=BARRIER_TIMEOUT_S)
+        except threading.BrokenBarrierError:
+            print("Start barrier broken: not every sender came up", file=sys.stderr)
+        start_at.value = time.time() + START_MARGIN_S
+        for p in procs:
+            p.join()
+    except KeyboardInterrupt:
+        # Children receive the same SIGINT and close their logs
+        for p in procs:
+            p.join()
+
+    failed = [p.name for p in procs if p.exitcode not in (0, None)]
+    if failed:
+        print(f"Senders exited with errors: {', '.join(failed)}", file=sys.stderr)
+
+    counts, first_ts, last_ts = merge_logs(streams, out_path)
+    total = sum(counts.values())
+    span = (last_ts - first_ts) if total > 1 else 0.0
+    print("\n=== ORCHESTRATOR SUMMARY ===")
+    for (ch, stream), n in sorted(counts.items(), key=lambda kv: kv[0][1]):
+        print(f"{ch} stream {stream}: {n} frames")
+    if span > 0:
+        print(f"Aggregate: {total} frames in {span:.2f}s, {total / span:.0f} frames/s")
+    else:
+        print(f"Aggregate: {total} frames")
+    print(f"Merged log: {out_path}")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,193 @@
+"""
+Raw SocketCAN transmit path for the attack toolkit.
+
+Frames live in a preallocated NumPy array laid out exactly as the kernel's
+`struct can_frame`, so a send is one `socket.send()` on a precomputed
+memoryview slot: no `can.Message`, no per-frame `struct.pack`, no payload
+`bytes`. Generators refill the pool in place, one block at a time.
+
+Batched transmit uses sendmmsg(2) through ctypes (Python's socket module has
+no binding): one `struct mmsghdr` per pool slot is built once, pointing at the
+slot's bytes, so a batch of N frames costs one syscall.
+
+Linux only (AF_CAN); callers fall back to python-can elsewhere.
+"""
+import ctypes
+import ctypes.util
+import errno
+import select
+import socket
+import time
+from typing import Optional
+
+import numpy as np
+
+CAN_EFF_FLAG = 0x80000000
+CAN_SFF_MASK = 0x7FF
+CAN_EFF_MASK = 0x1FFFFFFF
+
+# struct can_frame { canid_t can_id; __u8 len; __u8 __pad; __u8 __res0; __u8 len8_dlc; __u8 data[8]; }
+CAN_FRAME_DTYPE = np.dtype([
+    ("can_id", "=u4"),
+    ("len", "u1"),
+    ("pad", "u1"),
+    ("res0", "u1"),
+    ("len8_dlc", "u1"),
+    ("data", "u1", (8,)),
+])
+CAN_FRAME_SIZE = CAN_FRAME_DTYPE.itemsize  # 16
+
+
+def raw_available() -> bool:
+    return hasattr(socket, "AF_CAN") and hasattr(socket, "CAN_RAW")
+
+
+def frame_fields(frames: np.ndarray):
+    """Split packed frames into (ids, extended, dlc, data) arrays."""
+    can_id = frames["can_id"]
+    ext = (can_id & CAN_EFF_FLAG) != 0
+    ids = np.where(ext, can_id & CAN_EFF_MASK, can_id & CAN_SFF_MASK)
+    return ids, ext, frames["len"], frames["data"]
+
+
+class FramePool:
+    """Preallocated struct can_frame array with one memoryview per slot."""
+
+    def __init__(self, size: int):
+        self.size = size
+        self.frames = np.zeros(size, dtype=CAN_FRAME_DTYPE)
+        raw = memoryview(self.frames.view(np.uint8))
+        self.views = [raw[i * CAN_FRAME_SIZE:(i + 1) * CAN_FRAME_SIZE] for i in range(size)]
+
+
+class _IOVec(ctypes.Structure):
+    _fields_ = [("iov_base", ctypes.c_void_p), ("iov_len", ctypes.c_size_t)]
+
+
+class _MsgHdr(ctypes.Structure):
+    _fields_ = [
+        ("msg_name", ctypes.c_void_p),
+        ("msg_namelen", ctypes.c_uint32),
+        ("msg_iov", ctypes.POINTER(_IOVec)),
+        ("msg_iovlen", ctypes.c_size_t),
+        ("msg_control", ctypes.c_void_p),
+        ("msg_controllen", ctypes.c_size_t),
+        ("msg_flags", ctypes.c_int),
+    ]
+
+
+class _MMsgHdr(ctypes.Structure):
+    _fields_ = [("msg_hdr", _MsgHdr), ("msg_len", ctypes.c_uint)]
+
+
+_MMSGHDR_SIZE = ctypes.sizeof(_MMsgHdr)
+_libc = None
+
+
+def _sendmmsg_func():
+    global _libc
+    if _libc is None:
+        _libc = ctypes.CDLL(ctypes.util.find_library("c") or None, use_errno=True)
+    fn = getattr(_libc, "sendmmsg", None)
+    if fn is not None:
+        fn.argtypes = [ctypes.c_int, ctypes.c_void_p, ctypes.c_uint, ctypes.c_int]
+        fn.restype = ctypes.c_int
+    return fn
+
+
+def batch_available() -> bool:
+    return _sendmmsg_func() is not None
+
+
+class RawCANSender:
+    """Sends pool slots on a CAN_RAW socket, waiting out ENOBUFS backpressure.
+
+    `syscalls` counts send attempts so callers can report syscalls per frame.
+    When a pool is given, send_batch() transmits consecutive slots with sendmmsg.
+    Backpressure is waited out until `deadline` (time.time()), if set: on a bus
+    where no node ACKs the queue never drains, and the attack must still end.
+    """
+
+    def __init__(self, channel: str, drain_s: float = 0.001, sock: Optional[socket.socket] = None,
+                 pool: Optional[FramePool] = None, deadline: Optional[float] = None):
+        if sock is None:
+            sock = socket.socket(socket.AF_CAN, socket.SOCK_RAW, socket.CAN_RAW)
+            sock.bind((channel,))
+        self.sock = sock
+        self.drain_s = drain_s
+        self.deadline = deadline
+        self.enobufs = 0
+        self.failed = 0
+        self.syscalls = 0
+        self._send = sock.send
+        self._pool = pool
+        self._hdrs = None
+        if pool is not None:
+            self._build_headers(pool)
+
+    def _build_headers(self, pool: FramePool):
+        self._sendmmsg = _sendmmsg_func()
+        if self._sendmmsg is None:
+            raise OSError(errno.ENOSYS, "sendmmsg is not available")
+        base = pool.frames.ctypes.data
+        self._iovs = (_IOVec * pool.size)()
+        self._hdrs = (_MMsgHdr * pool.size)()
+        for i in range(pool.size):
+            self._iovs[i].iov_base = base + i * CAN_FRAME_SIZE
+            self._iovs[i].iov_len = CAN_FRAME_SIZE
+            self._hdrs[i].msg_hdr.msg_iov = ctypes.pointer(self._iovs[i])
+            self._hdrs[i].msg_hdr.msg_iovlen = 1
+        self._hdrs_addr = ctypes.addressof(self._hdrs)
+
+    def _wait_writable(self) -> bool:
+        """Wait for queue space; False once the deadline has passed."""
+        if self.deadline is not None and time.time() >= self.deadline:
+            return False
+        # Raw CAN sockets report a full qdisc as ENOBUFS without blocking
+        if not select.select([], [self.sock], [], self.drain_s)[1]:
+            time.sleep(0)
+        return True
+
+    def _fail(self, err):
+        if self.failed == 0:
+            print(f"Send failed: {err}")
+        self.failed += 1
+
+    def send(self, view) -> bool:
+        """Send one packed frame; retries on ENOBUFS until the deadline, returns False on other errors."""
+        while True:
+            self.syscalls += 1
+            try:
+                self._send(view)
+                return True
+            except OSError as e:
+                if e.errno not in (errno.ENOBUFS, errno.EAGAIN):
+                    self._fail(e)
+                    return False
+                self.enobufs += 1
+            if not self._wait_writable():
+                return False
+
+    def send_batch(self, start: int, count: int) -> int:
+        """Send pool slots [start, start + count) with sendmmsg; returns how many were sent."""
+        fd = self.sock.fileno()
+        done = 0
+        while done < count:
+            self.syscalls += 1
+            r = self._sendmmsg(fd, self._hdrs_addr + (start + done) * _MMSGHDR_SIZE, count - done, 0)
+            if r > 0:
+                done += r
+                continue
+            err = ctypes.get_errno()
+            if err == errno.EINTR:
+                continue
+            if err not in (errno.ENOBUFS, errno.EAGAIN):
+                self._fail(OSError(err, errno.errorcode.get(err, "sendmmsg failed")))
+                return done
+            self.enobufs += 1
+            if not self._wait_writable():
+                return done
+        return done
+
+    def close(self):
+        self.sock.close()
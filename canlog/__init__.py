@@ -0,0 +1,3 @@
+"""
+Shared CAN capture I/O used by the attack toolkit and the NIDS.
+"""
@@ -0,0 +1,233 @@
+"""
+Bulk candump log parser
+
+Parses candump log files (`candump -l` format) in large buffers, yielding
+NumPy structured arrays instead of per-line tuples. Well-formed buffers take a
+split-and-join fast path with vectorized hex decoding; buffers containing
+comments, blank or malformed lines fall back to one compiled-regex pass.
+Malformed lines are counted and reported rather than silently dropped.
+
+Line format: (1633024800.123456) can0 123#0102030405060708
+The timestamp is optional; lines without one are stamped with the parse time.
+"""
+import re
+import time
+from typing import Iterator, List, Optional, Tuple
+
+import numpy as np
+
+# One row per classic CAN frame; data is zero-padded to 8 bytes, dlc gives the valid length
+FRAME_DTYPE = np.dtype([
+    ("ts", np.float64),
+    ("id", np.uint32),
+    ("ext", np.bool_),
+    ("dlc", np.uint8),
+    ("data", np.uint8, (8,)),
+])
+
+_FRAME_RE = re.compile(
+    rb"^[ \t]*(?:\(([0-9]+(?:\.[0-9]*)?)\)[ \t]+)?\S+[ \t]+([0-9A-Fa-f]{1,8})#((?:[0-9A-Fa-f]{2}){0,8})[ \t]*\r?$",
+    re.MULTILINE,
+)
+_SKIP_RE = re.compile(rb"^[ \t]*(?:#.*)?\r?$", re.MULTILINE)
+
+
+def _parse_fast(buf: bytes) -> Optional[np.ndarray]:
+    """Fast path for buffers made only of "(ts) iface ID#DATA" lines; None if the buffer does not fit."""
+    tokens = buf.split()
+    n = buf.count(b"\n")
+    if n == 0 or len(tokens) != 3 * n:
+        return None
+    ts_join = b"".join(tokens[0::3])
+    if ts_join.count(b"(") != n or ts_join.count(b")") != n:
+        return None
+    ts = np.array(ts_join[1:-1].split(b")("))
+    parts = b"#".join(tokens[2::3]).split(b"#")
+    if len(parts) != 2 * n:
+        return None
+    ids, datas = parts[0::2], parts[1::2]
+    id_len = np.fromiter(map(len, ids), dtype=np.int64, count=n)
+    data_len = np.fromiter(map(len, datas), dtype=np.int64, count=n)
+    if id_len.min() == 0 or id_len.max() > 8 or data_len.max() > 16 or (data_len & 1).any():
+        return None
+    try:
+        out = np.zeros(n, dtype=FRAME_DTYPE)
+        out["ts"] = ts.astype(np.float64)
+        # Captures are usually uniform (one ID width, one DLC), which lets the
+        # padding be done by a single join instead of per-line rjust/ljust
+        if id_len.min() == id_len.max():
+            pad = b"0" * (8 - int(id_len[0]))
+            id_hex = pad + pad.join(ids)
+        else:
+            id_hex = b"".join(i.rjust(8, b"0") for i in ids)
+        out["id"] = np.frombuffer(bytes.fromhex(id_hex.decode("ascii")), dtype=">u4")
+        if data_len.min() == data_len.max():
+            width = int(data_len[0]) >> 1
+            if width:
+                raw = bytes.fromhex(b"".join(datas).decode("ascii"))
+                out["data"][:, :width] = np.frombuffer(raw, dtype=np.uint8).reshape(n, width)
+        else:
+            data_hex = b"".join(d.ljust(16, b"0") for d in datas)
+            out["data"] = np.frombuffer(bytes.fromhex(data_hex.decode("ascii")), dtype=np.uint8).reshape(n, 8)
+    except ValueError:
+        return None
+    out["ext"] = (id_len == 8) | (out["id"] > 0x7FF)
+    out["dlc"] = data_len >> 1
+    return out
+
+
+def parse_buffer(buf: bytes) -> np.ndarray:
+    """Parse a buffer of complete candump lines into a FRAME_DTYPE array (malformed lines are ignored)."""
+    fast = _parse_fast(buf)
+    if fast is not None:
+        return fast
+    matches = _FRAME_RE.findall(buf)
+    n = len(matches)
+    out = np.zeros(n, dtype=FRAME_DTYPE)
+    if n == 0:
+        return out
+    ts_field, id_field, data_field = zip(*matches)
+    if all(ts_field):
+        out["ts"] = np.array(ts_field).astype(np.float64)
+    else:
+        now = time.time()
+        out["ts"] = [float(t) if t else now for t in ts_field]
+    out["id"] = [int(i, 16) for i in id_field]
+    # candump writes extended IDs with 8 hex digits
+    out["ext"] = [len(i) == 8 for i in id_field]
+    out["ext"] |= out["id"] > 0x7FF
+    out["dlc"] = [len(d) >> 1 for d in data_field]
+    padded = b"".join(d.ljust(16, b"0") for d in data_field)
+    out["data"] = np.frombuffer(bytes.fromhex(padded.decode("ascii")), dtype=np.uint8).reshape(n, 8)
+    return out
+
+
+class CandumpReader:
+    """Iterate a candump log as FRAME_DTYPE arrays, one per buffer of lines.
+
+    Malformed (non-blank, non-comment, unparseable) lines are counted in
+    `malformed_count`; the first `max_reported` are kept in `malformed` as
+    (line number, text) pairs.
+
+    `start` / `end` restrict the reader to the lines that begin in that byte
+    range, so a file can be split at arbitrary offsets and read by several
+    workers without losing or duplicating a line (line numbers in reports
+    are then relative to the first line of the range).
+    """
+
+    def __init__(self, path: str, chunk_size: int = 1 << 22, max_reported: int = 20,
+                 start: int = 0, end: Optional[int] = None):
+        self.path = path
+        self.chunk_size = chunk_size
+        self.start = start
+        self.end = end
+        self.max_reported = max_reported
+        self.malformed_count = 0
+        self.malformed: List[Tuple[int, str]] = []
+        self.frame_count = 0
+
+    def __iter__(self) -> Iterator[np.ndarray]:
+        lineno = 0
+        tail = b""
+        with open(self.path, "rb") as f:
+            offset = self._seek_line(f)
+            end = self.end
+            while True:
+                chunk = f.read(self.chunk_size)
+                if not chunk:
+                    break
+                buf = tail + chunk
+                cut = buf.rfind(b"\n") + 1
+                if cut == 0:
+                    tail = buf
+                    continue
+                if end is not None and offset + cut >= end:
+                    # Last buffer of the range: up to the end of the line that holds byte end - 1
+                    cut = buf.find(b"\n", max(end - offset - 1, 0)) + 1
+                    yield self._parse(buf[:cut], lineno)
+                    return
+                buf, tail = buf[:cut], buf[cut:]
+                yield self._parse(buf, lineno)
+                lineno += buf.count(b"\n")
+                offset += cut
+        if tail:
+            yield self._parse(tail + b"\n", lineno)
+
+    def _seek_line(self, f) -> int:
+        """Position f at the first line starting at or after self.start; returns that offset."""
+        if self.start <= 0:
+            return 0
+        f.seek(self.start - 1)
+        if f.read(1) == b"\n":
+            return self.start
+        f.readline()
+        return f.tell()
+
+    def _parse(self, buf: bytes, lineno: int) -> np.ndarray:
+        frames = _parse_fast(buf)
+        if frames is not None:
+            self.frame_count += len(frames)
+            return frames
+        frames = parse_buffer(buf)
+        self.frame_count += len(frames)
+        lines = buf.count(b"\n")
+        skipped = len(_SKIP_RE.findall(buf))
+        # The MULTILINE skip pattern also matches the empty remainder after the final newline
+        if buf.endswith(b"\n"):
+            skipped -= 1
+        bad = lines - skipped - len(frames)
+        if bad > 0:
+            self.malformed_count += bad
+            if len(self.malformed) < self.max_reported:
+                self._collect_malformed(buf, lineno)
+        return frames
+
+    def _collect_malformed(self, buf: bytes, lineno: int):
+        # Slow path, only taken for buffers that contain malformed lines
+        for i, line in enumerate(buf.split(b"\n")[:-1]):
+            if _SKIP_RE.match(line) or _FRAME_RE.match(line):
+                continue
+            self.malformed.append((lineno + i + 1, line.decode("ascii", errors="replace").strip()))
+            if len(self.malformed) >= self.max_reported:
+                return
+
+    def report(self) -> Optional[str]:
+        """Human-readable summary of malformed lines, or None if there were none."""
+        if not self.malformed_count:
+            return None
+        lines = [f"{self.path}: skipped {self.malformed_count} malformed line(s)"]
+        lines += [f"  line {n}: {text}" for n, text in self.malformed]
+        if self.malformed_count > len(self.malformed):
+            lines.append(f"  ... {self.malformed_count - len(self.malformed)} more")
+        return "\n".join(lines)
+
+
+def read_candump(path: str, chunk_size: int = 1 << 22) -> Tuple[np.ndarray, CandumpReader]:
+    """Parse a whole candump log; returns (frames, reader) so callers can inspect malformed lines."""
+    reader = CandumpReader(path, chunk_size)
+    chunks = list(reader)
+    frames = np.concatenate(chunks) if chunks else np.zeros(0, dtype=FRAME_DTYPE)
+    return frames, reader
+
+
+def frame_tuples(frames: np.ndarray) -> List[Tuple[float, int, bool, bytes]]:
+    """Convert a FRAME_DTYPE array into (timestamp, id, extended, data) tuples."""
+    data = frames["data"].tobytes()
+    return [
+        (ts, rid, ext, data[i * 8:i * 8 + dlc])
+        for i, (ts, rid, ext, dlc) in enumerate(zip(frames["ts"].tolist(), frames["id"].tolist(),
+                                                    frames["ext"].tolist(), frames["dlc"].tolist()))
+    ]
+
+
+def format_line(ts: float, can_id: int, ext: bool, data: bytes, channel: str = "can0") -> str:
+    """One candump -l line (standard IDs as 3 hex digits, extended as 8)."""
+    cid = f"{can_id:08X}" if ext else f"{can_id:03X}"
+    return f"({ts:.6f}) {channel} {cid}#{bytes(data).hex().upper()}\n"
+
+
+def write_candump(path: str, frames: np.ndarray, channel: str = "can0") -> int:
+    """Write a FRAME_DTYPE array as a candump -l log; returns the number of frames written."""
+    with open(path, "w") as f:
+        f.writelines(format_line(ts, rid, ext, data, channel) for ts, rid, ext, data in frame_tuples(frames))
+    return len(frames)
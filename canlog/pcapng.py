@@ -0,0 +1,369 @@
+"""
+Streaming pcapng writer and reader for CAN captures (Wireshark)
+
+Writes LINKTYPE_CAN_SOCKETCAN (227) captures: one Section Header Block, one
+Interface Description Block per channel (if_tsresol = 9, so timestamps are
+nanoseconds since the epoch) and one Enhanced Packet Block per frame. Packet
+data is the 16-byte SocketCAN header plus payload, with the CAN ID and its
+EFF flag in network byte order as Wireshark expects.
+
+Blocks are assembled in an in-memory buffer and written in large chunks.
+Blocks of frames without comments are built with a single NumPy structured
+array per call (write_frames / write_arrays), so a whole receive or send
+block costs one vectorised fill and one tobytes(). A frame can carry an
+opt_comment (e.g. an anomaly annotation), shown by Wireshark as a packet
+comment.
+
+PcapngReader reads such captures back (any little-endian pcapng with
+SocketCAN interfaces and if_tsresol) as FRAME_DTYPE arrays, optionally only
+the blocks that begin in a byte range so a large archive can be split
+between workers.
+
+Usage:
+    with PcapngWriter("capture.pcapng") as pcap:
+        can0 = pcap.add_interface("can0")
+        pcap.write_frame(can0, ts, 0x123, False, b"\x01\x02", comment="dos_attack CRITICAL")
+        pcap.write_frames(can0, frames)          # canlog.candump.FRAME_DTYPE array
+
+    for frames in PcapngReader("capture.pcapng"):
+        ...
+"""
+import struct
+from typing import IO, Dict, Iterator, List, Optional, Sequence, Union
+
+import numpy as np
+
+from canlog.candump import FRAME_DTYPE
+
+LINKTYPE_CAN_SOCKETCAN = 227
+CAN_EFF_FLAG = 0x80000000
+
+_SHB = 0x0A0D0D0A
+_IDB = 0x00000001
+_SPB = 0x00000003
+_NRB = 0x00000004
+_ISB = 0x00000005
+_EPB = 0x00000006
+_KNOWN_BLOCKS = {_SHB, _IDB, _SPB, _NRB, _ISB, _EPB}
+_MAX_BLOCK = 1 << 20   # sanity bound used when resynchronising mid-file
+CAN_RTR_FLAG = 0x40000000
+CAN_ERR_FLAG = 0x20000000
+_BYTE_ORDER_MAGIC = 0x1A2B3C4D
+
+_OPT_END = 0
+_OPT_COMMENT = 1
+_IF_NAME = 2
+_IF_DESCRIPTION = 3
+_IF_TSRESOL = 9
+_SHB_USERAPPL = 4
+
+_SNAPLEN = 16   # struct can_frame
+
+# Enhanced Packet Block without options, carrying one 16-byte can_frame
+_EPB_DTYPE = np.dtype([
+    ("type", "<u4"),
+    ("length", "<u4"),
+    ("iface", "<u4"),
+    ("ts_hi", "<u4"),
+    ("ts_lo", "<u4"),
+    ("caplen", "<u4"),
+    ("origlen", "<u4"),
+    ("can_id", ">u4"),
+    ("len", "u1"),
+    ("pad", "u1"),
+    ("res0", "u1"),
+    ("len8_dlc", "u1"),
+    ("data", "u1", (8,)),
+    ("length2", "<u4"),
+])
+_EPB_SIZE = _EPB_DTYPE.itemsize  # 48
+_EPB_HEAD = struct.Struct("<IIIIIII")
+_CAN_HEAD = struct.Struct(">IBBBB")
+
+
+def _option(code: int, value: bytes) -> bytes:
+    pad = -len(value) % 4
+    return struct.pack("<HH", code, len(value)) + value + b"\0" * pad
+
+
+def _options(opts) -> bytes:
+    """Encode (code, bytes) pairs plus opt_endofopt; empty when there are none."""
+    body = b"".join(_option(code, value) for code, value in opts if value is not None)
+    return body + struct.pack("<HH", _OPT_END, 0) if body else b""
+
+
+def _block(block_type: int, body: bytes) -> bytes:
+    length = 12 + len(body)
+    return struct.pack("<II", block_type, length) + body + struct.pack("<I", length)
+
+
+class PcapngWriter:
+    def __init__(self, path_or_file: Union[str, IO[bytes]], buffer_size: int = 1 << 20,
+                 application: str = "CAN-based-Smart-Parking"):
+        if isinstance(path_or_file, str):
+            self.file = open(path_or_file, "wb")
+            self._owns_file = True
+        else:
+            self.file = path_or_file
+            self._owns_file = False
+        self.buffer_size = buffer_size
+        self._buf = bytearray()
+        self.interfaces: Dict[str, int] = {}
+        self.frames = 0
+        shb = struct.pack("<IHHq", _BYTE_ORDER_MAGIC, 1, 0, -1) + _options(
+            [(_SHB_USERAPPL, application.encode())])
+        self._buf += _block(_SHB, shb)
+
+    def add_interface(self, name: str, description: Optional[str] = None) -> int:
+        """Interface ID for `name` (an IDB is written the first time a name is seen)."""
+        key = name if description is None else f"{name}\0{description}"
+        iface = self.interfaces.get(key)
+        if iface is None:
+            iface = len(self.interfaces)
+            self.interfaces[key] = iface
+            body = struct.pack("<HHI", LINKTYPE_CAN_SOCKETCAN, 0, _SNAPLEN) + _options([
+                (_IF_NAME, name.encode()),
+                (_IF_DESCRIPTION, description.encode() if description else None),
+                (_IF_TSRESOL, b"\x09"),
+            ])
+            self._buf += _block(_IDB, body)
+        return iface
+
+    def write_frame(self, iface: int, ts: float, can_id: int, ext: bool, data: bytes,
+                    comment: Optional[str] = None):
+        """Append one frame; `comment` becomes a Wireshark packet comment."""
+        self._append(iface, ts, can_id, ext, data, comment)
+        self.frames += 1
+        if len(self._buf) >= self.buffer_size:
+            self.flush()
+
+    def _append(self, iface: int, ts: float, can_id: int, ext: bool, data: bytes, comment: Optional[str]):
+        ns = int(round(ts * 1e9))
+        n = min(len(data), 8)
+        opts = _options([(_OPT_COMMENT, comment.encode("utf-8"))]) if comment else b""
+        length = _EPB_SIZE + len(opts)
+        self._buf += _EPB_HEAD.pack(_EPB, length, iface, ns >> 32, ns & 0xFFFFFFFF, _SNAPLEN, _SNAPLEN)
+        self._buf += _CAN_HEAD.pack(can_id | (CAN_EFF_FLAG if ext else 0), n, 0, 0, 0)
+        self._buf += bytes(data[:n]).ljust(8, b"\0")
+        self._buf += opts
+        self._buf += struct.pack("<I", length)
+
+    def write_arrays(self, iface: int, ts: np.ndarray, ids: np.ndarray, ext: np.ndarray, dlc: np.ndarray,
+                     data: np.ndarray, comments: Optional[Sequence[Optional[str]]] = None):
+        """Append a block of frames given as parallel arrays (data: N x 8 uint8)."""
+        n = len(ts)
+        if n == 0:
+            return
+        blocks = np.empty(n, dtype=_EPB_DTYPE)
+        ns = np.rint(np.asarray(ts, dtype=np.float64) * 1e9).astype(np.uint64)
+        blocks["type"] = _EPB
+        blocks["length"] = _EPB_SIZE
+        blocks["iface"] = iface
+        blocks["ts_hi"] = ns >> np.uint64(32)
+        blocks["ts_lo"] = ns & np.uint64(0xFFFFFFFF)
+        blocks["caplen"] = _SNAPLEN
+        blocks["origlen"] = _SNAPLEN
+        blocks["can_id"] = np.where(ext, np.asarray(ids, dtype=np.uint32) | np.uint32(CAN_EFF_FLAG), ids)
+        blocks["len"] = dlc
+        blocks["pad"] = 0
+        blocks["res0"] = 0
+        blocks["len8_dlc"] = 0
+        blocks["data"] = data
+        blocks["length2"] = _EPB_SIZE
+        if comments is None or not any(comments):
+            self._buf += blocks.tobytes()
+        else:
+            # Commented frames need a variable-length option: splice them in between plain runs
+            start = 0
+            for k, comment in enumerate(comments):
+                if comment:
+                    self._buf += blocks[start:k].tobytes()
+                    self._append(iface, float(ts[k]), int(ids[k]), bool(ext[k]),
+                                 blocks["data"][k].tobytes()[:int(blocks["len"][k])], comment)
+                    start = k + 1
+            self._buf += blocks[start:].tobytes()
+        self.frames += n
+        if len(self._buf) >= self.buffer_size:
+            self.flush()
+
+    def write_frames(self, iface: int, frames: np.ndarray, comments: Optional[Sequence[Optional[str]]] = None):
+        """Append a canlog.candump.FRAME_DTYPE array."""
+        self.write_arrays(iface, frames["ts"], frames["id"], frames["ext"], frames["dlc"], frames["data"], comments)
+
+    def flush(self):
+        if self._buf:
+            self.file.write(self._buf)
+            self._buf = bytearray()
+        self.file.flush()
+
+    def close(self):
+        self.flush()
+        if self._owns_file:
+            self.file.close()
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *exc):
+        self.close()
+
+
+def write_pcapng(path: str, frames: np.ndarray, channel: str = "can0",
+                 comments: Optional[Sequence[Optional[str]]] = None) -> int:
+    """Write a FRAME_DTYPE array as a pcapng capture; returns the number of frames written."""
+    with PcapngWriter(path) as pcap:
+        pcap.write_frames(pcap.add_interface(channel), frames, comments)
+    return len(frames)
+
+
+class PcapngReader:
+    """Iterate a pcapng capture as FRAME_DTYPE arrays, one per buffer of blocks.
+
+    Enhanced Packet Blocks on SocketCAN interfaces become frames; other
+    link types, error and remote frames and CAN FD payloads longer than
+    8 bytes are counted in `skipped`. Only little-endian sections are read.
+
+    `start` / `end` restrict the reader to the blocks that begin in that
+    byte range. The interface table is taken from the blocks at the head of
+    the file; a reader starting mid-file resynchronises on the first 4-byte
+    aligned offset where two consecutive well-formed blocks begin.
+    """
+
+    def __init__(self, path: str, chunk_size: int = 1 << 22, start: int = 0, end: Optional[int] = None):
+        self.path = path
+        self.chunk_size = chunk_size
+        self.start = start
+        self.end = end
+        self.frame_count = 0
+        self.skipped = 0
+        self._ifaces: List[Optional[int]] = []   # per interface: ticks per second, None if not CAN
+
+    def __iter__(self) -> Iterator[np.ndarray]:
+        with open(self.path, "rb") as f:
+            if self.start > 0:
+                self._read_header(f)
+                offset = self._resync(f, (self.start + 3) & ~3)
+                if offset is None:
+                    return
+            else:
+                offset = 0
+            f.seek(offset)
+            buf = b""
+            while True:
+                chunk = f.read(self.chunk_size)
+                if not chunk:
+                    break
+                buf += chunk
+                used, frames, done = self._parse(buf, offset)
+                if len(frames):
+                    yield frames
+                if done:
+                    return
+                buf = buf[used:]
+                offset += used
+
+    def _read_header(self, f):
+        """Collect the SHB / IDBs that precede the first packet."""
+        f.seek(0)
+        while True:
+            head = f.read(8)
+            if len(head) < 8:
+                return
+            btype, blen = struct.unpack("<II", head)
+            if btype not in (_SHB, _IDB) or blen < 12:
+                return
+            body = f.read(blen - 8)
+            self._block(btype, head + body)
+
+    @staticmethod
+    def _valid_at(buf: bytes, pos: int) -> int:
+        """Length of a plausible block at pos, else 0."""
+        if pos + 12 > len(buf):
+            return 0
+        btype, blen = struct.unpack_from("<II", buf, pos)
+        if btype not in _KNOWN_BLOCKS or blen < 12 or blen % 4 or blen > _MAX_BLOCK or pos + blen > len(buf):
+            return 0
+        return blen if struct.unpack_from("<I", buf, pos + blen - 4)[0] == blen else 0
+
+    def _resync(self, f, offset: int) -> Optional[int]:
+        f.seek(offset)
+        buf = f.read(max(self.chunk_size, 4 * _MAX_BLOCK))
+        for pos in range(0, max(len(buf) - 11, 0), 4):
+            blen = self._valid_at(buf, pos)
+            if blen and (pos + blen == len(buf) or self._valid_at(buf, pos + blen)):
+                return offset + pos
+        return None
+
+    def _block(self, btype: int, block: bytes):
+        """Interface bookkeeping for SHB / IDB blocks."""
+        if btype == _SHB:
+            if struct.unpack_from("<I", block, 8)[0] != _BYTE_ORDER_MAGIC:
+                raise ValueError(f"{self.path}: big-endian pcapng sections are not supported")
+            self._ifaces.clear()
+        elif btype == _IDB:
+            linktype = struct.unpack_from("<H", block, 8)[0]
+            rate = 10 ** 6
+            pos = 16
+            while pos + 4 <= len(block) - 4:
+                code, length = struct.unpack_from("<HH", block, pos)
+                if code == _OPT_END:
+                    break
+                if code == _IF_TSRESOL and length >= 1:
+                    v = block[pos + 4]
+                    rate = 2 ** (v & 0x7F) if v & 0x80 else 10 ** v
+                pos += 4 + length + (-length % 4)
+            self._ifaces.append(rate if linktype == LINKTYPE_CAN_SOCKETCAN else None)
+
+    def _parse(self, buf: bytes, offset: int):
+        """Frames of the complete blocks in buf; (bytes used, frames, reached end of range)."""
+        end = self.end
+        ts: List[float] = []
+        ids: List[int] = []
+        dlcs: List[int] = []
+        payload = bytearray()
+        pos = 0
+        done = False
+        n = len(buf)
+        ifaces = self._ifaces
+        while pos + 8 <= n:
+            if end is not None and offset + pos >= end:
+                done = True
+                break
+            btype, blen = struct.unpack_from("<II", buf, pos)
+            if blen < 12 or blen % 4:
+                raise ValueError(f"{self.path}: corrupt block at offset {offset + pos}")
+            if pos + blen > n:
+                break
+            if btype == _EPB:
+                iface, ts_hi, ts_lo, caplen = struct.unpack_from("<IIII", buf, pos + 8)
+                rate = ifaces[iface] if iface < len(ifaces) else None
+                if rate is None or caplen < 8:
+                    self.skipped += 1
+                else:
+                    can_id, length = _CAN_HEAD.unpack_from(buf, pos + 28)[:2]
+                    if can_id & (CAN_RTR_FLAG | CAN_ERR_FLAG) or length > 8 or caplen < 8 + length:
+                        self.skipped += 1
+                    else:
+                        ts.append(((ts_hi << 32) | ts_lo) / rate)
+                        ids.append(can_id)
+                        dlcs.append(length)
+                        payload += buf[pos + 36:pos + 36 + length].ljust(8, b"\0")
+            elif btype in (_SHB, _IDB):
+                self._block(btype, buf[pos:pos + blen])
+            pos += blen
+        frames = np.zeros(len(ts), dtype=FRAME_DTYPE)
+        if ts:
+            raw = np.array(ids, dtype=np.uint32)
+            frames["ts"] = ts
+            frames["id"] = raw & 0x1FFFFFFF
+            frames["ext"] = (raw & CAN_EFF_FLAG) != 0
+            frames["dlc"] = dlcs
+            frames["data"] = np.frombuffer(bytes(payload), dtype=np.uint8).reshape(-1, 8)
+            self.frame_count += len(ts)
+        return pos, frames, done
+
+
+def read_pcapng(path: str) -> np.ndarray:
+    """Read a whole pcapng CAN capture into one FRAME_DTYPE array."""
+    chunks = list(PcapngReader(path))
+    return np.concatenate(chunks) if chunks else np.zeros(0, dtype=FRAME_DTYPE)
@@ -0,0 +1,101 @@
+"""
+Network time frames of the smart-parking CAN segment.
+
+The gateway's slot sync frame (0x010) carries its reference clock:
+    [cycle_ms u16 BE][seq u8][ref_ms u32 BE]          (DLC 7; DLC 2 = slot sync only)
+Stamped node frames append three bytes after their normal payload:
+    [..payload..][stamp u16 BE][flags u8]
+where stamp is the node's estimate of ref_ms modulo 65536 when the frame was
+queued, and flags bit 7 says the node had a time sync (bits 0-6: sequence).
+
+ClockMapper turns the sync frames seen in a capture into a mapping from the
+capture's clock to reference time, so stamped frames can be compared with
+the time they reached the bus.
+"""
+from typing import Optional, Tuple
+
+SYNC_ID = 0x010
+SYNC_TIME_DLC = 7
+STAMP_LEN = 3
+STAMP_SYNCED = 0x80
+STAMP_SEQ_MASK = 0x7F
+
+_REF_WRAP = 1 << 32
+
+
+def decode_sync(data: bytes) -> Optional[Tuple[int, int, int]]:
+    """(cycle_ms, seq, ref_ms) of a sync frame, or None for a slot-only sync."""
+    if len(data) < SYNC_TIME_DLC:
+        return None
+    return (data[0] << 8) | data[1], data[2], int.from_bytes(data[3:7], "big")
+
+
+def decode_stamp(data: bytes) -> Optional[Tuple[int, bool, int]]:
+    """(stamp_ms mod 65536, synced, seq) from the trailing bytes of a stamped frame."""
+    if len(data) < STAMP_LEN:
+        return None
+    stamp = (data[-3] << 8) | data[-2]
+    flags = data[-1]
+    return stamp, bool(flags & STAMP_SYNCED), flags & STAMP_SEQ_MASK
+
+
+def stamp_delta_ms(ref_ms: float, stamp: int) -> float:
+    """Signed ms from a 16-bit stamp to `ref_ms`, taking the nearest wrap (±32.7 s)."""
+    d = (ref_ms - stamp) % 65536.0
+    return d - 65536.0 if d >= 32768.0 else d
+
+
+class ClockMapper:
+    """Least-squares fit of reference time against capture time from sync frames.
+
+    Sums are kept relative to the first sync so float precision does not
+    degrade over long captures. A reference clock that jumps backwards (the
+    gateway rebooted) restarts the fit.
+    """
+
+    MIN_SYNCS = 2
+
+    def __init__(self):
+        self.resets = 0
+        self._clear()
+
+    def _clear(self):
+        self.n = 0
+        self.t0 = self.r0 = 0.0
+        self.st = self.sr = self.stt = self.str = 0.0
+        self.last_ref = None
+        self.wraps = 0
+
+    def update(self, capture_ts: float, ref_ms: int):
+        if self.last_ref is not None:
+            if ref_ms < self.last_ref - _REF_WRAP // 2:
+                self.wraps += 1
+            elif ref_ms < self.last_ref:
+                self.resets += 1
+                self._clear()
+        self.last_ref = ref_ms
+        ref = (ref_ms + self.wraps * _REF_WRAP) / 1000.0
+        if self.n == 0:
+            self.t0, self.r0 = capture_ts, ref
+        t, r = capture_ts - self.t0, ref - self.r0
+        self.n += 1
+        self.st += t
+        self.sr += r
+        self.stt += t * t
+        self.str += t * r
+
+    def ready(self) -> bool:
+        return self.n >= self.MIN_SYNCS
+
+    def rate(self) -> float:
+        """Reference seconds per capture second (1 + relative drift)."""
+        den = self.n * self.stt - self.st * self.st
+        if self.n < self.MIN_SYNCS or den <= 0:
+            return 1.0
+        return (self.n * self.str - self.st * self.sr) / den
+
+    def to_ref_ms(self, capture_ts: float) -> float:
+        """Reference time (ms, wraps included) at a capture timestamp."""
+        a = self.rate()
+        b = (self.sr - a * self.st) / self.n
+        return (self.r0 + b + a * (capture_ts - self.t0)) * 1000.0
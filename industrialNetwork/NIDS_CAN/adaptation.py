@@ -0,0 +1,246 @@
+"""
+Guarded online adaptation of the learned baseline
+
+Sensor baselines drift (temperature with the season, occupancy-driven
+traffic with the weekday), while everything the detectors compare against
+is fixed at the end of learning. This module lets the references follow
+slow benign drift without letting an attacker steer them:
+
+- only frames that passed every detector update anything. After an
+  anomaly on a CAN ID, the references that anomaly speaks against stay
+  fixed for `holdoff` seconds (HOLD: payload deviations hold the byte
+  means, value drifts the value series, rate anomalies the rate series;
+  structural and impersonation anomalies hold all of the ID's references);
+- each adapted reference keeps exponentially decayed statistics (mean and
+  variance, half-life `halflife` seconds of frame time; one update accounts
+  for at most MAX_DT seconds, so a long silence cannot buy a large step);
+- the reference the detector uses moves towards those statistics by at
+  most `rate` baseline standard deviations per hour. The unit is frozen at
+  the end of learning, so widening the spread does not speed up the
+  movement either. However it is fed, a reference can drift no further than
+  rate x elapsed hours;
+- in absolute terms a reference never leaves max_shift baseline standard
+  deviations around the learned mean, and its spread never exceeds
+  max_shift times the learned one. A reference that reaches either bound is
+  pinned there, and update() reports it once (the IDS raises a
+  baseline_drift anomaly), so slow poisoning ends in an alarm instead of a
+  baseline moved arbitrarily far.
+
+Adapted references:
+- change-point series (changepoint.py): mean and spread of each per-ID
+  rate series (one sample per closed rate window) and value series;
+- per-byte mean payload (baseline.py) used by the pattern-deviation check.
+
+Each frame costs a fixed amount of work: one exp() per frame, one update
+per byte position (at most 8) and value, and the rate windows the frame
+closed.
+"""
+import math
+from typing import Dict, List, Optional
+
+from changepoint import EXT_KEY
+
+MAX_DT = 60.0   # s
+MAX_SHIFT = 3.0     # learned standard deviations
+
+BYTES, VALUE, RATE = 1, 2, 4
+# anomaly_type -> references of the CAN ID held after it (others: all)
+HOLD = {
+    "pattern_deviation": BYTES,
+    "value_drift": VALUE,
+    "rate_change": RATE,
+    "dos_attack": RATE,
+}
+
+
+class GuardedRef:
+    """Reference (mean, sigma) that follows decayed statistics of its series at a bounded speed."""
+
+    __slots__ = ("mean", "sigma", "ew_mean", "ew_var", "base", "unit", "floor", "bound", "limited", "at_bound")
+
+    def __init__(self, mean: float, sigma: float, floor: float, bound: float = MAX_SHIFT):
+        self.mean = mean
+        self.sigma = sigma
+        self.ew_mean = mean
+        self.ew_var = sigma * sigma
+        self.base = mean
+        self.unit = max(sigma, floor)
+        self.floor = floor
+        self.bound = bound
+        self.limited = 0
+        self.at_bound = False
+
+    def update(self, x: float, alpha: float, step: float) -> bool:
+        """One sample with decay weight alpha; the reference moves by at most step units.
+
+        Returns True when the reference has just reached its absolute bound.
+        """
+        d = x - self.ew_mean
+        self.ew_mean += alpha * d
+        self.ew_var = (1.0 - alpha) * (self.ew_var + alpha * d * d)
+        limit = step * self.unit
+        diff = self.ew_mean - self.mean
+        if diff > limit:
+            self.mean += limit
+            self.limited += 1
+        elif diff < -limit:
+            self.mean -= limit
+            self.limited += 1
+        else:
+            self.mean = self.ew_mean
+        target = max(math.sqrt(self.ew_var), self.floor)
+        self.sigma += max(-limit, min(limit, target - self.sigma))
+        reach = self.bound * self.unit
+        hit = False
+        if self.mean > self.base + reach:
+            self.mean = self.base + reach
+            hit = True
+        elif self.mean < self.base - reach:
+            self.mean = self.base - reach
+            hit = True
+        if self.sigma > reach:
+            self.sigma = reach
+            hit = True
+        reached = hit and not self.at_bound
+        self.at_bound = hit
+        return reached
+
+    @property
+    def shift(self) -> float:
+        """Movement from the learned mean, in baseline standard deviations."""
+        return (self.mean - self.base) / self.unit
+
+
+class AdaptState:
+    __slots__ = ("last_ts", "held", "bytes", "rate", "value")
+
+    def __init__(self):
+        self.last_ts: Optional[float] = None
+        self.held = [None, None, None]   # end of the hold on bytes / value / rate
+        self.bytes: List[Optional[GuardedRef]] = []
+        self.rate: Optional[GuardedRef] = None
+        self.value: Optional[GuardedRef] = None
+
+
+class OnlineAdapter:
+    """attach() once the baseline is final, then anomaly() / update() for every monitored frame."""
+
+    def __init__(self, halflife: float = 900.0, rate: float = 1.0, holdoff: float = 60.0,
+                 max_shift: float = MAX_SHIFT):
+        self.tau = halflife / math.log(2.0)
+        self.rate = rate / 3600.0
+        self.holdoff = holdoff
+        self.max_shift = max_shift
+        self.baseline = None
+        self.changes = None
+        self.ids: Dict[int, AdaptState] = {}
+        self.updates = 0
+        self.held = 0
+        self.bounded = 0
+
+    def attach(self, baseline, changes):
+        """Adapt this StreamingBaseline and (frozen) ChangeMonitor from now on."""
+        self.baseline = baseline
+        self.changes = changes
+        self.ids = {}
+
+    def anomaly(self, msg, anomaly_type: str):
+        """Hold the references of the frame's ID that this anomaly type speaks against."""
+        key = msg.arbitration_id | (EXT_KEY if msg.is_extended_id else 0)
+        st = self.ids.get(key)
+        if st is None:
+            if msg.arbitration_id not in self.baseline:
+                return      # unknown ID: nothing learned to protect
+            st = self._state(key, msg)
+        mask = HOLD.get(anomaly_type, BYTES | VALUE | RATE)
+        until = msg.timestamp + self.holdoff
+        for i, bit in enumerate((BYTES, VALUE, RATE)):
+            if mask & bit:
+                st.held[i] = until
+
+    def _state(self, key: int, msg) -> AdaptState:
+        st = self.ids.get(key)
+        if st is not None:
+            return st
+        st = self.ids[key] = AdaptState()
+        stats = self.baseline.get(msg.arbitration_id) if self.baseline else None
+        if stats is not None:
+            for i in range(8):
+                n = stats.byte_n[i]
+                sigma = math.sqrt(stats.byte_m2[i] / (n - 1)) if n > 1 else 0.0
+                st.bytes.append(GuardedRef(stats.byte_mean[i], sigma, 1.0, self.max_shift) if n else None)
+        series = self.changes.ids.get(key) if self.changes else None
+        if series is not None:
+            st.rate = GuardedRef(series.rate.det.mean, series.rate.det.sigma, series.rate.min_sigma, self.max_shift)
+            if series.value is not None:
+                st.value = GuardedRef(series.value.det.mean, series.value.det.sigma, series.value.min_sigma,
+                                      self.max_shift)
+        return st
+
+    def update(self, msg) -> Optional[str]:
+        """Frame passed all detectors: fold it into the references of its ID.
+
+        Returns a description if a reference has just reached its absolute bound.
+        """
+        ts = msg.timestamp
+        key = msg.arbitration_id | (EXT_KEY if msg.is_extended_id else 0)
+        st = self._state(key, msg)
+        held_bytes, held_value, held_rate = (h is not None and ts < h for h in st.held)
+        if held_bytes or held_value or held_rate:
+            self.held += 1
+        series = self.changes.ids.get(key) if self.changes else None
+        dt = 0.0 if st.last_ts is None else min(max(ts - st.last_ts, 0.0), MAX_DT)
+        st.last_ts = ts
+        bounded = None
+        if dt > 0.0:
+            alpha = 1.0 - math.exp(-dt / self.tau)
+            step = self.rate * dt
+            if st.bytes and not held_bytes:
+                stats = self.baseline.get(msg.arbitration_id)
+                data = msg.data
+                for i in range(min(len(data), 8)):
+                    ref = st.bytes[i]
+                    if ref is not None:
+                        if ref.update(data[i], alpha, step) and bounded is None:
+                            bounded = self._bounded(f"payload byte {i}", ref)
+                        stats.byte_mean[i] = ref.mean
+            if st.value is not None and series is not None and not held_value:
+                if series.last_value is not None:
+                    if st.value.update(series.last_value, alpha, step) and bounded is None:
+                        bounded = self._bounded("value", st.value)
+                    series.value.det.mean = st.value.mean
+                    series.value.det.sigma = st.value.sigma
+        if st.rate is not None and series is not None and not held_rate:
+            if series.closed:
+                # One sample per closed window, each spanning rate_window seconds
+                window = min(self.changes.rate_window, MAX_DT)
+                alpha = 1.0 - math.exp(-window / self.tau)
+                for count in series.closed:
+                    if st.rate.update(count, alpha, self.rate * window) and bounded is None:
+                        bounded = self._bounded("rate", st.rate)
+                series.rate.det.mean = st.rate.mean
+                series.rate.det.sigma = st.rate.sigma
+        self.updates += 1
+        return bounded
+
+    def _bounded(self, name: str, ref: GuardedRef) -> str:
+        self.bounded += 1
+        return (f"adapted {name} reference at its bound: mean {ref.shift:+.2f} sd, "
+                f"spread {ref.sigma / ref.unit:.2f}x learned (limit {self.max_shift:g})")
+
+    def report(self) -> str:
+        lines = [f"Online adaptation: {self.updates} frames adapted ({self.held} partly held after anomalies, "
+                 f"{self.bounded} references reached their bound)"]
+        for key, st in sorted(self.ids.items()):
+            parts = []
+            for name, ref in (("rate", st.rate), ("value", st.value)):
+                if ref is not None:
+                    parts.append(f"{name} {ref.shift:+.2f} sd ({ref.limited} limited)")
+            moved = [ref for ref in st.bytes if ref is not None]
+            if moved:
+                worst = max(moved, key=lambda ref: abs(ref.mean - ref.base))
+                parts.append(f"payload byte mean {worst.mean - worst.base:+.1f} "
+                             f"({sum(ref.limited for ref in moved)} limited)")
+            if parts:
+                lines.append(f"  0x{key & 0x1FFFFFFF:03X}: " + ", ".join(parts))
+        return "\n".join(lines)
@@ -0,0 +1,208 @@
+"""
+Streaming per-ID baseline (constant memory)
+
+Learning keeps sufficient statistics instead of every timestamp and payload,
+so the learning window can be hours long on a busy bus at fixed memory:
+- inter-arrival Welford mean/variance and min/max (None until an ID has
+  an interval);
+- DLC histogram;
+- per byte position: Welford mean/variance of the byte value;
+- a reservoir sample (Algorithm R) of RESERVOIR payloads, uniform over the
+  whole learning window.
+
+The per-byte means are exactly the mean payload the pattern-deviation check
+used to recompute from the full payload list on every frame.
+
+All of it is mergeable: statistics learned on separate chunks of a capture
+combine exactly (parallel Welford, summed histogram; for contiguous chunks
+the interval across the boundary is added), and two reservoirs combine into
+a uniform sample of the union. to_dict() / from_dict() give the JSON form
+used by model files.
+"""
+import math
+import random
+from typing import List, Optional
+
+RESERVOIR = 64
+
+
+class IdBaseline:
+    __slots__ = ("count", "first_ts", "last_ts", "iv_n", "iv_mean", "iv_m2", "iv_min", "iv_max",
+                 "dlc_hist", "byte_n", "byte_mean", "byte_m2", "reservoir")
+
+    def __init__(self):
+        self.count = 0
+        self.first_ts = self.last_ts = None
+        self.iv_n = 0
+        self.iv_mean = 0.0
+        self.iv_m2 = 0.0
+        self.iv_min: Optional[float] = None
+        self.iv_max: Optional[float] = None
+        self.dlc_hist = [0] * 9
+        self.byte_n = [0] * 8
+        self.byte_mean = [0.0] * 8
+        self.byte_m2 = [0.0] * 8
+        self.reservoir: List[bytes] = []
+
+    def learn(self, ts: float, data: bytes, rng: random.Random, timing_only: bool = False):
+        """Add one frame; timing_only counts its arrival but not its DLC and payload."""
+        self.count += 1
+        if self.last_ts is not None:
+            self._add_interval(ts - self.last_ts)
+        else:
+            self.first_ts = ts
+        self.last_ts = ts
+        if timing_only:
+            return
+        n = min(len(data), 8)
+        self.dlc_hist[n] += 1
+        byte_n, byte_mean, byte_m2 = self.byte_n, self.byte_mean, self.byte_m2
+        for i in range(n):
+            b = data[i]
+            byte_n[i] += 1
+            d = b - byte_mean[i]
+            byte_mean[i] += d / byte_n[i]
+            byte_m2[i] += d * (b - byte_mean[i])
+        if len(self.reservoir) < RESERVOIR:
+            self.reservoir.append(bytes(data))
+        else:
+            j = rng.randrange(self.payloads)
+            if j < RESERVOIR:
+                self.reservoir[j] = bytes(data)
+
+    def _add_interval(self, dt: float):
+        self.iv_n += 1
+        d = dt - self.iv_mean
+        self.iv_mean += d / self.iv_n
+        self.iv_m2 += d * (dt - self.iv_mean)
+        if self.iv_min is None or dt < self.iv_min:
+            self.iv_min = dt
+        if self.iv_max is None or dt > self.iv_max:
+            self.iv_max = dt
+
+    def merge(self, other: "IdBaseline", rng: random.Random, contiguous: bool = False):
+        """Fold in statistics learned on a later chunk (contiguous: it directly follows this one)."""
+        if contiguous and self.last_ts is not None and other.first_ts is not None \
+                and other.first_ts >= self.last_ts:
+            self._add_interval(other.first_ts - self.last_ts)
+        if other.iv_n:
+            if self.iv_n:
+                self.iv_min = min(self.iv_min, other.iv_min)
+                self.iv_max = max(self.iv_max, other.iv_max)
+            else:
+                self.iv_min, self.iv_max = other.iv_min, other.iv_max
+            self.iv_n, self.iv_mean, self.iv_m2 = _combine(self.iv_n, self.iv_mean, self.iv_m2,
+                                                           other.iv_n, other.iv_mean, other.iv_m2)
+        # Merge the reservoirs while dlc_hist still holds this chunk's payload count
+        self.reservoir = _merge_reservoirs(self.reservoir, self.payloads, other.reservoir, other.payloads, rng)
+        self.dlc_hist = [a + b for a, b in zip(self.dlc_hist, other.dlc_hist)]
+        for i in range(8):
+            if other.byte_n[i]:
+                self.byte_n[i], self.byte_mean[i], self.byte_m2[i] = _combine(
+                    self.byte_n[i], self.byte_mean[i], self.byte_m2[i],
+                    other.byte_n[i], other.byte_mean[i], other.byte_m2[i])
+        self.count += other.count
+        if other.first_ts is not None:
+            self.first_ts = other.first_ts if self.first_ts is None else min(self.first_ts, other.first_ts)
+            self.last_ts = other.last_ts if self.last_ts is None else max(self.last_ts, other.last_ts)
+
+    def to_dict(self) -> dict:
+        d = {name: getattr(self, name) for name in self.__slots__}
+        d["reservoir"] = [p.hex() for p in self.reservoir]
+        return d
+
+    @classmethod
+    def from_dict(cls, d: dict) -> "IdBaseline":
+        b = cls()
+        for name in cls.__slots__:
+            setattr(b, name, d[name])
+        b.reservoir = [bytes.fromhex(p) for p in d["reservoir"]]
+        return b
+
+    @property
+    def interval_std(self) -> float:
+        return math.sqrt(self.iv_m2 / (self.iv_n - 1)) if self.iv_n > 1 else 0.0
+
+    @property
+    def payloads(self) -> int:
+        """Frames whose payload was learned (the population the reservoir samples)."""
+        return sum(self.dlc_hist)
+
+    @property
+    def common_dlc(self) -> int:
+        return max(range(9), key=self.dlc_hist.__getitem__)
+
+    def deviation(self, data: bytes) -> Optional[float]:
+        """Mean absolute difference from the mean payload over the byte positions both have."""
+        n = min(len(data), 8)
+        total, used = 0.0, 0
+        for i in range(n):
+            if self.byte_n[i]:
+                total += abs(data[i] - self.byte_mean[i])
+                used += 1
+        return total / used if used else None
+
+
+def _combine(n_a: int, mean_a: float, m2_a: float, n_b: int, mean_b: float, m2_b: float):
+    """Chan et al. parallel combination of two Welford accumulators."""
+    n = n_a + n_b
+    d = mean_b - mean_a
+    return n, mean_a + d * n_b / n, m2_a + m2_b + d * d * n_a * n_b / n
+
+
+def _merge_reservoirs(a: List[bytes], n_a: int, b: List[bytes], n_b: int, rng: random.Random) -> List[bytes]:
+    """Uniform sample of the union of two populations of n_a and n_b items, given uniform samples of each."""
+    k = min(RESERVOIR, len(a) + len(b))
+    take_a = 0
+    for _ in range(k):
+        # Draw without replacement: how many of the k come from population a
+        if rng.random() * (n_a + n_b) < n_a:
+            take_a += 1
+            n_a -= 1
+        else:
+            n_b -= 1
+    return rng.sample(a, take_a) + rng.sample(b, k - take_a)
+
+
+class StreamingBaseline:
+    """Per-ID IdBaseline map; learn() is O(DLC) per frame and memory is O(IDs)."""
+
+    def __init__(self, seed: int = 0):
+        self.ids = {}
+        self.frames = 0
+        self.rng = random.Random(seed)
+
+    def learn(self, can_id: int, ts: float, data: bytes, timing_only: bool = False):
+        b = self.ids.get(can_id)
+        if b is None:
+            b = self.ids[can_id] = IdBaseline()
+        b.learn(ts, data, self.rng, timing_only)
+        self.frames += 1
+
+    def merge(self, other: "StreamingBaseline", contiguous: bool = False):
+        for can_id, b in other.ids.items():
+            mine = self.ids.get(can_id)
+            if mine is None:
+                self.ids[can_id] = b
+            else:
+                mine.merge(b, self.rng, contiguous)
+        self.frames += other.frames
+
+    def to_dict(self) -> dict:
+        return {"frames": self.frames, "ids": {str(can_id): b.to_dict() for can_id, b in self.ids.items()}}
+
+    @classmethod
+    def from_dict(cls, d: dict, seed: int = 0) -> "StreamingBaseline":
+        sb = cls(seed)
+        sb.frames = d["frames"]
+        sb.ids = {int(can_id): IdBaseline.from_dict(b) for can_id, b in d["ids"].items()}
+        return sb
+
+    def get(self, can_id: int) -> Optional[IdBaseline]:
+        return self.ids.get(can_id)
+
+    def __len__(self):
+        return len(self.ids)
+
+    def __contains__(self, can_id):
+        return can_id in self.ids
@@ -0,0 +1,340 @@
+"""
+Change-point detection on per-ID rates and signal values
+
+The fixed frequency_threshold only sees floods; a low-and-slow rate increase
+or a slowly drifting sensor value stays under it. Per CAN ID this module
+runs sequential change detectors on two series:
+- rate: frames per `rate_window` seconds (one sample per closed window;
+  windows without frames count as zero);
+- value: the sensor value carried in the payload (decode_value), for IDs
+  whose baseline values span more than two levels (constant and two-state
+  signals such as occupancy change level as part of normal operation).
+  Only the IDs in stamped_ids are decoded with a trailing network-time
+  stamp; other 4- and 5-byte frames (e.g. slot assignments) carry no value.
+
+Each series holds a Welford mean/variance from the baseline and one
+detector, either a two-sided CUSUM or a two-sided Page-Hinkley test, both
+on values standardised by the baseline's spread. All state is a few floats
+per series, updated in O(1).
+
+False-alarm tuning is learned, not fixed: while learning, the detector also
+runs on the baseline itself (with the statistics known so far, after
+BURN_IN samples) and records the highest statistic it reached. The alarm
+threshold becomes max(h_min, margin * that peak), so series with strong
+benign swings (the temperature sine, bursty senders) get a proportionally
+higher threshold. Only behaviour beyond what the baseline showed can alarm.
+
+Learned (not yet frozen) monitors merge: series moments combine exactly,
+peaks take the maximum, and the rate window open at a chunk's end is
+dropped. A monitor restored from a model file starts its rate windows at
+the first frame it checks.
+"""
+import math
+from typing import Dict, List, Optional, Tuple
+
+from canlog.timesync import STAMP_LEN
+
+EXT_KEY = 0x80000000
+
+BURN_IN = 20
+MIN_SAMPLES = 40
+MAX_EMPTY_WINDOWS = 60   # empty rate windows replayed when an ID reappears
+
+
+def decode_value(data: bytes, stamped: bool = False) -> Optional[int]:
+    """Sensor value of a parking-lot frame: 1-byte (DLC 1) or signed 2-byte BE (DLC 2),
+    followed by a 3-byte network-time stamp (DLC 4 / 5) if stamped; None otherwise."""
+    n = len(data)
+    if stamped and n > STAMP_LEN:
+        n -= STAMP_LEN
+    if n == 1:
+        return data[0]
+    if n == 2:
+        return int.from_bytes(data[:2], "big", signed=True)
+    return None
+
+
+class Cusum:
+    """Two-sided CUSUM on standardised samples with reference drift k."""
+
+    __slots__ = ("mean", "sigma", "k", "h", "hi", "lo")
+
+    def __init__(self, mean: float, sigma: float, k: float, h: float):
+        self.mean = mean
+        self.sigma = sigma
+        self.k = k
+        self.h = h
+        self.hi = 0.0
+        self.lo = 0.0
+
+    @property
+    def stat(self) -> float:
+        return max(self.hi, self.lo)
+
+    def update(self, x: float) -> int:
+        """+1 / -1 on an upward / downward change, else 0 (the statistic restarts after an alarm)."""
+        z = (x - self.mean) / self.sigma
+        self.hi = max(0.0, self.hi + z - self.k)
+        self.lo = max(0.0, self.lo - z - self.k)
+        if self.hi > self.h:
+            self.reset()
+            return 1
+        if self.lo > self.h:
+            self.reset()
+            return -1
+        return 0
+
+    def reset(self):
+        self.hi = self.lo = 0.0
+
+
+class PageHinkley:
+    """Two-sided Page-Hinkley test on standardised samples (tolerance delta, threshold h)."""
+
+    __slots__ = ("mean", "sigma", "k", "h", "n", "avg", "up", "up_min", "down", "down_max")
+
+    def __init__(self, mean: float, sigma: float, k: float, h: float):
+        self.mean = mean
+        self.sigma = sigma
+        self.k = k
+        self.h = h
+        self.reset()
+
+    @property
+    def stat(self) -> float:
+        return max(self.up - self.up_min, self.down_max - self.down)
+
+    def update(self, x: float) -> int:
+        z = (x - self.mean) / self.sigma
+        self.n += 1
+        self.avg += (z - self.avg) / self.n
+        self.up += z - self.avg - self.k
+        self.up_min = min(self.up_min, self.up)
+        self.down += z - self.avg + self.k
+        self.down_max = max(self.down_max, self.down)
+        if self.up - self.up_min > self.h:
+            self.reset()
+            return 1
+        if self.down_max - self.down > self.h:
+            self.reset()
+            return -1
+        return 0
+
+    def reset(self):
+        self.n = 0
+        self.avg = 0.0
+        self.up = self.up_min = 0.0
+        self.down = self.down_max = 0.0
+
+
+DETECTORS = {"cusum": Cusum, "page-hinkley": PageHinkley}
+
+
+class Series:
+    """Baseline moments of one series plus its change detector."""
+
+    __slots__ = ("n", "mean", "m2", "lo", "hi", "det", "peak", "min_sigma")
+
+    def __init__(self, detector, k: float, min_sigma: float):
+        self.n = 0
+        self.mean = 0.0
+        self.m2 = 0.0
+        self.lo = math.inf
+        self.hi = -math.inf
+        self.min_sigma = min_sigma
+        self.det = detector(0.0, 1.0, k, math.inf)
+        self.peak = 0.0
+
+    @property
+    def sigma(self) -> float:
+        var = self.m2 / (self.n - 1) if self.n > 1 else 0.0
+        return max(math.sqrt(var), self.min_sigma)
+
+    def learn(self, x: float):
+        self.n += 1
+        d = x - self.mean
+        self.mean += d / self.n
+        self.m2 += d * (x - self.mean)
+        self.lo = min(self.lo, x)
+        self.hi = max(self.hi, x)
+        if self.n > BURN_IN:
+            self.det.mean = self.mean
+            self.det.sigma = self.sigma
+            self.det.update(x)
+            self.peak = max(self.peak, self.det.stat)
+
+    def merge(self, other: "Series"):
+        if not other.n:
+            return
+        n = self.n + other.n
+        d = other.mean - self.mean
+        self.mean += d * other.n / n
+        self.m2 += other.m2 + d * d * self.n * other.n / n
+        self.n = n
+        self.lo = min(self.lo, other.lo)
+        self.hi = max(self.hi, other.hi)
+        self.peak = max(self.peak, other.peak)
+
+    def to_dict(self) -> dict:
+        return {"n": self.n, "mean": self.mean, "m2": self.m2, "lo": self.lo, "hi": self.hi,
+                "peak": self.peak, "min_sigma": self.min_sigma}
+
+    @classmethod
+    def from_dict(cls, d: dict, detector, k: float) -> "Series":
+        s = cls(detector, k, d["min_sigma"])
+        s.n, s.mean, s.m2, s.lo, s.hi, s.peak = d["n"], d["mean"], d["m2"], d["lo"], d["hi"], d["peak"]
+        return s
+
+    def freeze(self, h_min: float, margin: float):
+        self.det.mean = self.mean
+        self.det.sigma = self.sigma
+        self.det.h = max(h_min, margin * self.peak)
+        self.det.reset()
+
+
+class IdState:
+    __slots__ = ("window_start", "count", "rate", "value", "closed", "last_value")
+
+    def __init__(self, ts: Optional[float], rate: Series):
+        self.window_start = ts
+        self.count = 0
+        self.rate = rate
+        self.value: Optional[Series] = None
+        # Rate windows closed and value decoded by the last checked frame (for online adaptation)
+        self.closed: List[int] = []
+        self.last_value: Optional[int] = None
+
+
+class ChangeMonitor:
+    """learn() every baseline frame, freeze() at the end, then check() each frame."""
+
+    def __init__(self, detector: str = "cusum", rate_window: float = 5.0, k: float = 0.5,
+                 h_min: float = 5.0, margin: float = 1.5, stamped_ids=()):
+        self.detector_name = detector
+        self.stamped_ids = set(stamped_ids)
+        self.detector = DETECTORS[detector]
+        self.rate_window = rate_window
+        self.k = k
+        self.h_min = h_min
+        self.margin = margin
+        self.ids: Dict[int, IdState] = {}
+        self.frozen = False
+        self.alarms = 0
+
+    def _state(self, key: int, ts: float) -> IdState:
+        st = self.ids.get(key)
+        if st is None and not self.frozen:
+            # Counts are discrete: at least half a frame per window of spread
+            st = self.ids[key] = IdState(ts, Series(self.detector, self.k, 0.5))
+        return st
+
+    def _windows(self, st: IdState, ts: float):
+        """Counts of the rate windows closed by a frame at `ts` (empty ones included, capped)."""
+        if st.window_start is None:
+            st.window_start = ts
+            return
+        elapsed = ts - st.window_start
+        if elapsed < self.rate_window:
+            return
+        closed = int(elapsed / self.rate_window)
+        yield st.count
+        for _ in range(min(closed - 1, MAX_EMPTY_WINDOWS)):
+            yield 0
+        st.window_start += closed * self.rate_window
+        st.count = 0
+
+    def learn(self, msg):
+        self.learn_frame(msg.arbitration_id | (EXT_KEY if msg.is_extended_id else 0), msg.timestamp, msg.data)
+
+    def learn_frame(self, key: int, ts: float, data: bytes, timing_only: bool = False):
+        """Add one frame to its rate windows and, unless timing_only, its value series."""
+        st = self._state(key, ts)
+        for count in self._windows(st, ts):
+            st.rate.learn(count)
+        st.count += 1
+        if timing_only:
+            return
+        value = decode_value(data, (key & ~EXT_KEY) in self.stamped_ids)
+        if value is not None:
+            if st.value is None:
+                # Sensor values are integers: at least one count of spread
+                st.value = Series(self.detector, self.k, 1.0)
+            st.value.learn(value)
+
+    def merge(self, other: "ChangeMonitor"):
+        """Fold in a monitor learned on another chunk (same detector and rate window)."""
+        for key, st in other.ids.items():
+            mine = self.ids.get(key)
+            if mine is None:
+                self.ids[key] = st
+                continue
+            mine.rate.merge(st.rate)
+            if st.value is not None:
+                if mine.value is None:
+                    mine.value = st.value
+                else:
+                    mine.value.merge(st.value)
+
+    def to_dict(self) -> dict:
+        return {"detector": self.detector_name, "rate_window": self.rate_window,
+                "stamped_ids": sorted(self.stamped_ids),
+                "ids": {str(key): {"rate": st.rate.to_dict(),
+                                   "value": st.value.to_dict() if st.value is not None else None}
+                        for key, st in self.ids.items()}}
+
+    @classmethod
+    def from_dict(cls, d: dict, **kwargs) -> "ChangeMonitor":
+        """Learned (unfrozen) monitor; rate windows start at the first checked frame."""
+        mon = cls(d["detector"], d["rate_window"], stamped_ids=d.get("stamped_ids", ()), **kwargs)
+        for key, sd in d["ids"].items():
+            st = mon.ids[int(key)] = IdState(None, Series.from_dict(sd["rate"], mon.detector, mon.k))
+            if sd["value"] is not None:
+                st.value = Series.from_dict(sd["value"], mon.detector, mon.k)
+        return mon
+
+    def freeze(self):
+        for key, st in list(self.ids.items()):
+            if st.rate.n < MIN_SAMPLES:
+                del self.ids[key]
+                continue
+            st.rate.freeze(self.h_min, self.margin)
+            if st.value is not None:
+                if st.value.n < MIN_SAMPLES or st.value.hi - st.value.lo < 2:
+                    # Constant or two-state (occupancy) values: a new level is an event, not a drift
+                    st.value = None
+                else:
+                    st.value.freeze(self.h_min, self.margin)
+        self.frozen = True
+
+    def check(self, msg) -> Optional[Tuple[str, str]]:
+        """(anomaly type, description) if the frame completes a change in rate or value, else None."""
+        st = self.ids.get(msg.arbitration_id | (EXT_KEY if msg.is_extended_id else 0))
+        if st is None:
+            return None
+        result = None
+        st.closed = list(self._windows(st, msg.timestamp))
+        st.last_value = None
+        for count in st.closed:
+            direction = st.rate.det.update(count)
+            if direction and result is None:
+                result = ("rate_change", f"rate {'up' if direction > 0 else 'down'} from "
+                          f"{st.rate.mean / self.rate_window:.2f}/s (window of {count} frames)")
+        st.count += 1
+        if st.value is not None:
+            # The value series sees every frame, also one that closed a rate alarm
+            value = st.last_value = decode_value(msg.data, msg.arbitration_id in self.stamped_ids)
+            if value is not None:
+                direction = st.value.det.update(value)
+                if direction:
+                    drift = (f"value {'up' if direction > 0 else 'down'} "
+                             f"from mean {st.value.mean:.1f} (now {value})")
+                    # One anomaly per frame: a rate change is reported first, with the drift in its description
+                    result = ("value_drift", drift) if result is None else (result[0], f"{result[1]}; {drift}")
+        if result:
+            self.alarms += 1
+        return result
+
+    def report(self) -> str:
+        valued = sum(1 for st in self.ids.values() if st.value is not None)
+        return (f"Change detectors ({self.detector.__name__}): {len(self.ids)} IDs on rate, {valued} on value, "
+                f"{self.alarms} alarms")
@@ -0,0 +1,210 @@
+"""
+Clock-skew fingerprinting of periodic senders
+
+Each periodic CAN ID is sent by one node whose timer runs off its own
+oscillator, so its frames drift against the receiver's clock at a constant
+rate (the skew, a few ppm to tens of ppm). Injected frames come from another
+oscillator and break that line.
+
+Per ID, from the receive timestamps (kernel timestamps on SocketCAN, capture
+timestamps offline):
+- the nominal period T is the mean of the first WARMUP_INTERVALS intervals;
+- frame k, arriving at a_k, is slot n of the sender's schedule (n from
+  (a_k - a_0) / T, corrected by the current fit), and O_k = a_k - a_0 - n*T
+  is its accumulated clock offset;
+- recursive least squares (forgetting factor `forget`) fits O = S*t + b with
+  t = a_k - a_0, so the slope S is the sender's skew relative to T. Each
+  update is O(1): a 2x2 covariance held in three floats;
+- the a priori identification error e = O - (S*t + b) is compared with the
+  band of residuals seen in the baseline (widened by BAND_MARGIN); the part
+  outside the band, in units of the baseline's residual spread, feeds a
+  two-sided CUSUM. Timers driven by millis() arrive on a 1 ms staircase
+  rather than a line, so residuals can sit at one edge of the band for
+  minutes; only deviations beyond what the baseline showed accumulate.
+
+The baseline (learning phase) fixes T, the skew S_base and the residual
+band. Afterwards a frame raises a sender-impersonation anomaly when the
+CUSUM crosses `threshold` (frames off the sender's schedule, or a schedule
+drifting at another rate), or when the tracked skew moves more than
+`skew_tol_ppm` from S_base. Outliers (|z| > Z_CLIP) still count towards the
+CUSUM but do not update the fit, so injected frames cannot drag the estimate.
+IDs whose intervals vary by more than MAX_CV during learning are not
+periodic and are not tracked.
+"""
+import math
+from typing import Dict, Optional
+
+WARMUP_INTERVALS = 8
+MIN_FIT_FRAMES = 16
+MAX_CV = 0.1
+Z_CLIP = 10.0
+MIN_SIGMA = 20e-6   # s; floor for very clean (simulated) timing
+BAND_MARGIN = 0.25  # fraction of the baseline residual range added on each side
+
+
+class SkewTracker:
+    __slots__ = ("t0", "last", "period", "n_warm", "warm_sum", "warm_sq", "skew", "offset",
+                 "p11", "p12", "p22", "frames", "res_n", "res_mean", "res_m2", "res_lo", "res_hi",
+                 "base_skew", "sigma", "cusum_hi", "cusum_lo", "outliers", "alarms")
+
+    def __init__(self, ts: float):
+        self.t0 = ts
+        self.last = ts
+        self.period = 0.0
+        self.n_warm = 0
+        self.warm_sum = 0.0
+        self.warm_sq = 0.0
+        self.skew = 0.0
+        self.offset = 0.0
+        self.p11 = self.p22 = 1e6
+        self.p12 = 0.0
+        self.frames = 0
+        self.res_n = 0
+        self.res_mean = 0.0
+        self.res_m2 = 0.0
+        self.res_lo = math.inf
+        self.res_hi = -math.inf
+        self.base_skew = None
+        self.sigma = 0.0
+        self.cusum_hi = 0.0
+        self.cusum_lo = 0.0
+        self.outliers = 0
+        self.alarms = 0
+
+    def warm(self, ts: float) -> bool:
+        """Collect intervals until the nominal period is known; True once it is."""
+        if self.period:
+            return True
+        dt = ts - self.last
+        self.last = ts
+        if dt <= 0:
+            return False
+        self.n_warm += 1
+        self.warm_sum += dt
+        self.warm_sq += dt * dt
+        if self.n_warm >= WARMUP_INTERVALS:
+            self.period = self.warm_sum / self.n_warm
+            self.t0 = ts
+        return False
+
+    @property
+    def cv(self) -> float:
+        if not self.n_warm:
+            return math.inf
+        mean = self.warm_sum / self.n_warm
+        var = max(self.warm_sq / self.n_warm - mean * mean, 0.0)
+        return math.sqrt(var) / mean if mean > 0 else math.inf
+
+    def residual(self, ts: float):
+        """(t, accumulated offset, a priori identification error) of a frame."""
+        t = ts - self.t0
+        # Schedule slot from the fitted clock, so period error does not accumulate into the rounding
+        n = round((t * (1.0 - self.skew) - self.offset) / self.period)
+        o = t - n * self.period
+        return t, o, o - (self.skew * t + self.offset)
+
+    def update(self, t: float, o: float, e: float, forget: float):
+        """One RLS step for O = S*t + b with x = (t, 1)."""
+        p11, p12, p22 = self.p11, self.p12, self.p22
+        px1 = p11 * t + p12
+        px2 = p12 * t + p22
+        denom = forget + t * px1 + px2
+        g1 = px1 / denom
+        g2 = px2 / denom
+        self.skew += g1 * e
+        self.offset += g2 * e
+        self.p11 = (p11 - g1 * px1) / forget
+        self.p12 = (p12 - g1 * px2) / forget
+        self.p22 = (p22 - g2 * px2) / forget
+        self.frames += 1
+
+
+class ClockSkewMonitor:
+    """Per-ID skew trackers: learn() during the baseline, freeze(), then check() per frame."""
+
+    def __init__(self, threshold: float = 12.0, kappa: float = 0.5, skew_tol_ppm: float = 30.0,
+                 forget: float = 0.9995):
+        self.threshold = threshold
+        self.kappa = kappa
+        self.skew_tol = skew_tol_ppm * 1e-6
+        self.forget = forget
+        self.trackers: Dict[int, SkewTracker] = {}
+        self.frozen = False
+
+    @staticmethod
+    def _key(msg) -> int:
+        return msg.arbitration_id | (0x80000000 if msg.is_extended_id else 0)
+
+    def learn(self, msg):
+        """Baseline frame: estimate the period, then fit skew and residual spread."""
+        key = self._key(msg)
+        tr = self.trackers.get(key)
+        if tr is None:
+            self.trackers[key] = SkewTracker(msg.timestamp)
+            return
+        if not tr.warm(msg.timestamp):
+            return
+        t, o, e = tr.residual(msg.timestamp)
+        if tr.frames >= MIN_FIT_FRAMES // 2:
+            # Residual spread from the second half of the fit onwards (Welford)
+            tr.res_n += 1
+            d = e - tr.res_mean
+            tr.res_mean += d / tr.res_n
+            tr.res_m2 += d * (e - tr.res_mean)
+            tr.res_lo = min(tr.res_lo, e)
+            tr.res_hi = max(tr.res_hi, e)
+        tr.update(t, o, e, self.forget)
+
+    def freeze(self):
+        """End of the baseline: keep periodic IDs with enough frames and fix their reference skew."""
+        for key, tr in list(self.trackers.items()):
+            if not tr.period or tr.frames < MIN_FIT_FRAMES or tr.cv > MAX_CV or tr.res_n < 2:
+                del self.trackers[key]
+                continue
+            tr.base_skew = tr.skew
+            tr.sigma = max(math.sqrt(tr.res_m2 / (tr.res_n - 1)), MIN_SIGMA)
+            margin = BAND_MARGIN * (tr.res_hi - tr.res_lo)
+            tr.res_lo -= margin
+            tr.res_hi += margin
+        self.frozen = True
+
+    def check(self, msg) -> Optional[str]:
+        """Monitoring frame: None if consistent with the learned sender, else the reason."""
+        tr = self.trackers.get(self._key(msg))
+        if tr is None:
+            return None
+        t, o, e = tr.residual(msg.timestamp)
+        if e > tr.res_hi:
+            z = (e - tr.res_hi) / tr.sigma
+        elif e < tr.res_lo:
+            z = (e - tr.res_lo) / tr.sigma
+        else:
+            z = 0.0
+        if abs(z) > Z_CLIP:
+            tr.outliers += 1
+            z = math.copysign(Z_CLIP, z)
+        else:
+            tr.update(t, o, e, self.forget)
+        tr.cusum_hi = max(0.0, tr.cusum_hi + z - self.kappa)
+        tr.cusum_lo = max(0.0, tr.cusum_lo - z - self.kappa)
+        reason = None
+        if tr.cusum_hi > self.threshold or tr.cusum_lo > self.threshold:
+            reason = f"timing off the sender's schedule (CUSUM {max(tr.cusum_hi, tr.cusum_lo):.1f})"
+            tr.cusum_hi = tr.cusum_lo = 0.0
+        elif abs(tr.skew - tr.base_skew) > self.skew_tol:
+            reason = (f"clock skew {tr.skew * 1e6:+.1f} ppm vs baseline {tr.base_skew * 1e6:+.1f} ppm")
+            # Re-reference so a lasting change is reported once, not on every frame
+            tr.base_skew = tr.skew
+        if reason:
+            tr.alarms += 1
+        return reason
+
+    def report(self) -> str:
+        lines = [f"Clock-skew fingerprints: {len(self.trackers)} periodic IDs"]
+        for key, tr in sorted(self.trackers.items()):
+            can_id = key & 0x1FFFFFFF
+            lines.append(f"  0x{can_id:03X}: period {tr.period * 1000:.3f} ms, skew {tr.skew * 1e6:+.2f} ppm "
+                         f"(baseline {tr.base_skew * 1e6:+.2f}), residual {tr.sigma * 1e6:.0f} us "
+                         f"[{tr.res_lo * 1e6:+.0f}, {tr.res_hi * 1e6:+.0f}], "
+                         f"{tr.outliers} outliers, {tr.alarms} alarms")
+        return "\n".join(lines)
@@ -0,0 +1,205 @@
+"""
+Pre/post-trigger forensic capture around anomalies
+
+Every frame seen by the IDS is written into a preallocated ring of
+FRAME_DTYPE rows (canlog.candump) sized for --forensics-pre + --forensics-post
+seconds at --forensics-rate frames/s; memory is fixed at start-up and a
+push is a handful of in-place stores. trigger() opens a capture whose file
+name is returned at once, so the anomaly row can reference it. A later
+anomaly inside the open capture's post-trigger window shares that file,
+whose end moves to the anomaly's own post-trigger window as long as the
+ring, at the rate seen so far, still holds the capture from its start;
+otherwise the anomaly opens a new, overlapping capture. Either way every
+anomaly's file covers its full pre- and post-trigger window. Once the
+window has passed (checked on each push, or by poll() while the bus is
+idle) the ring is copied out in arrival order (one copy of its fixed size)
+and a writer thread cuts the window and writes the file. At most
+queue_size copies wait for the writer, so memory stays bounded; if the
+writer falls behind, captures are dropped and counted rather than blocking
+the receive path. A capture whose file will never exist (dropped, or the
+write failed) is reported to on_lost(path) on the caller's thread (from
+push(), poll() or close()), so references to it can be cleared.
+
+Captures are candump logs, or with fmt="pcapng" Wireshark captures
+(canlog.pcapng) in which each triggering frame carries its anomaly as a
+packet comment.
+
+If traffic exceeds the rate budget, the ring holds less than the configured
+pre-trigger time; such captures are counted as truncated.
+"""
+import math
+import os
+import queue
+import threading
+import time
+from collections import deque
+from datetime import datetime
+
+import numpy as np
+
+from canlog.candump import FRAME_DTYPE, write_candump
+from canlog.pcapng import write_pcapng
+
+_DATA_OFFSET = FRAME_DTYPE.fields["data"][1]
+
+
+class _Capture:
+    __slots__ = ("path", "start", "deadline", "notes")
+
+    def __init__(self, path, start, deadline):
+        self.path = path
+        self.start = start
+        self.deadline = deadline
+        self.notes = []     # (ts, annotation) of each anomaly in the capture
+
+
+class ForensicRecorder:
+    def __init__(self, out_dir: str, pre_s: float = 5.0, post_s: float = 5.0, max_rate: float = 5000.0,
+                 queue_size: int = 4, channel: str = "can0", fmt: str = "candump", on_lost=None):
+        if fmt not in ("candump", "pcapng"):
+            raise ValueError(f"Unknown capture format: {fmt}")
+        self.out_dir = out_dir
+        self.fmt = fmt
+        os.makedirs(out_dir, exist_ok=True)
+        self.pre_s = pre_s
+        self.post_s = post_s
+        self.channel = channel
+        self.capacity = max(1, math.ceil((pre_s + post_s) * max_rate))
+        self.ring = np.zeros(self.capacity, dtype=FRAME_DTYPE)
+        self._ts = self.ring["ts"]
+        self._id = self.ring["id"]
+        self._ext = self.ring["ext"]
+        self._dlc = self.ring["dlc"]
+        self._raw = memoryview(self.ring.view(np.uint8))
+        self._item = FRAME_DTYPE.itemsize
+        self.head = 0
+        self.pushed = 0
+        self.pending = deque()
+        self.captures = 0
+        self.written = 0
+        self.dropped = 0
+        self.truncated = 0
+        self.on_lost = on_lost
+        self._failed = deque()     # paths the writer thread could not write
+        self._queue: "queue.Queue" = queue.Queue(maxsize=queue_size)
+        self._writer = threading.Thread(target=self._write_loop, name="forensics-writer", daemon=True)
+        self._writer.start()
+
+    def push(self, msg):
+        """Record one received frame (hot path: no allocation)."""
+        i = self.head
+        data = msg.data or b""
+        n = min(len(data), 8)
+        self._ts[i] = msg.timestamp
+        self._id[i] = msg.arbitration_id
+        self._ext[i] = msg.is_extended_id
+        self._dlc[i] = n
+        off = i * self._item + _DATA_OFFSET
+        self._raw[off:off + n] = data[:n]
+        self.head = i + 1 if i + 1 < self.capacity else 0
+        self.pushed += 1
+        if self.pending and msg.timestamp >= self.pending[0].deadline:
+            self._finish(msg.timestamp)
+        if self._failed:
+            self._report_failed()
+
+    def trigger(self, ts: float, note: str = None) -> str:
+        """Open (or join) the capture around an anomaly at `ts`; returns its file path.
+
+        `note` annotates the triggering frame in pcapng captures.
+        """
+        cap = self.pending[-1] if self.pending else None
+        if cap is not None and ts <= cap.deadline and \
+                (ts + self.post_s <= cap.deadline or ts + self.post_s - cap.start <= self._cover(ts)):
+            cap.deadline = max(cap.deadline, ts + self.post_s)
+        else:
+            self.captures += 1
+            stamp = datetime.fromtimestamp(ts).strftime("%Y%m%d-%H%M%S")
+            ext = "pcapng" if self.fmt == "pcapng" else "log"
+            cap = _Capture(os.path.join(self.out_dir, f"anomaly_{stamp}_{self.captures:05d}.{ext}"),
+                           ts - self.pre_s, ts + self.post_s)
+            self.pending.append(cap)
+        if note:
+            cap.notes.append((ts, note))
+        return cap.path
+
+    def _cover(self, now: float) -> float:
+        """Seconds of traffic the full ring holds at the rate seen so far."""
+        held = min(self.pushed, self.capacity)
+        if held < 2:
+            return math.inf
+        oldest = self._ts[self.head] if self.pushed > self.capacity else self._ts[0]
+        return (now - oldest) * self.capacity / held
+
+    def poll(self, now: float = None):
+        """Close captures whose post-trigger window has passed (call while the bus is idle)."""
+        if self.pending:
+            self._finish(time.time() if now is None else now)
+        if self._failed:
+            self._report_failed()
+
+    def _finish(self, now: float, force: bool = False):
+        while self.pending and (force or self.pending[0].deadline <= now):
+            cap = self.pending.popleft()
+            if self.pushed > self.capacity:
+                if self._ts[self.head] > cap.start:
+                    self.truncated += 1
+                snapshot = np.concatenate((self.ring[self.head:], self.ring[:self.head]))
+            else:
+                snapshot = self.ring[:self.head].copy()
+            try:
+                self._queue.put_nowait((cap, snapshot))
+            except queue.Full:
+                self.dropped += 1
+                if self.on_lost:
+                    self.on_lost(cap.path)
+
+    def _report_failed(self):
+        while self._failed:
+            path = self._failed.popleft()
+            if self.on_lost:
+                self.on_lost(path)
+
+    def _write_loop(self):
+        while True:
+            item = self._queue.get()
+            if item is None:
+                return
+            cap, snapshot = item
+            ts = snapshot["ts"]
+            rows = snapshot[(ts >= cap.start) & (ts <= cap.deadline)]
+            try:
+                if self.fmt == "pcapng":
+                    write_pcapng(cap.path, rows, self.channel, self._comments(rows, cap.notes))
+                else:
+                    write_candump(cap.path, rows, self.channel)
+                self.written += 1
+            except OSError as e:
+                print(f"Forensic capture {cap.path} could not be written: {e}")
+                self._failed.append(cap.path)
+
+    @staticmethod
+    def _comments(rows, notes):
+        """Per-row packet comments: each note goes on the frame stamped with its trigger time."""
+        if not notes:
+            return None
+        comments = [None] * len(rows)
+        ts = rows["ts"]
+        for when, note in notes:
+            hit = np.flatnonzero(ts == when)
+            if len(hit):
+                k = int(hit[0])
+                comments[k] = f"{comments[k]}; {note}" if comments[k] else note
+        return comments
+
+    def close(self):
+        """Write every open capture with what has been recorded so far, then stop the writer."""
+        self._finish(0.0, force=True)
+        self._queue.put(None)
+        self._writer.join()
+        self._report_failed()
+
+    def report(self) -> str:
+        return (f"Forensic captures: {self.captures} opened, {self.written} written, {self.dropped} dropped "
+                f"(writer busy), {self.truncated} with truncated pre-trigger window "
+                f"(ring: {self.capacity} frames, {self.ring.nbytes // 1024} KiB)")
@@ -0,0 +1,289 @@
+"""
+Incident correlation: grouping anomalies into incidents
+
+Anomalies are merged into an open incident when they fall within `gap`
+seconds of its time span and share either a CAN ID or an attack signature
+(see SIGNATURES: a flood shows up as dos_attack rows, a fuzz run as a mix of
+unknown_id, dlc_mismatch, invalid_data and pattern_deviation rows). An
+anomaly matching two incidents (e.g. one by ID, one by signature) merges
+them. Incident severity is the highest member severity, escalated one level
+per evidence threshold crossed (anomaly count, distinct types, distinct IDs).
+
+Open incidents are found through an interval index: per key (signature or
+CAN ID) a list of disjoint [start, end] spans sorted by start, searched with
+bisect, so each anomaly costs O(log n) lookups. Incidents close once no
+anomaly has joined them for `gap` seconds (a heap of close deadlines, checked
+lazily) and leave the index. The incidents table gets a row when an
+incident opens and is updated on escalation, merge, close and flush(), not
+on every anomaly.
+"""
+import heapq
+import json
+from bisect import bisect_right
+from typing import Callable, Dict, List, Optional, Tuple
+
+# anomaly_type -> attack signature
+SIGNATURES = {
+    "dos_attack": "flood",
+    "rate_change": "flood",
+    "unknown_id": "fuzz",
+    "dlc_mismatch": "fuzz",
+    "invalid_data": "fuzz",
+    "pattern_deviation": "fuzz",
+    "out_of_range": "spoof",
+    "sender_impersonation": "spoof",
+    "value_drift": "spoof",
+    "baseline_drift": "spoof",
+}
+
+SEVERITIES = ["MEDIUM", "WARNING", "HIGH", "CRITICAL"]
+
+# Evidence thresholds; each one crossed raises the incident one severity level
+ESCALATE_COUNT = (10, 100)
+ESCALATE_TYPES = 3
+ESCALATE_IDS = 10
+
+
+def _rank(severity: str) -> int:
+    return SEVERITIES.index(severity) if severity in SEVERITIES else 0
+
+
+class Incident:
+    __slots__ = ("id", "start", "end", "signatures", "types", "can_ids", "count", "base_rank", "severity",
+                 "keys", "closed", "dirty")
+
+    def __init__(self, ts: float, signature: str):
+        self.id: Optional[int] = None
+        self.start = ts
+        self.end = ts
+        self.signatures = {signature}
+        self.types: Dict[str, int] = {}
+        self.can_ids = set()
+        self.count = 0
+        self.base_rank = 0
+        self.severity = SEVERITIES[0]
+        self.keys: List[Tuple] = []
+        self.closed = False
+        self.dirty = True
+
+    def escalated(self) -> str:
+        rank = self.base_rank
+        rank += sum(1 for n in ESCALATE_COUNT if self.count >= n)
+        rank += len(self.types) >= ESCALATE_TYPES
+        rank += len(self.can_ids) >= ESCALATE_IDS
+        return SEVERITIES[min(rank, len(SEVERITIES) - 1)]
+
+    @property
+    def signature(self) -> str:
+        return "+".join(sorted(self.signatures))
+
+    def as_dict(self) -> Dict:
+        return {"incident": self.id, "start": self.start, "end": self.end, "signature": self.signature,
+                "types": self.types, "can_ids": len(self.can_ids), "anomalies": self.count,
+                "severity": self.severity, "status": "closed" if self.closed else "open"}
+
+
+class IntervalIndex:
+    """Per-key disjoint [start, end] spans sorted by start; lookups by bisect."""
+
+    def __init__(self):
+        self.starts: Dict[Tuple, List[float]] = {}
+        self.items: Dict[Tuple, List[Incident]] = {}
+
+    def find(self, key: Tuple, ts: float, gap: float) -> Optional[Incident]:
+        starts = self.starts.get(key)
+        if not starts:
+            return None
+        i = bisect_right(starts, ts + gap) - 1
+        if i >= 0:
+            inc = self.items[key][i]
+            if inc.end + gap >= ts:
+                return inc
+        return None
+
+    def add(self, key: Tuple, inc: Incident):
+        starts = self.starts.setdefault(key, [])
+        i = bisect_right(starts, inc.start)
+        starts.insert(i, inc.start)
+        self.items.setdefault(key, []).insert(i, inc)
+
+    def remove(self, key: Tuple, inc: Incident):
+        starts = self.starts[key]
+        items = self.items[key]
+        i = bisect_right(starts, inc.start) - 1
+        while items[i] is not inc:
+            i -= 1
+        del starts[i]
+        del items[i]
+        if not starts:
+            del self.starts[key]
+            del self.items[key]
+
+
+class IncidentCorrelator:
+    def __init__(self, conn, gap: float = 5.0, max_ids: int = 64,
+                 publish: Optional[Callable[[str, Dict], None]] = None):
+        self.conn = conn
+        self.gap = gap
+        self.max_ids = max_ids
+        self.publish = publish
+        self.index = IntervalIndex()
+        self.deadlines: List[Tuple[float, int, Incident]] = []
+        self.open: Dict[int, Incident] = {}
+        self.opened = 0
+        self.merged = 0
+        self.escalations = 0
+        self._seq = 0
+        self._init_table()
+
+    def _init_table(self):
+        self.conn.execute('''
+            CREATE TABLE IF NOT EXISTS incidents (
+                id INTEGER PRIMARY KEY,
+                start_ts REAL,
+                end_ts REAL,
+                signature TEXT,
+                anomaly_types TEXT,
+                can_ids TEXT,
+                anomaly_count INTEGER,
+                severity TEXT,
+                status TEXT,
+                merged_into INTEGER
+            )
+        ''')
+        self.conn.commit()
+
+    def observe(self, ts: float, can_id: int, anomaly_type: str, severity: str) -> Incident:
+        """Add one anomaly; returns the incident it now belongs to."""
+        self.expire(ts)
+        signature = SIGNATURES.get(anomaly_type, anomaly_type)
+        by_sig = self.index.find(("sig", signature), ts, self.gap)
+        by_id = self.index.find(("id", can_id), ts, self.gap)
+        inc = by_sig or by_id
+        if by_sig and by_id and by_sig is not by_id:
+            inc = self._merge(by_sig, by_id)
+        if inc is None:
+            inc = self._open(ts, signature)
+        self._add(inc, ts, can_id, signature, anomaly_type, severity)
+        return inc
+
+    def _open(self, ts: float, signature: str) -> Incident:
+        inc = Incident(ts, signature)
+        cur = self.conn.execute(
+            "INSERT INTO incidents (start_ts, end_ts, signature, anomaly_count, severity, status) "
+            "VALUES (?, ?, ?, 0, ?, 'open')", (ts, ts, signature, inc.severity))
+        inc.id = cur.lastrowid
+        self.open[inc.id] = inc
+        self._index(inc, ("sig", signature))
+        self.opened += 1
+        return inc
+
+    def _index(self, inc: Incident, key: Tuple):
+        inc.keys.append(key)
+        self.index.add(key, inc)
+
+    def _add(self, inc: Incident, ts: float, can_id: int, signature: str, anomaly_type: str, severity: str):
+        if ts < inc.start:
+            # Out-of-order anomaly: the span's sort key changes, re-insert it
+            for key in inc.keys:
+                self.index.remove(key, inc)
+            inc.start = ts
+            for key in inc.keys:
+                self.index.add(key, inc)
+        if ts > inc.end:
+            inc.end = ts
+        inc.count += 1
+        inc.types[anomaly_type] = inc.types.get(anomaly_type, 0) + 1
+        inc.base_rank = max(inc.base_rank, _rank(severity))
+        if can_id not in inc.can_ids and len(inc.can_ids) < self.max_ids:
+            inc.can_ids.add(can_id)
+            if self.index.find(("id", can_id), ts, self.gap) is None:
+                self._index(inc, ("id", can_id))
+        if signature not in inc.signatures:
+            # Joined through a shared ID: the incident now also stands for this signature
+            inc.signatures.add(signature)
+            if self.index.find(("sig", signature), ts, self.gap) is None:
+                self._index(inc, ("sig", signature))
+        inc.dirty = True
+        self._seq += 1
+        heapq.heappush(self.deadlines, (inc.end + self.gap, self._seq, inc))
+        level = inc.escalated()
+        if level != inc.severity or inc.count == 1:
+            escalated = inc.count > 1
+            inc.severity = level
+            self._save(inc)
+            if escalated:
+                self.escalations += 1
+            self._emit("escalated" if escalated else "opened", inc)
+
+    def _merge(self, a: Incident, b: Incident) -> Incident:
+        """Fold the smaller incident into the larger one."""
+        if b.count > a.count:
+            a, b = b, a
+        for key in b.keys:
+            self.index.remove(key, b)
+        for key in a.keys:
+            self.index.remove(key, a)
+        a.start = min(a.start, b.start)
+        a.end = max(a.end, b.end)
+        a.count += b.count
+        for t, n in b.types.items():
+            a.types[t] = a.types.get(t, 0) + n
+        a.base_rank = max(a.base_rank, b.base_rank)
+        a.signatures |= b.signatures
+        a.can_ids |= set(list(b.can_ids)[:max(0, self.max_ids - len(a.can_ids))])
+        a.keys = list(dict.fromkeys(a.keys + b.keys))
+        for key in a.keys:
+            self.index.add(key, a)
+        b.closed = True
+        del self.open[b.id]
+        self.conn.execute("UPDATE incidents SET status = 'merged', merged_into = ? WHERE id = ?", (a.id, b.id))
+        self.conn.execute("UPDATE anomalies SET incident_id = ? WHERE incident_id = ?", (a.id, b.id))
+        self.merged += 1
+        a.severity = a.escalated()
+        self._save(a)
+        return a
+
+    def expire(self, now: float):
+        """Close incidents that nothing has joined for `gap` seconds."""
+        while self.deadlines and self.deadlines[0][0] < now:
+            deadline, _, inc = heapq.heappop(self.deadlines)
+            if inc.closed or inc.end + self.gap != deadline:
+                continue    # stale entry: merged away or extended since
+            self._close(inc)
+
+    def _close(self, inc: Incident):
+        for key in inc.keys:
+            self.index.remove(key, inc)
+        inc.closed = True
+        del self.open[inc.id]
+        self._save(inc)
+        self._emit("closed", inc)
+
+    def _save(self, inc: Incident):
+        self.conn.execute(
+            "UPDATE incidents SET start_ts = ?, end_ts = ?, signature = ?, anomaly_types = ?, can_ids = ?, "
+            "anomaly_count = ?, severity = ?, status = ? WHERE id = ?",
+            (inc.start, inc.end, inc.signature, json.dumps(inc.types), ",".join(f"0x{i:03X}" for i in sorted(inc.can_ids)),
+             inc.count, inc.severity, "closed" if inc.closed else "open", inc.id))
+        inc.dirty = False
+
+    def _emit(self, event: str, inc: Incident):
+        if self.publish:
+            self.publish(event, inc.as_dict())
+
+    def flush(self):
+        """Write the current state of every changed open incident."""
+        for inc in self.open.values():
+            if inc.dirty:
+                self._save(inc)
+        self.conn.commit()
+
+    def close_all(self):
+        for inc in list(self.open.values()):
+            self._close(inc)
+        self.conn.commit()
+
+    def report(self) -> str:
+        return (f"Incidents: {self.opened} opened, {self.merged} merged, {self.escalations} escalations, "
+                f"{len(self.open)} open")
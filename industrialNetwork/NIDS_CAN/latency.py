@@ -0,0 +1,127 @@
+"""
+Per-hop latency measurement from network time frames
+
+Hops (per CAN ID):
+- node->bus: stamp in a node frame vs the time the frame was seen on the bus,
+  mapped to reference time through the gateway's sync frames
+- bus->ids: receive timestamp vs the end of detection in this process
+  (live mode only; capture timestamps are not on this host's clock)
+
+Each (hop, ID) keeps its exact count and maximum plus a uniform reservoir
+sample (Algorithm R) of RESERVOIR values for the percentiles, so memory stays
+flat however long the IDS runs.
+
+Lost frames are counted from gaps in the stamp sequence of each ID. In the
+sketches' default ID mode every node of a type sends under one CAN ID, and
+their sequences interleave; an ID whose sequence steps back (a gap of
+SHARED_GAP or more) is taken to be shared and its losses are not counted.
+"""
+import random
+import time
+from collections import defaultdict
+
+from canlog.timesync import SYNC_ID, ClockMapper, decode_stamp, decode_sync, stamp_delta_ms
+
+# Stamped frames whose ms delta is beyond this are counted as invalid (bad stamp or lost sync)
+MAX_PLAUSIBLE_MS = 5000.0
+RESERVOIR = 4096
+SHARED_GAP = 64     # sequence steps of 64..127 are steps back (mod 128)
+
+
+def _pct(values, q):
+    return values[min(len(values) - 1, int(q / 100.0 * len(values)))]
+
+
+class LatencySamples:
+    __slots__ = ("n", "max", "reservoir")
+
+    def __init__(self):
+        self.n = 0
+        self.max = float("-inf")
+        self.reservoir = []
+
+    def add(self, value, rng):
+        self.n += 1
+        if value > self.max:
+            self.max = value
+        if len(self.reservoir) < RESERVOIR:
+            self.reservoir.append(value)
+        else:
+            j = rng.randrange(self.n)
+            if j < RESERVOIR:
+                self.reservoir[j] = value
+
+
+class LatencyMonitor:
+    """Collects per-ID, per-hop latency samples and sequence gaps."""
+
+    def __init__(self, stamped_ids=()):
+        self.stamped_ids = set(stamped_ids)
+        self.clock = ClockMapper()
+        self.samples = defaultdict(LatencySamples)   # (hop, can_id) -> latency ms
+        self.rng = random.Random(0)
+        self.last_seq = {}
+        self.lost = defaultdict(int)
+        self.shared = set()
+        self.unsynced = defaultdict(int)
+        self.invalid = defaultdict(int)
+
+    def observe(self, msg):
+        """Feed every received frame (learning phase included)."""
+        can_id = msg.arbitration_id
+        if can_id == SYNC_ID and not msg.is_extended_id:
+            sync = decode_sync(bytes(msg.data))
+            if sync is not None:
+                self.clock.update(msg.timestamp, sync[2])
+            return
+        if can_id not in self.stamped_ids:
+            return
+        stamp = decode_stamp(bytes(msg.data))
+        if stamp is None:
+            return
+        value, synced, seq = stamp
+        last = self.last_seq.get(can_id)
+        if last is not None and can_id not in self.shared:
+            gap = (seq - last - 1) % 128
+            if gap >= SHARED_GAP:
+                # Several nodes send under this ID: their gaps say nothing about losses
+                self.shared.add(can_id)
+                self.lost.pop(can_id, None)
+            else:
+                self.lost[can_id] += gap
+        self.last_seq[can_id] = seq
+        if not synced or not self.clock.ready():
+            self.unsynced[can_id] += 1
+            return
+        delta = stamp_delta_ms(self.clock.to_ref_ms(msg.timestamp), value)
+        if abs(delta) > MAX_PLAUSIBLE_MS:
+            self.invalid[can_id] += 1
+            return
+        self.samples[("node->bus", can_id)].add(delta, self.rng)
+
+    def processed(self, msg, done=None):
+        """Record receive-to-verdict time for one frame (live mode)."""
+        done = time.time() if done is None else done
+        self.samples[("bus->ids", msg.arbitration_id)].add((done - msg.timestamp) * 1000.0, self.rng)
+
+    def report(self):
+        lines = ["=== LATENCY (ms) ==="]
+        if self.clock.n:
+            drift_ppm = (1.0 / self.clock.rate() - 1.0) * 1e6
+            lines.append(f"Reference clock: {self.clock.n} syncs, capture clock {drift_ppm:+.1f} ppm vs gateway, "
+                         f"{self.clock.resets} gateway restarts")
+        else:
+            lines.append("Reference clock: no time sync frames seen")
+        for (hop, can_id) in sorted(self.samples, key=lambda k: (k[0], k[1])):
+            s = self.samples[(hop, can_id)]
+            v = sorted(s.reservoir)
+            lines.append(f"  {hop:9s} 0x{can_id:03X}  n={s.n:6d}  p50 {_pct(v, 50):7.2f}  p95 {_pct(v, 95):7.2f}  "
+                         f"p99 {_pct(v, 99):7.2f}  max {s.max:7.2f}")
+        if self.stamped_ids:
+            lines.append(f"Stamped frames without a usable time sync: {sum(self.unsynced.values())}, "
+                         f"implausible stamps: {sum(self.invalid.values())}")
+        for can_id in sorted(k for k, v in self.lost.items() if v):
+            lines.append(f"  0x{can_id:03X}: {self.lost[can_id]} frames lost (sequence gaps)")
+        for can_id in sorted(self.shared):
+            lines.append(f"  0x{can_id:03X}: shared by several nodes (interleaved sequences), losses not counted")
+        return "\n".join(lines)
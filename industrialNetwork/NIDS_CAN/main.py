@@ -4,20 +4,52 @@ Network-Based IDS for CAN Bus
 Monitors traffic, detects anomalies, logs incidents
 """
 
+import argparse
+import os
+import sys
+import time
 import can
 import sqlite3
 from datetime import datetime
-from collections import defaultdict, deque
-import numpy as np
+from collections import deque
 import json
 import paho.mqtt.client as mqtt
 
+sys.path.insert(0, os.path.abspath(os.path.join(os.path.dirname(__file__), '..', '..')))
+from canlog.candump import CandumpReader
+from canlog.pcapng import PcapngWriter
+from changepoint import ChangeMonitor
+from adaptation import OnlineAdapter
+from baseline import StreamingBaseline
+from clockskew import ClockSkewMonitor
+from forensics import ForensicRecorder
+from incidents import IncidentCorrelator
+from latency import LatencyMonitor
+from model import BaselineModel, learn_from_archive
+
 class CANNetworkIDS:
-    def __init__(self, channel='can0', bitrate=500000, mqtt_broker='localhost', mqtt_port=1883):
-        """Initialize the network-based IDS"""
-        self.bus = can.interface.Bus(channel=channel, 
-                                     interface='socketcan',
-                                     bitrate=bitrate)
+    def __init__(self, channel='can0', bitrate=500000, mqtt_broker='localhost', mqtt_port=1883,
+                 offline=False, latency_ids=None, forensics=None, archive=None, incident_gap=5.0,
+                 skew_threshold=12.0, change_detector='cusum', rate_window=5.0, adapt_halflife=0.0,
+                 adapt_rate=1.0, adapt_holdoff=60.0, adapt_max_shift=3.0):
+        """Initialize the network-based IDS (offline=True skips opening the CAN bus;
+        latency_ids enables per-hop latency measurement for those stamped CAN IDs;
+        forensics is a ForensicRecorder that captures raw traffic around each anomaly;
+        archive is a pcapng path that receives every frame, anomalies as packet comments;
+        incident_gap is the quiet time in seconds after which an incident closes;
+        skew_threshold is the CUSUM alarm level of the clock-skew fingerprints, 0 disables them;
+        change_detector ('cusum', 'page-hinkley' or None) watches per-ID rates over rate_window
+        seconds and decoded sensor values for change points;
+        adapt_halflife > 0 lets frames that passed every check update the baseline (decay half-life
+        in seconds), moving it by at most adapt_rate standard deviations per hour and not within
+        adapt_holdoff seconds of an anomaly on the same ID; a reference that reaches adapt_max_shift
+        learned standard deviations stops there and raises a baseline_drift anomaly)"""
+        self.bus = None
+        self.offline = offline
+        if not offline:
+            self.bus = can.interface.Bus(channel=channel,
+                                         interface='socketcan',
+                                         bitrate=bitrate)
         
         # Initialize MQTT client
         self.mqtt_client = mqtt.Client()
@@ -41,21 +73,43 @@ class CANNetworkIDS:
         }
         
         # Baseline statistics (learned during normal operation)
-        self.message_frequency = defaultdict(deque)  # CAN ID -> list of timestamps
-        self.message_patterns = defaultdict(list)     # CAN ID -> payload patterns
+        self.baseline = StreamingBaseline()            # CAN ID -> interval/DLC/byte statistics + reservoir
         self.baseline_dlc = {}                         # CAN ID -> expected DLC
+        self.clock_skew = ClockSkewMonitor(threshold=skew_threshold) if skew_threshold > 0 else None
+        self.skew_reason = None
+        self.changes = (ChangeMonitor(change_detector, rate_window, stamped_ids=latency_ids or ())
+                        if change_detector else None)
+        self.change_reason = None
+        self.adapt_reason = None
+        self.model_path = None          # baseline loaded from a model file instead of learned
+        self.skew_learn_until = None
+        self.skew_learn_seconds = 60
+        self.adapter = (OnlineAdapter(adapt_halflife, adapt_rate, adapt_holdoff, adapt_max_shift)
+                        if adapt_halflife > 0 else None)
         
         # Tuning parameters
         self.window_size = 10
         self.frequency_threshold = 100  # msgs per second (too high = DoS)
         self.anomaly_threshold = 0.8    # Reconstruction error threshold
         
+        # Last frequency_threshold + 1 arrival times per known ID (DoS window)
+        self.recent_arrivals = {}
+        
         # Initialize database
         self._init_database()
+        self.incidents = IncidentCorrelator(self.conn, gap=incident_gap, publish=self._publish_incident)
         
         # Statistics
         self.message_count = 0
         self.anomaly_count = 0
+        self.latency = LatencyMonitor(latency_ids) if latency_ids is not None else None
+        self.forensics = forensics
+        if forensics:
+            forensics.on_lost = self._capture_lost
+        self.archive = None
+        if archive:
+            self.archive = PcapngWriter(archive)
+            self.archive_iface = self.archive.add_interface(channel)
     
     def _init_database(self):
         """Create SQLite database for logging"""
@@ -78,9 +132,17 @@ class CANNetworkIDS:
                 can_id INTEGER,
                 anomaly_type TEXT,
                 severity TEXT,
-                details TEXT
+                details TEXT,
+                capture_file TEXT
             )
         ''')
+        columns = [row[1] for row in self.cursor.execute("PRAGMA table_info(anomalies)")]
+        if 'capture_file' not in columns:
+            self.cursor.execute("ALTER TABLE anomalies ADD COLUMN capture_file TEXT")
+        if 'incident_id' not in columns:
+            self.cursor.execute("ALTER TABLE anomalies ADD COLUMN incident_id INTEGER")
+        # Incident merges re-point anomalies by incident_id
+        self.cursor.execute("CREATE INDEX IF NOT EXISTS idx_anomalies_incident ON anomalies(incident_id)")
         self.conn.commit()
     
     def learn_baseline(self, duration_seconds=60):
@@ -92,32 +154,101 @@ class CANNetworkIDS:
             msg = self.bus.recv(timeout=1)
             if msg is None:
                 continue
-            
-            # Record message frequency
-            self.message_frequency[msg.arbitration_id].append(
-                datetime.now().timestamp()
-            )
-            
-            # Record DLC
-            self.baseline_dlc[msg.arbitration_id] = msg.dlc
-            
-            # Record payload pattern
-            self.message_patterns[msg.arbitration_id].append(msg.data)
-            
-            self.message_count += 1
-        
-        print(f"Learned {len(self.message_frequency)} unique CAN IDs")
+            self._learn_message(msg)
+        
+        print(f"Learned {len(self.baseline)} unique CAN IDs")
+        self._finish_baseline()
+    
+    def load_model(self, path, skew_learn_seconds=60):
+        """Use a baseline model file (see --learn-from-archive) instead of a learning phase.
+        Clock-skew fingerprints are learned over the first skew_learn_seconds of monitoring."""
+        model = BaselineModel.load(path)
+        print(model.report())
+        self.model_path = path
+        self.baseline = model.baseline
+        # Expected DLC: the most common one over the whole archive (IDs only seen in flagged rows stay unknown)
+        self.baseline_dlc = {can_id: stats.common_dlc for can_id, stats in self.baseline.ids.items()
+                             if stats.payloads}
+        if self.changes:
+            if model.changes is None:
+                print("Model has no change-point statistics; change detection disabled")
+            elif model.changes.detector_name != self.changes.detector_name or \
+                    model.changes.rate_window != self.changes.rate_window:
+                print(f"Using the model's change detector ({model.changes.detector_name}, "
+                      f"{model.changes.rate_window}s rate window)")
+            self.changes = model.changes
+            if self.changes:
+                if self.latency:
+                    self.changes.stamped_ids |= self.latency.stamped_ids
+                self.changes.freeze()
+        if self.adapter:
+            self.adapter.attach(self.baseline, self.changes)
+        self.skew_learn_seconds = skew_learn_seconds
         self._print_baseline_stats()
     
+    def _learn_clock_skew(self, msg):
+        """Baseline from a model file: fingerprint senders over the first seconds of monitoring"""
+        if self.skew_learn_until is None:
+            self.skew_learn_until = msg.timestamp + self.skew_learn_seconds
+        if msg.timestamp < self.skew_learn_until:
+            self.clock_skew.learn(msg)
+            return
+        self.clock_skew.freeze()
+        print(self.clock_skew.report())
+    
+    def _learn_message(self, msg):
+        """Add one benign frame to the baseline"""
+        if self.latency:
+            self.latency.observe(msg)
+        if self.forensics:
+            self.forensics.push(msg)
+        if self.archive:
+            self.archive.write_frame(self.archive_iface, msg.timestamp, msg.arbitration_id,
+                                     msg.is_extended_id, msg.data)
+        # Record interval, DLC and payload statistics
+        self.baseline.learn(msg.arbitration_id, msg.timestamp, msg.data)
+        self._record_arrival(msg)
+        
+        if self.clock_skew:
+            self.clock_skew.learn(msg)
+        if self.changes:
+            self.changes.learn(msg)
+        
+        # Record DLC
+        self.baseline_dlc[msg.arbitration_id] = msg.dlc
+        
+        self.message_count += 1
+    
+    def _record_arrival(self, msg):
+        """Append to the ID's bounded DoS window (baseline IDs only; others are unknown_id anyway)"""
+        window = self.recent_arrivals.get(msg.arbitration_id)
+        if window is None:
+            if msg.arbitration_id not in self.baseline:
+                return
+            window = self.recent_arrivals[msg.arbitration_id] = deque(maxlen=self.frequency_threshold + 1)
+        window.append(msg.timestamp)
+    
+    def _finish_baseline(self):
+        """End of learning: freeze the clock-skew fingerprints and show the baseline"""
+        if self.clock_skew:
+            self.clock_skew.freeze()
+        if self.changes:
+            self.changes.freeze()
+        if self.adapter:
+            self.adapter.attach(self.baseline, self.changes)
+        self._print_baseline_stats()
+        if self.clock_skew:
+            print(self.clock_skew.report())
+    
     def _print_baseline_stats(self):
         """Display learned baseline statistics"""
         print("\n=== BASELINE STATISTICS ===")
-        for can_id, timestamps in sorted(self.message_frequency.items()):
-            if len(timestamps) > 1:
-                intervals = np.diff(timestamps)
-                freq = len(timestamps)
-                print(f"CAN ID 0x{can_id:03X}: {freq} msgs, "
-                      f"avg interval: {np.mean(intervals)*1000:.1f}ms")
+        for can_id, stats in sorted(self.baseline.ids.items()):
+            if stats.iv_n:
+                print(f"CAN ID 0x{can_id:03X}: {stats.count} msgs, "
+                      f"avg interval: {stats.iv_mean*1000:.1f}ms "
+                      f"(sd {stats.interval_std*1000:.1f}, min {stats.iv_min*1000:.1f}, max {stats.iv_max*1000:.1f}), "
+                      f"DLC {stats.common_dlc}")
     
     def _detect_anomalies(self, msg):
         """
@@ -150,31 +281,34 @@ class CANNetworkIDS:
                 break
         
         # Check 4: Frequency analysis (DoS detection)
-        if can_id in self.message_frequency:
-            recent_msgs = self.message_frequency[can_id]
-            # Keep only last second of messages
-            now = datetime.now().timestamp()
-            recent_msgs = [t for t in recent_msgs 
-                         if now - t < 1.0]
-            
-            if len(recent_msgs) > self.frequency_threshold:
+        window = self.recent_arrivals.get(can_id)
+        if window is not None:
+            # More than frequency_threshold messages in the last second: the bounded
+            # window is full and its oldest entry is less than a second old
+            if len(window) == window.maxlen and msg.timestamp - window[0] < 1.0:
                 anomalies.append(("dos_attack", "CRITICAL"))
         
-        # Check 5: Pattern deviation (fuzzing detection)
-        if can_id in self.message_patterns:
-            baseline_patterns = self.message_patterns[can_id]
-            if baseline_patterns:
-                baseline_data = np.array(
-                    [list(p) for p in baseline_patterns]
-                )
-                curr_data = np.array(list(msg.data))
-                
-                # Calculate deviation from mean pattern
-                mean_pattern = np.mean(baseline_data, axis=0)
-                deviation = np.abs(curr_data - mean_pattern).mean()
-                
-                if deviation > 50:  # Threshold in bytes
-                    anomalies.append(("pattern_deviation", "MEDIUM"))
+        # Check 5: Clock-skew fingerprint (sender impersonation)
+        if self.clock_skew and self.clock_skew.frozen:
+            reason = self.clock_skew.check(msg)
+            if reason:
+                anomalies.append(("sender_impersonation", "HIGH"))
+                self.skew_reason = reason
+        
+        # Check 6: Change points in rate or sensor value (low-and-slow attacks, drifts)
+        if self.changes and self.changes.frozen:
+            change = self.changes.check(msg)
+            if change:
+                anomalies.append((change[0], "HIGH" if change[0] == "rate_change" else "MEDIUM"))
+                self.change_reason = change[1]
+        
+        # Check 7: Pattern deviation (fuzzing detection)
+        stats = self.baseline.get(can_id)
+        if stats is not None:
+            # Mean absolute deviation from the baseline's mean payload
+            deviation = stats.deviation(msg.data)
+            if deviation is not None and deviation > 50:  # Threshold in bytes
+                anomalies.append(("pattern_deviation", "MEDIUM"))
         
         if anomalies:
             return True, anomalies[0][0], anomalies[0][1]
@@ -189,39 +323,107 @@ class CANNetworkIDS:
                 msg = self.bus.recv(timeout=1)
                 
                 if msg is None:
+                    if self.forensics:
+                        self.forensics.poll()
+                    self.incidents.expire(time.time())
                     continue
-                
-                # Update statistics
-                self.message_frequency[msg.arbitration_id].append(
-                    datetime.now().timestamp()
-                )
-                self.message_count += 1
-                
-                # Detect anomalies
-                is_anomaly, anom_type, severity = self._detect_anomalies(msg)
-                
-                # Log message
-                self._log_message(msg, is_anomaly)
-                
-                if is_anomaly:
-                    self._handle_anomaly(msg, anom_type, severity)
-                
-                # Periodic stats
-                if self.message_count % 1000 == 0:
-                    self._print_stats()
+                self._process_message(msg)
         
         except KeyboardInterrupt:
             print("\nIDS Stopped.")
         finally:
+            if self.latency:
+                print(self.latency.report())
+            self._cleanup()
+    
+    def run_offline(self, path, learn_seconds=60):
+        """Offline mode: learn from the first learn_seconds of a candump capture, then analyze the rest"""
+        print(f"Offline analysis of {path} (baseline from first {learn_seconds}s of capture)")
+        reader = CandumpReader(path)
+        learn_until = None
+        learning = self.model_path is None
+        try:
+            for frames in reader:
+                for msg in self._frames_to_messages(frames):
+                    if learn_until is None:
+                        learn_until = msg.timestamp + learn_seconds
+                    if learning and msg.timestamp < learn_until:
+                        self._learn_message(msg)
+                        continue
+                    if learning:
+                        learning = False
+                        print(f"Learned {len(self.baseline)} unique CAN IDs")
+                        self._finish_baseline()
+                    self._process_message(msg)
+        except KeyboardInterrupt:
+            print("\nIDS Stopped.")
+        finally:
+            report = reader.report()
+            if report:
+                print(report)
+            print(f"Parsed {reader.frame_count} frames")
+            self._print_stats()
+            if self.latency:
+                print(self.latency.report())
             self._cleanup()
     
+    @staticmethod
+    def _frames_to_messages(frames):
+        """Convert a candump FRAME_DTYPE array into python-can messages"""
+        data = frames['data'].tobytes()
+        for i, (ts, can_id, ext, dlc) in enumerate(zip(frames['ts'].tolist(), frames['id'].tolist(),
+                                                        frames['ext'].tolist(), frames['dlc'].tolist())):
+            yield can.Message(timestamp=ts, arbitration_id=can_id, is_extended_id=ext,
+                              dlc=dlc, data=data[i * 8:i * 8 + dlc])
+    
+    def _process_message(self, msg):
+        """Run detection and logging for one frame"""
+        if self.latency:
+            self.latency.observe(msg)
+        if self.forensics:
+            self.forensics.push(msg)
+        # Update statistics
+        self._record_arrival(msg)
+        self.message_count += 1
+        if self.clock_skew and not self.clock_skew.frozen:
+            self._learn_clock_skew(msg)
+        
+        # Detect anomalies
+        is_anomaly, anom_type, severity = self._detect_anomalies(msg)
+        if self.adapter:
+            # Only frames every detector accepted may move the baseline, and
+            # a reference pinned at its bound is itself an anomaly
+            if is_anomaly:
+                self.adapter.anomaly(msg, anom_type)
+            else:
+                reason = self.adapter.update(msg)
+                if reason:
+                    self.adapt_reason = reason
+                    is_anomaly, anom_type, severity = True, "baseline_drift", "MEDIUM"
+        
+        # Log message
+        self._log_message(msg, is_anomaly)
+        if self.archive:
+            self.archive.write_frame(self.archive_iface, msg.timestamp, msg.arbitration_id, msg.is_extended_id,
+                                     msg.data, comment=f"{anom_type} {severity}" if is_anomaly else None)
+        
+        if is_anomaly:
+            self._handle_anomaly(msg, anom_type, severity)
+        if self.latency and not self.offline:
+            self.latency.processed(msg, time.time())
+        
+        # Periodic stats
+        if self.message_count % 1000 == 0:
+            self._print_stats()
+            self.incidents.flush()
+    
     def _log_message(self, msg, is_anomaly):
         """Log message to database"""
         self.cursor.execute('''
             INSERT INTO messages 
             (timestamp, can_id, dlc, data, is_anomaly)
             VALUES (?, ?, ?, ?, ?)
-        ''', (datetime.now().timestamp(), msg.arbitration_id, 
+        ''', (msg.timestamp, msg.arbitration_id, 
               msg.dlc, msg.data.hex(), is_anomaly))
         
         if self.message_count % 100 == 0:
@@ -236,21 +438,41 @@ class CANNetworkIDS:
         print(f"   Type: {anom_type}")
         print(f"   CAN ID: 0x{msg.arbitration_id:03X}")
         print(f"   Data: {msg.data.hex()}")
-        print(f"   Timestamp: {datetime.now().isoformat()}")
+        print(f"   Timestamp: {datetime.fromtimestamp(msg.timestamp).isoformat()}")
+        details = msg.data.hex()
+        if anom_type == "sender_impersonation":
+            print(f"   Clock: {self.skew_reason}")
+            details = f"{details} ({self.skew_reason})"
+        elif anom_type in ("rate_change", "value_drift"):
+            print(f"   Change: {self.change_reason}")
+            details = f"{details} ({self.change_reason})"
+        elif anom_type == "baseline_drift":
+            print(f"   Adaptation: {self.adapt_reason}")
+            details = f"{details} ({self.adapt_reason})"
+        capture_file = self.forensics.trigger(msg.timestamp, f"{anom_type} {severity}") if self.forensics else None
+        if capture_file:
+            print(f"   Capture: {capture_file}")
+        incident = self.incidents.observe(msg.timestamp, msg.arbitration_id, anom_type, severity)
+        print(f"   Incident: #{incident.id} ({incident.signature}, {incident.count} anomalies, {incident.severity})")
         
         # Log to database
         self.cursor.execute('''
             INSERT INTO anomalies 
-            (timestamp, can_id, anomaly_type, severity, details)
-            VALUES (?, ?, ?, ?, ?)
-        ''', (datetime.now().timestamp(), msg.arbitration_id,
-              anom_type, severity, msg.data.hex()))
+            (timestamp, can_id, anomaly_type, severity, details, capture_file, incident_id)
+            VALUES (?, ?, ?, ?, ?, ?, ?)
+        ''', (msg.timestamp, msg.arbitration_id,
+              anom_type, severity, details, capture_file, incident.id))
         self.conn.commit()
         
         # Action based on severity
         if severity == "CRITICAL":
             self._trigger_alert(msg, anom_type)
     
+    def _capture_lost(self, path):
+        """A forensic capture was dropped or failed: its anomalies must not point at a missing file."""
+        self.cursor.execute("UPDATE anomalies SET capture_file = NULL WHERE capture_file = ?", (path,))
+        self.conn.commit()
+
     def _trigger_alert(self, msg, anom_type):
         """Trigger protective actions"""
         # Option 1: Log and notify
@@ -280,6 +502,15 @@ class CANNetworkIDS:
         
         print(f"   ACTION: Alert triggered for {anom_type}")
     
+    def _publish_incident(self, event, incident):
+        """Publish incident lifecycle events (opened, escalated, closed) to ids/incidents"""
+        print(f"   INCIDENT #{incident['incident']} {event}: {incident['signature']}, "
+              f"{incident['anomalies']} anomalies, {incident['severity']}")
+        try:
+            self.mqtt_client.publish("ids/incidents", json.dumps(dict(incident, event=event)), qos=1)
+        except Exception as e:
+            print(f"   ERROR: Could not publish incident: {e}")
+    
     def _print_stats(self):
         """Print IDS statistics"""
         detection_rate = (self.anomaly_count / self.message_count * 100) \
@@ -291,17 +522,118 @@ class CANNetworkIDS:
     
     def _cleanup(self):
         """Cleanup resources"""
+        self.incidents.close_all()
+        print(self.incidents.report())
+        if self.clock_skew and self.clock_skew.frozen:
+            print(self.clock_skew.report())
+        if self.changes and self.changes.frozen:
+            print(self.changes.report())
+        if self.adapter and self.adapter.baseline is not None:
+            print(self.adapter.report())
+        if self.forensics:
+            self.forensics.close()
+            print(self.forensics.report())
+        if self.archive:
+            self.archive.close()
+            print(f"Archived {self.archive.frames} frames to {self.archive.file.name}")
         self.mqtt_client.loop_stop()
         self.mqtt_client.disconnect()
+        self.conn.commit()
         self.conn.close()
-        self.bus.shutdown()
+        if self.bus is not None:
+            self.bus.shutdown()
 
 if __name__ == '__main__':
-    # Create IDS instance
-    ids = CANNetworkIDS(channel='can0', bitrate=500000)
+    parser = argparse.ArgumentParser(description="Network-Based IDS for CAN Bus")
+    parser.add_argument('--channel', default='can0', help="SocketCAN interface (e.g., can0, vcan0)")
+    parser.add_argument('--bitrate', type=int, default=500000, help="Bus bitrate in bps")
+    parser.add_argument('--learn-seconds', type=float, default=60, help="Baseline learning window in seconds")
+    parser.add_argument('--offline', metavar='CANDUMP', default=None,
+                        help="Analyze a candump log instead of the live bus")
+    parser.add_argument('--latency-ids', default=None, metavar='IDS',
+                        help="Comma-separated CAN IDs carrying network-time stamps (e.g., 0x036,0x701); "
+                             "enables per-hop latency reporting ('' = sync and bus->ids only) and tells the "
+                             "change detector to decode their values ahead of the stamp")
+    parser.add_argument('--forensics-dir', default=None, metavar='DIR',
+                        help="Write a candump capture of the traffic around each anomaly into DIR "
+                             "(referenced from the anomalies table)")
+    parser.add_argument('--forensics-format', choices=['candump', 'pcapng'], default='candump',
+                        help="Forensic capture format (pcapng opens in Wireshark, anomalies as packet comments)")
+    parser.add_argument('--forensics-pre', type=float, default=5.0, help="Seconds captured before an anomaly")
+    parser.add_argument('--forensics-post', type=float, default=5.0, help="Seconds captured after an anomaly")
+    parser.add_argument('--forensics-rate', type=float, default=5000.0,
+                        help="Peak bus rate (frames/s) the capture ring is sized for")
+    parser.add_argument('--incident-gap', type=float, default=5.0,
+                        help="Seconds without a related anomaly after which an incident closes")
+    parser.add_argument('--skew-threshold', type=float, default=12.0,
+                        help="CUSUM alarm level of the per-ID clock-skew fingerprints (0 disables them)")
+    parser.add_argument('--change-detector', choices=['cusum', 'page-hinkley', 'off'], default='cusum',
+                        help="Per-ID change-point detector on frame rates and sensor values")
+    parser.add_argument('--rate-window', type=float, default=5.0,
+                        help="Window in seconds over which per-ID frame rates are counted")
+    parser.add_argument('--archive', default=None, metavar='PCAPNG',
+                        help="Also write every frame seen to a pcapng capture, anomalies as packet comments")
+    parser.add_argument('--adapt-halflife', type=float, default=0.0,
+                        help="Half-life in seconds of the online baseline adaptation fed by accepted frames "
+                             "(0 keeps the learned baseline fixed; e.g. 900 to follow slow drift)")
+    parser.add_argument('--adapt-rate', type=float, default=1.0,
+                        help="Fastest the adapted baseline may move, in learned standard deviations per hour")
+    parser.add_argument('--adapt-holdoff', type=float, default=60.0,
+                        help="Seconds after an anomaly during which frames of that CAN ID do not adapt the baseline")
+    parser.add_argument('--adapt-max-shift', type=float, default=3.0,
+                        help="Furthest the adapted baseline may move from the learned one, in learned standard "
+                             "deviations; reaching it raises a baseline_drift anomaly")
+    parser.add_argument('--learn-from-archive', nargs='+', default=None, metavar='SOURCE',
+                        help="Learn the baseline from stored captures (can_ids.db, candump logs, pcapng archives) "
+                             "and write it to --model instead of monitoring")
+    parser.add_argument('--model', default=None, metavar='FILE',
+                        help="Baseline model file: written by --learn-from-archive, otherwise loaded instead of "
+                             "a learning phase (--learn-seconds then only fingerprints sender clocks)")
+    parser.add_argument('--workers', type=int, default=None,
+                        help="Worker processes for --learn-from-archive (default: one per CPU core)")
+    parser.add_argument('--chunk-mb', type=float, default=64.0,
+                        help="Capture file chunk size in MiB for --learn-from-archive (1M rows per database chunk)")
+    parser.add_argument('--include-flagged', action='store_true',
+                        help="With --learn-from-archive, also learn the DLC and payload of database rows the IDS "
+                             "flagged as anomalous (their timing is always learned)")
+    args = parser.parse_args()
+    latency_ids = None
+    if args.latency_ids is not None:
+        latency_ids = [int(x, 0) for x in args.latency_ids.split(',') if x.strip()]
+    
+    if args.learn_from_archive:
+        model = learn_from_archive(args.learn_from_archive, workers=args.workers,
+                                   detector=None if args.change_detector == 'off' else args.change_detector,
+                                   rate_window=args.rate_window, chunk_bytes=max(int(args.chunk_mb * (1 << 20)), 1),
+                                   include_flagged=args.include_flagged, stamped_ids=latency_ids or ())
+        model_path = args.model or 'baseline_model.json'
+        model.save(model_path)
+        print(model.report())
+        print(f"Model written to {model_path}")
+        sys.exit(0)
     
-    # Learn normal traffic patterns (60 seconds of normal operation)
-    ids.learn_baseline(duration_seconds=60)
+    forensics = None
+    if args.forensics_dir:
+        forensics = ForensicRecorder(args.forensics_dir, args.forensics_pre, args.forensics_post,
+                                     args.forensics_rate, channel=args.channel, fmt=args.forensics_format)
     
-    # Start monitoring
-    ids.run()
+    # Create IDS instance
+    ids = CANNetworkIDS(channel=args.channel, bitrate=args.bitrate, offline=bool(args.offline),
+                        latency_ids=latency_ids, forensics=forensics, archive=args.archive,
+                        incident_gap=args.incident_gap, skew_threshold=args.skew_threshold,
+                        change_detector=None if args.change_detector == 'off' else args.change_detector,
+                        rate_window=args.rate_window, adapt_halflife=args.adapt_halflife,
+                        adapt_rate=args.adapt_rate, adapt_holdoff=args.adapt_holdoff,
+                        adapt_max_shift=args.adapt_max_shift)
+    if args.model:
+        ids.load_model(args.model, skew_learn_seconds=args.learn_seconds)
+    
+    if args.offline:
+        ids.run_offline(args.offline, learn_seconds=args.learn_seconds)
+    else:
+        if not args.model:
+            # Learn normal traffic patterns (60 seconds of normal operation)
+            ids.learn_baseline(duration_seconds=args.learn_seconds)
+        
+        # Start monitoring
+        ids.run()
@@ -0,0 +1,230 @@
+"""
+Persisted baseline models, learned from archived traffic
+
+A BaselineModel holds what the IDS learns before monitoring, in mergeable
+form: the streaming per-ID baseline (baseline.py) and the change-point
+series (changepoint.py). It can be learned live, frame by frame, or from
+stored captures by learn_from_archive():
+
+- map: the sources (the IDS's own can_ids.db, candump logs, pcapng
+  archives) are cut into chunks (byte ranges of files, row-id ranges of the
+  messages table) and each worker process learns one partial model per
+  chunk. The readers split files at arbitrary offsets without losing or
+  duplicating frames. Database rows the IDS flagged (is_anomaly) count
+  towards the timing and rate statistics, so the per-ID rates have no holes,
+  but their DLC, payload and value are not learned, so recorded attacks do
+  not become the expected content. include_flagged learns them in full.
+  Capture files carry no verdicts and are learned in full, like a live
+  learning window;
+- reduce: partial models are merged in chunk order. Merging is exact for
+  the moments and histograms, adds the inter-arrival gap across each
+  boundary between contiguous chunks, and keeps reservoir samples uniform
+  over the union. Chunks are seeded by their index, so the model does not
+  depend on the number of workers.
+
+Clock-skew fingerprints are not part of the model: they are tied to one
+continuous timeline of the receiver's clock, so an IDS started from a model
+file learns them over its first --learn-seconds of traffic.
+
+The model file is JSON (format "can-ids-baseline", version 1).
+"""
+import json
+import os
+import sqlite3
+import time
+from datetime import datetime
+from multiprocessing import Pool
+from typing import List, Optional, Sequence, Tuple
+
+from canlog.candump import CandumpReader
+from canlog.pcapng import PcapngReader
+from baseline import StreamingBaseline
+from changepoint import EXT_KEY, ChangeMonitor
+
+MODEL_FORMAT = "can-ids-baseline"
+MODEL_VERSION = 1
+DB_SUFFIXES = (".db", ".sqlite", ".sqlite3")
+DB_BATCH = 10000
+
+# (kind, path, start, end): byte range of a capture file or [start, end) row ids of the messages table
+Chunk = Tuple[str, str, int, int]
+
+
+class BaselineModel:
+    def __init__(self, detector: Optional[str] = "cusum", rate_window: float = 5.0, seed: int = 0,
+                 stamped_ids=()):
+        self.baseline = StreamingBaseline(seed)
+        self.changes = ChangeMonitor(detector, rate_window, stamped_ids=stamped_ids) if detector else None
+        self.frames = 0
+        self.start: Optional[float] = None
+        self.end: Optional[float] = None
+        self.sources: List[str] = []
+        self.malformed = 0
+        self.skipped = 0
+
+    def learn(self, can_id: int, ext: bool, ts: float, data: bytes, timing_only: bool = False):
+        self.baseline.learn(can_id, ts, data, timing_only)
+        if self.changes:
+            self.changes.learn_frame(can_id | (EXT_KEY if ext else 0), ts, data, timing_only)
+        self.frames += 1
+        if self.start is None or ts < self.start:
+            self.start = ts
+        if self.end is None or ts > self.end:
+            self.end = ts
+
+    def learn_frames(self, frames):
+        """Learn a canlog.candump.FRAME_DTYPE array."""
+        data = frames["data"].tobytes()
+        learn = self.learn
+        for i, (ts, can_id, ext, dlc) in enumerate(zip(frames["ts"].tolist(), frames["id"].tolist(),
+                                                        frames["ext"].tolist(), frames["dlc"].tolist())):
+            learn(can_id, ext, ts, data[i * 8:i * 8 + dlc])
+
+    def merge(self, other: "BaselineModel", contiguous: bool = False):
+        """Fold in a model learned on a later chunk (contiguous: it directly follows this one)."""
+        self.baseline.merge(other.baseline, contiguous)
+        if self.changes and other.changes:
+            self.changes.merge(other.changes)
+        self.frames += other.frames
+        if other.start is not None:
+            self.start = other.start if self.start is None else min(self.start, other.start)
+            self.end = other.end if self.end is None else max(self.end, other.end)
+        self.sources += [s for s in other.sources if s not in self.sources]
+        self.malformed += other.malformed
+        self.skipped += other.skipped
+
+    def save(self, path: str):
+        doc = {
+            "format": MODEL_FORMAT,
+            "version": MODEL_VERSION,
+            "created": datetime.now().isoformat(timespec="seconds"),
+            "sources": self.sources,
+            "frames": self.frames,
+            "start": self.start,
+            "end": self.end,
+            "baseline": self.baseline.to_dict(),
+            "changes": self.changes.to_dict() if self.changes else None,
+        }
+        tmp = f"{path}.tmp"
+        with open(tmp, "w") as f:
+            json.dump(doc, f)
+        os.replace(tmp, path)
+
+    @classmethod
+    def load(cls, path: str) -> "BaselineModel":
+        try:
+            with open(path) as f:
+                doc = json.load(f)
+        except (UnicodeDecodeError, json.JSONDecodeError):
+            doc = {}
+        if not isinstance(doc, dict) or doc.get("format") != MODEL_FORMAT or doc.get("version") != MODEL_VERSION:
+            raise ValueError(f"{path}: not a version {MODEL_VERSION} {MODEL_FORMAT} model")
+        model = cls(detector=None)
+        model.baseline = StreamingBaseline.from_dict(doc["baseline"])
+        model.changes = ChangeMonitor.from_dict(doc["changes"]) if doc["changes"] else None
+        model.frames = doc["frames"]
+        model.start = doc["start"]
+        model.end = doc["end"]
+        model.sources = doc["sources"]
+        return model
+
+    def report(self) -> str:
+        span = (self.end - self.start) / 3600.0 if self.frames else 0.0
+        return (f"Baseline model: {self.frames} frames over {span:.1f} h from {len(self.sources)} source(s), "
+                f"{len(self.baseline)} CAN IDs")
+
+
+def source_kind(path: str) -> str:
+    if path.lower().endswith(DB_SUFFIXES):
+        return "db"
+    if path.lower().endswith(".pcapng"):
+        return "pcapng"
+    return "candump"
+
+
+def plan_chunks(sources: Sequence[str], chunk_bytes: int, chunk_rows: int) -> List[Chunk]:
+    """Cut every source into chunks, in source order and time order within a source."""
+    chunks: List[Chunk] = []
+    for path in sources:
+        kind = source_kind(path)
+        if kind == "db":
+            conn = sqlite3.connect(f"file:{path}?mode=ro", uri=True)
+            lo, hi = conn.execute("SELECT MIN(id), MAX(id) FROM messages").fetchone()
+            conn.close()
+            if lo is None:
+                continue
+            chunks += [(kind, path, a, min(a + chunk_rows, hi + 1)) for a in range(lo, hi + 1, chunk_rows)]
+        else:
+            size = os.path.getsize(path)
+            chunks += [(kind, path, a, min(a + chunk_bytes, size)) for a in range(0, size, chunk_bytes)]
+    return chunks
+
+
+def learn_chunk(job: Tuple[int, Chunk, Optional[str], float, bool, Tuple[int, ...]]) -> BaselineModel:
+    """Map step: partial model of one chunk (runs in a worker process)."""
+    index, (kind, path, start, end), detector, rate_window, include_flagged, stamped_ids = job
+    model = BaselineModel(detector, rate_window, seed=index, stamped_ids=stamped_ids)
+    model.sources = [path]
+    if kind == "db":
+        conn = sqlite3.connect(f"file:{path}?mode=ro", uri=True)
+        cur = conn.execute("SELECT timestamp, can_id, data, is_anomaly FROM messages "
+                           "WHERE id >= ? AND id < ? ORDER BY id", (start, end))
+        while True:
+            rows = cur.fetchmany(DB_BATCH)
+            if not rows:
+                break
+            for ts, can_id, data, flagged in rows:
+                # The messages table has no IDE flag; IDs above 11 bits are extended
+                model.learn(can_id, can_id > 0x7FF, ts, bytes.fromhex(data), bool(flagged) and not include_flagged)
+        conn.close()
+    else:
+        reader = (PcapngReader if kind == "pcapng" else CandumpReader)(path, start=start, end=end)
+        for frames in reader:
+            model.learn_frames(frames)
+        if kind == "pcapng":
+            model.skipped = reader.skipped
+        else:
+            model.malformed = reader.malformed_count
+    return model
+
+
+def learn_from_archive(sources: Sequence[str], workers: Optional[int] = None, detector: Optional[str] = "cusum",
+                       rate_window: float = 5.0, chunk_bytes: int = 64 << 20, chunk_rows: int = 1000000,
+                       include_flagged: bool = False, stamped_ids: Sequence[int] = ()) -> BaselineModel:
+    """Learn one model from stored captures: a partial model per chunk across `workers` processes, merged in order.
+
+    Database rows flagged as anomalous only add timing unless include_flagged; frames
+    of stamped_ids carry a network-time stamp after their value.
+    """
+    chunks = plan_chunks(sources, chunk_bytes, chunk_rows)
+    stamped_ids = tuple(stamped_ids)
+    jobs = [(i, chunk, detector, rate_window, include_flagged, stamped_ids) for i, chunk in enumerate(chunks)]
+    workers = max(1, min(workers or os.cpu_count() or 1, len(jobs)))
+    print(f"Learning from {len(sources)} source(s): {len(chunks)} chunks on {workers} worker(s)")
+    t0 = time.time()
+    model = BaselineModel(detector, rate_window, stamped_ids=stamped_ids)
+    model.sources = list(sources)
+    previous = None
+    if workers == 1:
+        parts = map(learn_chunk, jobs)
+        pool = None
+    else:
+        pool = Pool(workers)
+        parts = pool.imap(learn_chunk, jobs)
+    try:
+        for chunk, part in zip(chunks, parts):
+            # Byte or row ranges of one source follow each other without a gap
+            model.merge(part, contiguous=previous is not None and previous[1] == chunk[1])
+            previous = chunk
+    finally:
+        if pool is not None:
+            pool.close()
+            pool.join()
+    elapsed = time.time() - t0
+    rate = model.frames / elapsed if elapsed > 0 else 0.0
+    print(f"Learned {model.frames} frames in {elapsed:.1f}s ({rate:.0f} frames/s)")
+    if model.malformed:
+        print(f"Skipped {model.malformed} malformed candump line(s)")
+    if model.skipped:
+        print(f"Skipped {model.skipped} pcapng packet(s) (not classic CAN data frames)")
+    return model
@@ -72,6 +72,30 @@
 #define PERIOD_2S                               8192
 #define PERIOD_4S                               16384
 
+/* Slot sync: every SLOT_CYCLE_MS the gateway sends SLOT_SYNC_ID (cycle length
+ * in ms, 2 bytes BE). SLOT_ASSIGN_ID frames (target node ID, phase offset in
+ * ms, 2 bytes BE each) go out SLOT_ASSIGNS_PER_CYCLE per cycle until every
+ * node has been assigned once, then SLOT_REFRESH_PER_CYCLE per cycle. They
+ * are spread evenly over the cycle, one frame at a time, so the high-priority
+ * IDs never burst ahead of the barrier frames and a node that is busy when
+ * one arrives still has a free RX buffer for it. Node IDs 1..SLOT_NODE_COUNT
+ * are flashed into the sketches (NODE_ID), one per board, so nodes that share
+ * a CAN ID still get their own slot. Nodes send their periodic frame at
+ * sync + offset, so 1 s sensors that booted together no longer burst.
+ * The sync frame also carries the network reference time: sequence (1 byte)
+ * and gateway milliseconds (4 bytes BE) at the moment it is queued. */
+#define SLOT_SYNC_ID                            0x010
+#define SLOT_ASSIGN_ID                          0x011
+#define SLOT_CYCLE_MS                           1000
+#define SLOT_CYCLE_TICKS                        2       // TMR1 expiries (500 ms) per cycle
+#define SLOT_GUARD_MS                           10      // keep the first slot clear of the sync frame
+#define SLOT_TAIL_MS                            30      // and the last node's reading (up to 30 ms) clear of the next one
+#define SLOT_NODE_COUNT                         2       // slotted nodes in the lot (NODE_ID 1..N)
+#define SLOT_ASSIGNS_PER_CYCLE                  8       // first round after boot
+#define SLOT_REFRESH_PER_CYCLE                  1       // afterwards, for nodes that rebooted
+#define TMR1_PERIOD_MS                          500
+#define TMR1_CLOCK_HZ                           4096
+
 // *****************************************************************************
 // *****************************************************************************
 // Section: Globals
@@ -117,6 +141,15 @@ bool rx_status = false;
 
 bool deviceResetRequested = false;
 
+static uint8_t slotTick = 0;
+static uint16_t slotNext = 1;                  // next node ID to assign
+static bool slotRoundDone = false;             // every node ID assigned once since boot
+static uint32_t slotCycleMs = 0;               // reference time of the last sync
+static uint8_t slotAssigns = 0;                // assignments planned this cycle
+static uint8_t slotAssignsSent = 0;
+static uint8_t syncSeq = 0;
+static volatile uint32_t gatewayMillis = 0;    // advanced by the TMR1 ISR
+
 const IdRange idRanges[] = {
     { RANGE_TEMP_START, RANGE_TEMP_END },
     { RANGE_AIR_QUALITY_START, RANGE_AIR_QUALITY_END },
@@ -140,6 +173,10 @@ static void i2cEventHandler(uintptr_t contextHandle);
 static void UARTDmaChannelHandler(DMAC_TRANSFER_EVENT event, uintptr_t contextHandle);
 static void MCP9808TempSensorInit(void);
 static uint8_t getTemperature(uint8_t* rawTempValue);
+static void broadcastSlotSync(void);
+static bool sendSlotAssign(void);
+static void serviceSlotAssigns(void);
+static uint32_t referenceMillis(void);
 
 // *****************************************************************************
 // *****************************************************************************
@@ -197,6 +234,7 @@ static void tmr1EventHandler (uint32_t intCause, uintptr_t context)
 {
     (void)intCause;
     (void)context;
+    gatewayMillis += TMR1_PERIOD_MS;
     isTmr1Expired = true;
 }
 
@@ -252,6 +290,103 @@ static uint8_t getTemperature(uint8_t* rawTempValue)
     return (uint8_t)fTemp;
 }
 
+/* Network reference time: whole timer periods plus the running TMR1 count.
+ * Re-read if the ISR advanced gatewayMillis in between. */
+static uint32_t referenceMillis(void)
+{
+    uint32_t ms;
+    uint32_t count;
+    do
+    {
+        ms = gatewayMillis;
+        count = TMR1_CounterGet();
+    } while (ms != gatewayMillis);
+    return ms + (count * 1000UL) / TMR1_CLOCK_HZ;
+}
+
+/* Phase offset of node ID 1..SLOT_NODE_COUNT: the 1 s sensors are spread
+ * evenly over the cycle, away from the sync frame. A node that is still
+ * measuring when the sync arrives reads it late and re-anchors late, hence
+ * the tail */
+static uint16_t slotOffsetMs(uint16_t nodeId)
+{
+    return SLOT_GUARD_MS + (uint32_t)(nodeId - 1) * (SLOT_CYCLE_MS - SLOT_GUARD_MS - SLOT_TAIL_MS) / SLOT_NODE_COUNT;
+}
+
+/* Next assignment, round robin over the node IDs; true when it completes a round */
+static bool sendSlotAssign(void)
+{
+    uint8_t payload[4];
+    uint16_t offset;
+    bool roundEnd = (slotNext == SLOT_NODE_COUNT);
+
+    offset = slotOffsetMs(slotNext);
+    payload[0] = (slotNext >> 8) & 0xFF;
+    payload[1] = slotNext & 0xFF;
+    payload[2] = (offset >> 8) & 0xFF;
+    payload[3] = offset & 0xFF;
+    CAN2_MessageTransmit(SLOT_ASSIGN_ID, 4, payload, TxfifoQueue, CAN_MSG_TX_DATA_FRAME);
+    slotNext = (slotNext % SLOT_NODE_COUNT) + 1;
+    return roundEnd;
+}
+
+/* Called from the main loop: assignment k of the cycle goes out at
+ * sync + (k + 1/2) * SLOT_CYCLE_MS / slotAssigns, e.g. 62, 187, ... 937 ms in
+ * the first round and 500 ms for a refresh */
+static void serviceSlotAssigns(void)
+{
+    uint32_t spacing;
+
+    if (slotAssignsSent >= slotAssigns || CAN2_TxFIFOIsFull(TxfifoQueue))
+    {
+        return;
+    }
+    spacing = SLOT_CYCLE_MS / slotAssigns;
+    if ((int32_t)(referenceMillis() - (slotCycleMs + spacing / 2 + slotAssignsSent * spacing)) < 0)
+    {
+        return;
+    }
+    if (sendSlotAssign() && !slotRoundDone)
+    {
+        /* First round complete: refreshes from the next cycle on */
+        slotRoundDone = true;
+        slotAssigns = slotAssignsSent + 1;
+    }
+    slotAssignsSent++;
+}
+
+/* Slot sync frame; plans the cycle's assignments: SLOT_ASSIGNS_PER_CYCLE
+ * until the first round is done (SLOT_NODE_COUNT / SLOT_ASSIGNS_PER_CYCLE
+ * cycles after boot), then SLOT_REFRESH_PER_CYCLE, so a node that reboots
+ * gets its slot back within SLOT_NODE_COUNT / SLOT_REFRESH_PER_CYCLE cycles */
+static void broadcastSlotSync(void)
+{
+    uint8_t payload[7];
+    uint32_t ref;
+
+    payload[0] = (SLOT_CYCLE_MS >> 8) & 0xFF;
+    payload[1] = SLOT_CYCLE_MS & 0xFF;
+    payload[2] = syncSeq++;
+    if (!CAN2_TxFIFOIsFull(TxfifoQueue))
+    {
+        /* Sample the clock last so the stamp is as close to the queueing as possible */
+        ref = referenceMillis();
+        payload[3] = (ref >> 24) & 0xFF;
+        payload[4] = (ref >> 16) & 0xFF;
+        payload[5] = (ref >> 8) & 0xFF;
+        payload[6] = ref & 0xFF;
+        CAN2_MessageTransmit(SLOT_SYNC_ID, 7, payload, TxfifoQueue, CAN_MSG_TX_DATA_FRAME);
+    }
+
+    slotCycleMs = referenceMillis();
+    slotAssigns = slotRoundDone ? SLOT_REFRESH_PER_CYCLE : SLOT_ASSIGNS_PER_CYCLE;
+    if (slotAssigns > SLOT_NODE_COUNT)
+    {
+        slotAssigns = SLOT_NODE_COUNT;
+    }
+    slotAssignsSent = 0;
+}
+
 /* Check if given identifier is within defined ranges acting as firewall    */
 bool id_in_ranges(uint32_t ident)
 {
@@ -456,6 +591,7 @@ int main ( void )
 
             TMR1_PeriodSet(PERIOD_500MS);
             TMR1_Start();
+            slotTick = 0;
         }
         /* ----------------- LISTEN MODE: poll CAN and print received messages ----------------- */
         if (listenMode)
@@ -569,6 +705,12 @@ int main ( void )
         {
             isTmr1Expired = false;
             LED1_Toggle();
+
+            if (++slotTick >= SLOT_CYCLE_TICKS)
+            {
+                slotTick = 0;
+                broadcastSlotSync();
+            }
             /* Optionally print LED toggle message if desired */
             /* sprintf((char*)uartLocalTxBuffer, "LED toggled (rate: %s)\r\n", &timeouts[(uint8_t)tempSampleRate][0]);
             DCACHE_CLEAN_BY_ADDR((uint32_t)uartLocalTxBuffer, sizeof(uartLocalTxBuffer));
@@ -578,6 +720,8 @@ int main ( void )
              */
         }
 
+        serviceSlotAssigns();
+
         /* small idle/yield to reduce busy looping ? platform specific sleep could be used */
     }
 
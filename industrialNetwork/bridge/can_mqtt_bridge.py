@@ -0,0 +1,255 @@
+#!/usr/bin/env python3
+"""
+CAN-to-MQTT telemetry bridge
+
+Decodes sensor frames (see telemetry.py) into a last-value cache keyed by
+CAN ID and publishes coalesced updates to gate/{gate}/sensors:
+- a signal is queued when it is first seen or moves by more than its
+  deadband since it was last published; repeated frames only refresh it
+- each topic publishes at most --max-rate messages per second, carrying every
+  queued signal (up to --max-batch) as compact binary or CBOR records
+- every --refresh seconds all cached signals are queued again so new
+  subscribers converge without retained messages
+
+Broker load is bounded by topics x max-rate messages per second whatever the
+node count; message size follows the number of signals that changed.
+
+Usage:
+    python industrialNetwork/bridge/can_mqtt_bridge.py --channel vcan0 --id-mode extended \
+        --max-rate 2 --format binary
+"""
+import argparse
+import sys
+import time
+from typing import Dict, List, Optional
+
+try:
+    import can
+except ImportError as e:
+    print("python-can is required. Install with: pip install python-can", file=sys.stderr)
+    raise
+import paho.mqtt.client as mqtt
+
+from telemetry import ENCODERS, EXT_FLAG, MAX_AGE_MS, SIGNALS, SIGNALS_BY_NAME, SignalMap
+
+
+class SignalState:
+    """Cache entry for one CAN ID."""
+
+    __slots__ = ("key", "signal", "value", "seen", "published", "queued")
+
+    def __init__(self, key: int, signal):
+        self.key = key
+        self.signal = signal
+        self.value = 0
+        self.seen = 0.0
+        self.published = None
+        self.queued = False
+
+
+class TopicState:
+    """Pending signals and rate limit of one MQTT topic."""
+
+    __slots__ = ("name", "pending", "next_at", "seq")
+
+    def __init__(self, name: str):
+        self.name = name
+        self.pending: List[SignalState] = []
+        self.next_at = 0.0
+        self.seq = 0
+
+
+class TelemetryBridge:
+    def __init__(self, client: Optional[mqtt.Client], args: argparse.Namespace):
+        self.client = client
+        self.signals = SignalMap(args.id_mode, args.id_stride)
+        self.encode = ENCODERS[args.format]
+        self.interval = 1.0 / args.max_rate
+        self.max_batch = args.max_batch
+        self.refresh = args.refresh
+        self.qos = args.qos
+        self.deadband = {s.code: s.deadband for s in SIGNALS}
+        for name, value in (args.deadband or {}).items():
+            self.deadband[SIGNALS_BY_NAME[name].code] = value
+        base = f"gate/{args.gate}/sensors"
+        if args.split:
+            self.topics = {s.code: TopicState(f"{base}/{s.name}") for s in SIGNALS}
+        else:
+            shared = TopicState(base)
+            self.topics = {s.code: shared for s in SIGNALS}
+        self.cache: Dict[int, SignalState] = {}
+        self.next_refresh = time.time() + self.refresh if self.refresh else float("inf")
+        self.frames = 0
+        self.decoded = 0
+        self.messages = 0
+        self.records = 0
+        self.bytes = 0
+
+    def on_frame(self, msg: can.Message):
+        self.frames += 1
+        key = msg.arbitration_id | EXT_FLAG if msg.is_extended_id else msg.arbitration_id
+        st = self.cache.get(key)
+        if st is None:
+            sig = self.signals.resolve(key)
+            if sig is None or msg.is_remote_frame or msg.is_error_frame:
+                return
+            st = self.cache[key] = SignalState(key, sig)
+        value = st.signal.decode(msg.data)
+        if value is None:
+            return
+        self.decoded += 1
+        st.value = value
+        st.seen = msg.timestamp or time.time()
+        if not st.queued and (st.published is None or abs(value - st.published) > self.deadband[st.signal.code]):
+            st.queued = True
+            self.topics[st.signal.code].pending.append(st)
+
+    def flush(self, now: float) -> float:
+        """Publish every topic whose rate limit allows it; returns when the next one may publish."""
+        if now >= self.next_refresh:
+            for st in self.cache.values():
+                if not st.queued:
+                    st.queued = True
+                    self.topics[st.signal.code].pending.append(st)
+            self.next_refresh = now + self.refresh
+        wake = self.next_refresh
+        for topic in set(self.topics.values()):
+            if not topic.pending:
+                continue
+            if now < topic.next_at:
+                wake = min(wake, topic.next_at)
+                continue
+            batch = topic.pending[:self.max_batch]
+            del topic.pending[:self.max_batch]
+            records = []
+            for st in batch:
+                age = int((now - st.seen) * 1000.0)
+                records.append((st.key, st.signal.code, st.value, min(max(age, 0), MAX_AGE_MS)))
+                st.published = st.value
+                st.queued = False
+            payload = self.encode(topic.seq, now, records)
+            topic.seq += 1
+            topic.next_at = now + self.interval
+            if topic.pending:
+                wake = min(wake, topic.next_at)
+            if self.client is not None:
+                self.client.publish(topic.name, payload, qos=self.qos)
+            self.messages += 1
+            self.records += len(records)
+            self.bytes += len(payload)
+        return wake
+
+    def run(self, bus: can.BusABC, duration: float = None, stats_interval: float = 1.0):
+        t0 = time.time()
+        end = t0 + duration if duration else float("inf")
+        next_stats = t0 + stats_interval
+        last = (0, 0, 0, 0)
+        wake = self.flush(t0)
+        while True:
+            now = time.time()
+            if now >= end:
+                break
+            msg = bus.recv(timeout=max(0.0, min(wake, next_stats, end) - now))
+            if msg is not None:
+                self.on_frame(msg)
+                # Drain whatever else is already queued before publishing
+                while True:
+                    msg = bus.recv(timeout=0.0)
+                    if msg is None:
+                        break
+                    self.on_frame(msg)
+            now = time.time()
+            wake = self.flush(now)
+            if now >= next_stats:
+                cur = (self.frames, self.messages, self.records, self.bytes)
+                d = [c - p for c, p in zip(cur, last)]
+                span = now - next_stats + stats_interval
+                print(f"[{now - t0:7.1f}s] {d[0] / span:8.0f} frames/s -> {d[1] / span:5.1f} msg/s, "
+                      f"{d[2] / max(d[1], 1):6.1f} signals/msg, {d[3] / span / 1024:7.1f} KiB/s  "
+                      f"({len(self.cache)} signals cached)")
+                last = cur
+                next_stats = now + stats_interval
+
+    def summary(self):
+        print("\n=== BRIDGE STATS ===")
+        print(f"Frames received: {self.frames} ({self.decoded} decoded), signals cached: {len(self.cache)}")
+        print(f"MQTT messages: {self.messages}, records: {self.records}, bytes: {self.bytes}")
+        if self.messages:
+            print(f"Coalescing: {self.decoded / self.messages:.1f} frames/message, "
+                  f"{self.bytes / self.messages:.0f} bytes/message")
+
+
+def parse_deadband(text: str) -> Dict[str, int]:
+    out = {}
+    for item in text.split(","):
+        name, _, value = item.partition("=")
+        name = name.strip()
+        if name not in SIGNALS_BY_NAME or not value:
+            raise argparse.ArgumentTypeError(f"expected name=value with name in {', '.join(SIGNALS_BY_NAME)}")
+        out[name] = int(value, 0)
+    return out
+
+
+def build_parser() -> argparse.ArgumentParser:
+    parser = argparse.ArgumentParser(description="CAN-to-MQTT telemetry bridge",
+                                     formatter_class=argparse.ArgumentDefaultsHelpFormatter)
+    parser.add_argument("--bus-type", default="socketcan", help="python-can interface (socketcan, virtual, ...)")
+    parser.add_argument("--channel", default="can0", help="CAN channel")
+    parser.add_argument("--bitrate", type=int, default=None, help="Bitrate (adapter-specific)")
+    parser.add_argument("--id-mode", choices=["sketch", "offset", "extended"], default="sketch",
+                        help="How node CAN IDs are allocated (same as lot_simulator --id-mode)")
+    parser.add_argument("--id-stride", type=int, default=1, help="ID step between nodes in offset mode")
+    parser.add_argument("--broker", default="localhost", help="MQTT broker host")
+    parser.add_argument("--port", type=int, default=1883, help="MQTT broker port")
+    parser.add_argument("--username", default=None, help="MQTT username")
+    parser.add_argument("--password", default=None, help="MQTT password")
+    parser.add_argument("--gate", default="1", help="Gate ID used in the topic (gate/{gate}/sensors)")
+    parser.add_argument("--split", action="store_true",
+                        help="One topic per signal type (gate/{gate}/sensors/{signal}) instead of one shared topic")
+    parser.add_argument("--format", choices=sorted(ENCODERS), default="binary", help="Payload encoding")
+    parser.add_argument("--max-rate", type=float, default=5.0, help="Max messages per second per topic")
+    parser.add_argument("--max-batch", type=int, default=512, help="Max signals per message")
+    parser.add_argument("--refresh", type=float, default=60.0,
+                        help="Republish every cached signal this often (s, 0 = only on change)")
+    parser.add_argument("--deadband", type=parse_deadband, default=None, metavar="SIGNAL=RAW,...",
+                        help="Override change deadbands in raw units (e.g., temp=20,gas=0)")
+    parser.add_argument("--qos", type=int, choices=[0, 1], default=0, help="MQTT QoS for telemetry")
+    parser.add_argument("--duration", type=float, default=None, help="Seconds to run (omit for indefinite)")
+    parser.add_argument("--stats", type=float, default=5.0, help="Stats interval (s)")
+    return parser
+
+
+def main():
+    args = build_parser().parse_args()
+    if args.max_rate <= 0 or args.max_batch < 1:
+        print("Error: --max-rate must be > 0 and --max-batch >= 1", file=sys.stderr)
+        sys.exit(2)
+    client = mqtt.Client(callback_api_version=mqtt.CallbackAPIVersion.VERSION2)
+    if args.username:
+        client.username_pw_set(args.username, args.password)
+    try:
+        client.connect(args.broker, args.port, 60)
+    except OSError as e:
+        print(f"Error: could not connect to MQTT broker {args.broker}:{args.port}: {e}", file=sys.stderr)
+        sys.exit(1)
+    client.loop_start()
+    bus_kwargs = {"interface": args.bus_type, "channel": args.channel}
+    if args.bitrate:
+        bus_kwargs["bitrate"] = args.bitrate
+    bus = can.Bus(**bus_kwargs)
+    bridge = TelemetryBridge(client, args)
+    print(f"Bridging {args.channel} -> {args.broker}:{args.port} gate/{args.gate}/sensors "
+          f"({args.format}, <= {args.max_rate:g} msg/s per topic)")
+    try:
+        bridge.run(bus, args.duration, args.stats)
+    except KeyboardInterrupt:
+        pass
+    finally:
+        bridge.summary()
+        bus.shutdown()
+        client.loop_stop()
+        client.disconnect()
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,265 @@
+#!/usr/bin/env python3
+"""
+MQTT-to-CAN actuator bridge
+
+Subscribes to gate/+/actuators and turns {"barrierCommand": true|false} into
+the servo's command frame (0x201, data[0] = 1|0, see servoMotor.ino).
+
+The hot path is kept short:
+- the gate -> CAN ID table is compiled at start-up into one ready-to-send
+  struct can_frame per (topic, command), so a command is a dict lookup and a
+  send(); the usual payload spellings are matched as bytes before falling
+  back to JSON
+- frames go out on a dedicated, non-blocking CAN_RAW socket (no receive
+  filter, so it never queues bus traffic) with SO_PRIORITY set for the
+  interface queue; with the TX queue full (no ACK, bus-off) a command is
+  dropped and counted instead of stalling the MQTT loop
+- the MQTT loop runs in the main thread and sends from the message callback,
+  with no hand-off to another thread; --rt-priority puts the process under
+  SCHED_FIFO (needs CAP_SYS_NICE), otherwise it raises its nice level
+- a lost broker connection is re-established with exponential backoff
+  (RECONNECT_MIN_S .. RECONNECT_MAX_S); on_connect subscribes again
+
+Latency is recorded per command from MQTT receipt (callback entry) to the
+return of send(); payloads carrying a publisher timestamp "t" (unix s) also
+record publish -> CAN TX, which includes the broker when both ends share a host.
+Percentiles cover the last LATENCY_WINDOW commands of each kind.
+
+Usage:
+    python industrialNetwork/bridge/mqtt_can_bridge.py --channel vcan0 --gates 1=0x201,2=0x202
+"""
+import argparse
+import errno
+import json
+import os
+import socket
+import struct
+import sys
+import time
+from collections import deque
+from typing import Dict, List, Tuple
+
+import paho.mqtt.client as mqtt
+
+BARRIER_CMD_ID = 0x201
+CAN_EFF_FLAG = 0x80000000
+TOPIC_FILTER = "gate/+/actuators"
+LATENCY_WINDOW = 4096
+RECONNECT_MIN_S = 0.5
+RECONNECT_MAX_S = 30.0
+
+# Payloads as tests/test_mqtt_actuators.py and compact publishers write them
+_KNOWN_PAYLOADS = {
+    b'{"barrierCommand": true}': True,
+    b'{"barrierCommand": false}': False,
+    b'{"barrierCommand":true}': True,
+    b'{"barrierCommand":false}': False,
+}
+
+
+def pack_frame(can_id: int, data: bytes) -> bytes:
+    """struct can_frame for a standard (<= 0x7FF) or extended identifier."""
+    if can_id > 0x7FF:
+        can_id |= CAN_EFF_FLAG
+    return struct.pack("=IB3x8s", can_id, len(data), data)
+
+
+def open_tx_socket(channel: str, priority: int) -> socket.socket:
+    sock = socket.socket(socket.AF_CAN, socket.SOCK_RAW, socket.CAN_RAW)
+    # Transmit only: an empty filter list keeps bus traffic out of the receive queue
+    sock.setsockopt(socket.SOL_CAN_RAW, socket.CAN_RAW_FILTER, b"")
+    sock.setsockopt(socket.SOL_SOCKET, socket.SO_PRIORITY, priority)
+    sock.bind((channel,))
+    # A full TX queue must not block the MQTT loop: the send fails instead
+    sock.setblocking(False)
+    return sock
+
+
+def raise_priority(rt_priority: int):
+    if rt_priority:
+        try:
+            os.sched_setscheduler(0, os.SCHED_FIFO, os.sched_param(rt_priority))
+            print(f"Scheduling: SCHED_FIFO priority {rt_priority}")
+            return
+        except (AttributeError, PermissionError, OSError) as e:
+            print(f"Warning: SCHED_FIFO not available ({e}); falling back to nice")
+    try:
+        os.setpriority(os.PRIO_PROCESS, 0, -10)
+        print("Scheduling: nice -10")
+    except (AttributeError, PermissionError, OSError):
+        print("Scheduling: default (no permission to raise priority)")
+
+
+def _pct(values: List[float], q: float) -> float:
+    return values[min(len(values) - 1, int(q / 100.0 * len(values)))]
+
+
+class ActuatorBridge:
+    def __init__(self, gates: Dict[str, int], send):
+        """gates maps gate ID -> barrier command CAN ID; send(frame_bytes) transmits one can_frame."""
+        self.send = send
+        self.frames: Dict[str, Tuple[bytes, bytes]] = {
+            f"gate/{gate}/actuators": (pack_frame(can_id, b"\x00"), pack_frame(can_id, b"\x01"))
+            for gate, can_id in gates.items()
+        }
+        self.rx_to_tx = deque(maxlen=LATENCY_WINDOW)     # ms
+        self.pub_to_tx = deque(maxlen=LATENCY_WINDOW)    # ms
+        self.sent = 0
+        self.unknown_gate = 0
+        self.bad_payload = 0
+        self.send_errors = 0
+        self.dropped = 0
+        self.reconnects = 0
+
+    def on_message(self, client, userdata, msg):
+        t_rx = time.perf_counter()
+        frames = self.frames.get(msg.topic)
+        if frames is None:
+            self.unknown_gate += 1
+            return
+        payload = msg.payload
+        published = None
+        command = _KNOWN_PAYLOADS.get(payload)
+        if command is None:
+            try:
+                obj = json.loads(payload)
+                command = obj["barrierCommand"]
+                published = obj.get("t")
+            except (ValueError, KeyError, TypeError, AttributeError):
+                self.bad_payload += 1
+                return
+            if not isinstance(command, bool):
+                self.bad_payload += 1
+                return
+        try:
+            self.send(frames[command])
+        except OSError as e:
+            if e.errno in (errno.EAGAIN, errno.ENOBUFS):
+                if self.dropped == 0:
+                    print("CAN TX queue full (no ACK or bus-off?): dropping commands")
+                self.dropped += 1
+            else:
+                if self.send_errors == 0:
+                    print(f"CAN send failed: {e}")
+                self.send_errors += 1
+            return
+        t_tx = time.perf_counter()
+        self.sent += 1
+        self.rx_to_tx.append((t_tx - t_rx) * 1000.0)
+        if isinstance(published, (int, float)):
+            self.pub_to_tx.append((time.time() - published) * 1000.0)
+
+    def report(self) -> str:
+        lines = ["=== ACTUATOR LATENCY (ms) ==="]
+        for name, values in (("mqtt rx->can tx", self.rx_to_tx), ("publish->can tx", self.pub_to_tx)):
+            if not values:
+                continue
+            v = sorted(values)
+            lines.append(f"  {name:16s} last {len(v):5d}  p50 {_pct(v, 50):7.3f}  p95 {_pct(v, 95):7.3f}  "
+                         f"p99 {_pct(v, 99):7.3f}  max {v[-1]:7.3f}")
+        lines.append(f"Commands sent: {self.sent}, unknown gate: {self.unknown_gate}, "
+                     f"bad payload: {self.bad_payload}, dropped (TX queue full): {self.dropped}, "
+                     f"send errors: {self.send_errors}, broker reconnects: {self.reconnects}")
+        return "\n".join(lines)
+
+
+def parse_gates(text: str) -> Dict[str, int]:
+    gates = {}
+    for item in text.split(","):
+        gate, _, can_id = item.partition("=")
+        if not gate.strip():
+            raise argparse.ArgumentTypeError("expected GATE=CANID pairs, e.g. 1=0x201,2=0x202")
+        gates[gate.strip()] = int(can_id, 0) if can_id.strip() else BARRIER_CMD_ID
+    return gates
+
+
+def build_parser() -> argparse.ArgumentParser:
+    parser = argparse.ArgumentParser(description="MQTT-to-CAN actuator bridge",
+                                     formatter_class=argparse.ArgumentDefaultsHelpFormatter)
+    parser.add_argument("--bus-type", default="socketcan",
+                        help="socketcan uses a dedicated raw socket; other python-can interfaces go through can.Bus")
+    parser.add_argument("--channel", default="can0", help="CAN channel")
+    parser.add_argument("--gates", type=parse_gates, default={"1": BARRIER_CMD_ID}, metavar="GATE=CANID,...",
+                        help="Gate ID -> barrier command CAN ID")
+    parser.add_argument("--broker", default="localhost", help="MQTT broker host")
+    parser.add_argument("--port", type=int, default=1883, help="MQTT broker port")
+    parser.add_argument("--username", default=None, help="MQTT username")
+    parser.add_argument("--password", default=None, help="MQTT password")
+    parser.add_argument("--qos", type=int, choices=[0, 1, 2], default=1, help="Subscription QoS")
+    parser.add_argument("--so-priority", type=int, default=6, help="SO_PRIORITY of the CAN socket (0-6)")
+    parser.add_argument("--rt-priority", type=int, default=0, help="SCHED_FIFO priority (0 = only raise nice)")
+    parser.add_argument("--duration", type=float, default=None, help="Seconds to run (omit for indefinite)")
+    parser.add_argument("--stats", type=float, default=30.0, help="Latency report interval (s)")
+    return parser
+
+
+def serve(client, bridge: ActuatorBridge, end: float, stats_s: float):
+    """Run the MQTT loop in this thread until `end` (time.time()), reconnecting to the broker as needed."""
+    next_stats = time.time() + stats_s
+    reconnect_delay = RECONNECT_MIN_S
+    while time.time() < end:
+        if client.loop(timeout=0.1) != mqtt.MQTT_ERR_SUCCESS:
+            # loop() does not reconnect by itself (the broker restarted or the link dropped)
+            time.sleep(max(0.0, min(reconnect_delay, end - time.time())))
+            try:
+                client.reconnect()
+                bridge.reconnects += 1
+                reconnect_delay = RECONNECT_MIN_S
+            except OSError as e:
+                print(f"MQTT reconnect failed: {e}")
+                reconnect_delay = min(reconnect_delay * 2, RECONNECT_MAX_S)
+        if time.time() >= next_stats:
+            print(bridge.report())
+            next_stats += stats_s
+
+
+def main():
+    args = build_parser().parse_args()
+    bus = None
+    if args.bus_type == "socketcan":
+        sock = open_tx_socket(args.channel, args.so_priority)
+        send = sock.send
+    else:
+        import can
+        bus = can.Bus(interface=args.bus_type, channel=args.channel)
+
+        def send(frame):
+            can_id, dlc, data = struct.unpack("=IB3x8s", frame)
+            try:
+                bus.send(can.Message(arbitration_id=can_id & 0x1FFFFFFF, is_extended_id=bool(can_id & CAN_EFF_FLAG),
+                                     dlc=dlc, data=data[:dlc]), timeout=0)
+            except can.CanError as e:
+                # "Transmit buffer full" comes without an errno
+                raise OSError(getattr(e, "error_code", None) or errno.ENOBUFS, str(e)) from e
+    bridge = ActuatorBridge(args.gates, send)
+
+    client = mqtt.Client(callback_api_version=mqtt.CallbackAPIVersion.VERSION2)
+    if args.username:
+        client.username_pw_set(args.username, args.password)
+    client.on_message = bridge.on_message
+    client.on_connect = lambda c, u, f, rc, p=None: c.subscribe(TOPIC_FILTER, qos=args.qos)
+    try:
+        client.connect(args.broker, args.port, 60)
+    except OSError as e:
+        print(f"Error: could not connect to MQTT broker {args.broker}:{args.port}: {e}", file=sys.stderr)
+        sys.exit(1)
+    raise_priority(args.rt_priority)
+    print(f"Bridging {TOPIC_FILTER} -> {args.channel}: "
+          + ", ".join(f"gate {g} -> 0x{i:03X}" for g, i in args.gates.items()))
+
+    end = time.time() + args.duration if args.duration else float("inf")
+    try:
+        serve(client, bridge, end, args.stats)
+    except KeyboardInterrupt:
+        pass
+    finally:
+        print(bridge.report())
+        client.disconnect()
+        if bus is not None:
+            bus.shutdown()
+        else:
+            sock.close()
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,256 @@
+"""
+Sensor signal table and MQTT telemetry payloads
+
+Signals are decoded from the sketch frames (leading bytes only, so frames
+carrying a network-time stamp decode the same):
+- temp (0x036): int16 BE, centi-°C            (transmitterCAN.ino)
+- occupancy (0x701): uint8, 1 = busy          (ultrasonic.ino)
+- gas (0x601): uint16 BE, centivolts           (ambient_transmitter.ino)
+- air_quality (0x501): uint16 BE, raw ADC      (ambient_transmitter.ino)
+- barrier (0x301): uint8, servo order          (servoMotor.ino)
+
+One MQTT message carries a batch of signals. Binary layout (big endian):
+    header: [version u8 = 1][flags u8][seq u16][time f64, unix s][count u16]
+    record: [can_id u32, bit 31 = extended][signal u8][value i16][age_ms u16]
+age_ms is how long before `time` the value was last seen on the bus
+(65535 = older). The CBOR form is the map
+    {"v": 1, "seq": n, "t": time, "s": [[can_id, signal, value, age_ms], ...]}
+with the same record fields; decode_payload() accepts either.
+"""
+import struct
+from typing import Callable, Dict, List, Optional, Sequence, Tuple
+
+PAYLOAD_VERSION = 1
+EXT_FLAG = 0x80000000
+EXT_INDEX_BITS = 18  # lot_simulator extended mode: sketch ID << 18 | node index
+MAX_AGE_MS = 0xFFFF
+
+_HEADER = struct.Struct(">BBHdH")
+_RECORD = struct.Struct(">IBhH")
+
+Record = Tuple[int, int, int, int]  # (can_id | EXT_FLAG, signal code, value, age_ms)
+
+
+class Signal:
+    """One sensor type: sketch CAN ID, payload decoder and default change deadband (raw units)."""
+
+    __slots__ = ("code", "name", "base_id", "decode", "scale", "unit", "deadband")
+
+    def __init__(self, code: int, name: str, base_id: int, decode: Callable[[bytes], Optional[int]],
+                 scale: float, unit: str, deadband: int):
+        self.code = code
+        self.name = name
+        self.base_id = base_id
+        self.decode = decode
+        self.scale = scale
+        self.unit = unit
+        self.deadband = deadband
+
+
+def _u8(data):
+    return data[0] if len(data) >= 1 else None
+
+
+def _u16(data):
+    # Saturated to the record's int16 value field; the sketches stay far below
+    return min((data[0] << 8) | data[1], 0x7FFF) if len(data) >= 2 else None
+
+
+def _i16(data):
+    if len(data) < 2:
+        return None
+    v = (data[0] << 8) | data[1]
+    return v - 0x10000 if v & 0x8000 else v
+
+
+SIGNALS: List[Signal] = [
+    Signal(1, "temp", 0x036, _i16, 0.01, "C", 10),
+    Signal(2, "occupancy", 0x701, _u8, 1.0, "", 0),
+    Signal(3, "gas", 0x601, _u16, 0.01, "V", 5),
+    Signal(4, "air_quality", 0x501, _u16, 1.0, "", 5),
+    Signal(5, "barrier", 0x301, _u8, 1.0, "", 0),
+]
+SIGNALS_BY_CODE: Dict[int, Signal] = {s.code: s for s in SIGNALS}
+SIGNALS_BY_NAME: Dict[str, Signal] = {s.name: s for s in SIGNALS}
+_BY_BASE: Dict[int, Signal] = {s.base_id: s for s in SIGNALS}
+_BASES_DESC = sorted(_BY_BASE, reverse=True)
+
+
+class SignalMap:
+    """Resolves frame IDs to signals under the lot's ID allocation (see lot_simulator --id-mode).
+
+    sketch: exact sketch IDs; offset: the highest sketch ID <= id whose distance
+    is a multiple of the stride; extended: 29-bit IDs whose top 11 bits are the
+    sketch ID (standard frames still resolve as sketch IDs). Results, misses
+    included, are cached per ID.
+    """
+
+    def __init__(self, mode: str = "sketch", stride: int = 1):
+        self.mode = mode
+        self.stride = max(1, stride)
+        self._cache: Dict[int, Optional[Signal]] = {}
+
+    def resolve(self, key: int) -> Optional[Signal]:
+        """Signal for key = can_id | EXT_FLAG (if extended), or None."""
+        try:
+            return self._cache[key]
+        except KeyError:
+            sig = self._cache[key] = self._lookup(key)
+            return sig
+
+    def node_index(self, key: int, signal: Signal) -> int:
+        """Index of the node that sent `key` among nodes of its type (0 in sketch mode)."""
+        if key & EXT_FLAG:
+            return key & ((1 << EXT_INDEX_BITS) - 1)
+        if self.mode == "offset":
+            return (key - signal.base_id) // self.stride
+        return 0
+
+    def _lookup(self, key: int) -> Optional[Signal]:
+        if key & EXT_FLAG:
+            if self.mode != "extended":
+                return None
+            return _BY_BASE.get((key & 0x1FFFFFFF) >> EXT_INDEX_BITS)
+        if self.mode == "offset":
+            for base in _BASES_DESC:
+                if base <= key and (key - base) % self.stride == 0:
+                    return _BY_BASE[base]
+            return None
+        return _BY_BASE.get(key)
+
+
+def encode_binary(seq: int, ts: float, records: Sequence[Record], flags: int = 0) -> bytes:
+    buf = bytearray(_HEADER.size + _RECORD.size * len(records))
+    _HEADER.pack_into(buf, 0, PAYLOAD_VERSION, flags, seq & 0xFFFF, ts, len(records))
+    off = _HEADER.size
+    pack = _RECORD.pack_into
+    for rec in records:
+        pack(buf, off, *rec)
+        off += _RECORD.size
+    return bytes(buf)
+
+
+def _cbor_head(major: int, n: int) -> bytes:
+    if n < 24:
+        return bytes([major << 5 | n])
+    if n < 0x100:
+        return bytes([major << 5 | 24, n])
+    if n < 0x10000:
+        return bytes([major << 5 | 25]) + n.to_bytes(2, "big")
+    if n < 0x100000000:
+        return bytes([major << 5 | 26]) + n.to_bytes(4, "big")
+    return bytes([major << 5 | 27]) + n.to_bytes(8, "big")
+
+
+def cbor_dumps(obj) -> bytes:
+    """Minimal CBOR (RFC 8949) encoder: int, float, str, bytes, bool, None, list/tuple, dict."""
+    if obj is True:
+        return b"\xf5"
+    if obj is False:
+        return b"\xf4"
+    if obj is None:
+        return b"\xf6"
+    if isinstance(obj, int):
+        return _cbor_head(0, obj) if obj >= 0 else _cbor_head(1, -1 - obj)
+    if isinstance(obj, float):
+        return b"\xfb" + struct.pack(">d", obj)
+    if isinstance(obj, str):
+        raw = obj.encode()
+        return _cbor_head(3, len(raw)) + raw
+    if isinstance(obj, (bytes, bytearray)):
+        return _cbor_head(2, len(obj)) + bytes(obj)
+    if isinstance(obj, (list, tuple)):
+        return _cbor_head(4, len(obj)) + b"".join(cbor_dumps(x) for x in obj)
+    if isinstance(obj, dict):
+        return _cbor_head(5, len(obj)) + b"".join(cbor_dumps(k) + cbor_dumps(v) for k, v in obj.items())
+    raise TypeError(f"cannot CBOR-encode {type(obj).__name__}")
+
+
+def _cbor_item(buf: bytes, i: int):
+    ib = buf[i]
+    major, info = ib >> 5, ib & 0x1F
+    i += 1
+    if major == 7:
+        if info == 20:
+            return False, i
+        if info == 21:
+            return True, i
+        if info == 22:
+            return None, i
+        if info == 25:
+            return struct.unpack_from(">e", buf, i)[0], i + 2
+        if info == 26:
+            return struct.unpack_from(">f", buf, i)[0], i + 4
+        if info == 27:
+            return struct.unpack_from(">d", buf, i)[0], i + 8
+        raise ValueError(f"unsupported CBOR simple value {info}")
+    if info < 24:
+        n = info
+    elif info <= 27:
+        size = 1 << (info - 24)
+        n = int.from_bytes(buf[i:i + size], "big")
+        i += size
+    else:
+        raise ValueError("indefinite-length CBOR items are not supported")
+    if major == 0:
+        return n, i
+    if major == 1:
+        return -1 - n, i
+    if major == 2:
+        return bytes(buf[i:i + n]), i + n
+    if major == 3:
+        return bytes(buf[i:i + n]).decode(), i + n
+    if major == 4:
+        out = []
+        for _ in range(n):
+            v, i = _cbor_item(buf, i)
+            out.append(v)
+        return out, i
+    if major == 5:
+        out = {}
+        for _ in range(n):
+            k, i = _cbor_item(buf, i)
+            out[k], i = _cbor_item(buf, i)
+        return out, i
+    raise ValueError(f"unsupported CBOR major type {major}")
+
+
+def cbor_loads(buf: bytes):
+    return _cbor_item(buf, 0)[0]
+
+
+def encode_cbor(seq: int, ts: float, records: Sequence[Record], flags: int = 0) -> bytes:
+    return cbor_dumps({"v": PAYLOAD_VERSION, "seq": seq & 0xFFFF, "t": ts, "s": [list(r) for r in records]})
+
+
+ENCODERS = {"binary": encode_binary, "cbor": encode_cbor}
+
+
+def decode_payload(payload: bytes) -> Tuple[int, float, List[Record]]:
+    """(seq, time, records) from a binary or CBOR telemetry payload; raises ValueError if malformed."""
+    if not payload:
+        raise ValueError("empty payload")
+    if payload[0] == PAYLOAD_VERSION:
+        if len(payload) < _HEADER.size:
+            raise ValueError("truncated header")
+        _, _, seq, ts, count = _HEADER.unpack_from(payload, 0)
+        if len(payload) != _HEADER.size + count * _RECORD.size:
+            raise ValueError("record count does not match payload length")
+        return seq, ts, [rec for rec in _RECORD.iter_unpack(payload[_HEADER.size:])]
+    if payload[0] >> 5 == 5:
+        obj = cbor_loads(payload)
+        if obj.get("v") != PAYLOAD_VERSION:
+            raise ValueError(f"unsupported payload version {obj.get('v')}")
+        return obj["seq"], obj["t"], [tuple(r) for r in obj["s"]]
+    raise ValueError("not a telemetry payload")
+
+
+def format_record(rec: Record) -> str:
+    key, code, value, age_ms = rec
+    sig = SIGNALS_BY_CODE.get(code)
+    can_id = f"{key & 0x1FFFFFFF:08X}" if key & EXT_FLAG else f"{key:03X}"
+    if sig is None:
+        return f"{can_id} signal{code}={value}"
+    shown = f"{value * sig.scale:.2f}{sig.unit}" if sig.scale != 1.0 else str(value)
+    age = ">65.5s" if age_ms >= MAX_AGE_MS else f"{age_ms}ms"
+    return f"{can_id} {sig.name}={shown} (age {age})"
@@ -0,0 +1,112 @@
+// Gateway slot and time sync for the 1 s sensor sketches (transmitterCAN, ultrasonic)
+//
+// Send at sync + assigned offset instead of free-running from boot, and
+// optionally stamp frames with network time. Header only: define NODE_ID
+// (and STAMP_FRAMES to stamp) before including it, so the sketch's settings
+// apply. Protocol: see "Slot Sync" and "Network Time" in industrialNetwork/README.md.
+#ifndef SLOT_SYNC_H
+#define SLOT_SYNC_H
+
+#include <mcp2515.h>
+
+#ifndef NODE_ID
+#error "Define NODE_ID (unique per board, 1..SLOT_NODE_COUNT on the gateway) before including SlotSync.h"
+#endif
+#ifndef STAMP_FRAMES
+#define STAMP_FRAMES 0             // 1: append [stamp u16 BE][flags u8] for latency measurement
+#endif
+
+#define SLOT_SYNC_ID   0x010
+#define SLOT_ASSIGN_ID 0x011
+
+long slotOffsetMs = -1;            // -1 until the gateway assigns our slot
+unsigned long nextSendMillis = 0;
+bool slotSynced = false;           // first sync after the assignment seen
+
+// Network time from the sync frame (DLC 7: cycle u16, seq u8, gateway ms u32, BE)
+bool timeSynced = false;
+unsigned long syncLocalMs = 0, syncRefMs = 0;    // latest sync: offset
+unsigned long firstLocalMs = 0, firstRefMs = 0;  // first sync: drift baseline
+float clockDrift = 0.0f;                         // gateway ms per local ms, minus 1
+uint8_t stampSeq = 0;
+
+void onTimeSync(unsigned long local, unsigned long ref) {
+  // A reference that goes backwards means the gateway restarted: start over
+  if (timeSynced && (long)(ref - syncRefMs) < 0) timeSynced = false;
+  if (!timeSynced) {
+    firstLocalMs = local;
+    firstRefMs = ref;
+    clockDrift = 0.0f;
+    timeSynced = true;
+  } else if (local - firstLocalMs > 10000UL) {
+    long skew = (long)((ref - firstRefMs) - (local - firstLocalMs));
+    clockDrift = (float)skew / (float)(local - firstLocalMs);
+  }
+  syncLocalMs = local;
+  syncRefMs = ref;
+}
+
+unsigned long networkMillis() {
+  unsigned long dt = millis() - syncLocalMs;
+  return syncRefMs + dt + (long)(dt * clockDrift);
+}
+
+// Trailing stamp: network ms mod 65536, then flags (bit 7 = time synced, bits 0-6 = sequence)
+void appendStamp(struct can_frame *frame) {
+  unsigned long t = timeSynced ? networkMillis() : millis();
+  uint8_t n = frame->can_dlc;
+  frame->data[n] = (t >> 8) & 0xFF;
+  frame->data[n + 1] = t & 0xFF;
+  frame->data[n + 2] = (timeSynced ? 0x80 : 0) | (stampSeq++ & 0x7F);
+  frame->can_dlc = n + 3;
+}
+
+// Receive only 0x010/0x011 (mask 0x7FE) in both RX buffers, so bus traffic
+// never fills them while loop() is busy. Call after setBitrate(), before
+// setNormalMode(): the filter calls leave the controller in config mode.
+void setupSlotSyncFilters(MCP2515 &mcp) {
+  mcp.setFilterMask(MCP2515::MASK0, false, 0x7FE);
+  mcp.setFilterMask(MCP2515::MASK1, false, 0x7FE);
+  mcp.setFilter(MCP2515::RXF0, false, SLOT_SYNC_ID);
+  mcp.setFilter(MCP2515::RXF1, false, SLOT_SYNC_ID);
+  mcp.setFilter(MCP2515::RXF2, false, SLOT_SYNC_ID);
+  mcp.setFilter(MCP2515::RXF3, false, SLOT_SYNC_ID);
+  mcp.setFilter(MCP2515::RXF4, false, SLOT_SYNC_ID);
+  mcp.setFilter(MCP2515::RXF5, false, SLOT_SYNC_ID);
+}
+
+// Drains every pending frame: the controller holds only two, and a sync is
+// timed when it is read, so call this at the top of loop() and do not block there
+void pollSlotSync(MCP2515 &mcp, struct can_frame *rx) {
+  while (mcp.readMessage(rx) == MCP2515::ERROR_OK) {
+    if (rx->can_id == SLOT_ASSIGN_ID && rx->can_dlc >= 4 &&
+        (unsigned int)((rx->data[0] << 8) | rx->data[1]) == NODE_ID) {
+      slotOffsetMs = (rx->data[2] << 8) | rx->data[3];
+    } else if (rx->can_id == SLOT_SYNC_ID) {
+      unsigned long local = millis();
+      if (rx->can_dlc >= 7) {
+        onTimeSync(local, ((unsigned long)rx->data[3] << 24) | ((unsigned long)rx->data[4] << 16) |
+                          ((unsigned long)rx->data[5] << 8) | rx->data[6]);
+      }
+      if (slotOffsetMs >= 0) {
+        // Re-anchored on every sync, so clock drift never accumulates
+        nextSendMillis = local + slotOffsetMs;
+        slotSynced = true;
+      }
+    }
+  }
+}
+
+// True once per period: at the assigned slot when synced, else `interval` after the last send
+bool sendDue(unsigned long now, unsigned long &lastSend, unsigned long interval) {
+  if (slotSynced) {
+    if ((long)(now - nextSendMillis) < 0) return false;
+    nextSendMillis += interval;
+    return true;
+  }
+  if (now - lastSend < interval) return false;
+  lastSend = now;
+  return true;
+}
+
+#endif // SLOT_SYNC_H
@@ -0,0 +1,668 @@
+#!/usr/bin/env python3
+"""
+Virtual parking-lot node simulator
+
+Emulates the CAN behavior of the lot's Arduino/ESP32 sketches so the gateway
+and the NIDS can be load-tested with hundreds or thousands of nodes:
+- transmitterCAN.ino: 0x036 temperature, sine (60 s period) + jitter, 2 bytes BE centi-°C, every 1 s
+- ultrasonic.ino: 0x701 spot occupancy, 1 byte (1 = busy), every 1 s
+- ambient_transmitter.ino: 0x601 gas and 0x501 air quality, 2 bytes BE each, every 1.75 s
+- servoMotor.ino: reports barrier state on 0x301 every 500 ms, opens on 0x201/0x321
+  with data[0] != 0 and closes again after 5 s without an open order
+
+All nodes run in one process from a hashed timer wheel, so the cost per tick
+is proportional to the timers that actually fire, not to the node count.
+Each node has its own clock drift and boot time.
+
+With --slots the simulator also plays the gateway's slot sync: temperature
+and occupancy nodes get node IDs 1..N and phase offsets (0x011), handed out
+round robin and one frame at a time as the firmware does (8 per cycle until
+every node has one, then one per cycle mid-cycle), and once assigned
+re-anchor their 1 s period on every sync frame (0x010), as the sketches do.
+Nodes read those frames when their loop polls: while an occupancy node
+measures, they wait in the MCP2515's two RX buffers and the rest are lost
+(--occupancy-delay-ms adds a blocking delay per reading). The sync frame carries the
+gateway's reference time; with --stamp those nodes estimate offset and drift
+from it and append a network-time stamp to their frames. --analyze runs in
+virtual time without a bus and reports bus-load peaks and latency per node
+type from an arbitration model (bus_model.py); --capture writes the modelled
+bus as a candump log.
+
+Usage:
+    python industrialNetwork/lot_simulator/lot_simulator.py --channel vcan0 \
+        --temp 2500 --occupancy 2500 --ambient 2500 --barrier 2500 --id-mode extended
+"""
+import argparse
+import math
+import os
+import random
+import sys
+import time
+from typing import Dict, List, Optional, Tuple
+
+try:
+    import can
+except ImportError as e:
+    print("python-can is required. Install with: pip install python-can", file=sys.stderr)
+    raise
+
+from bus_model import analyze, arbitrate, print_report
+
+sys.path.insert(0, os.path.abspath(os.path.join(os.path.dirname(__file__), "..", "..")))
+from canlog.candump import format_line  # noqa: E402
+from canlog.timesync import STAMP_LEN, STAMP_SEQ_MASK, STAMP_SYNCED, SYNC_TIME_DLC  # noqa: E402
+
+
+# Sketch CAN IDs
+TEMP_ID = 0x036
+OCCUPANCY_ID = 0x701
+GAS_ID = 0x601
+AIR_QUALITY_ID = 0x501
+BARRIER_STATE_ID = 0x301
+BARRIER_CMD_ID = 0x201
+BARRIER_BUTTON_ID = 0x321
+# Gateway slot sync (PIC32MZ/original.c)
+SLOT_SYNC_ID = 0x010
+SLOT_ASSIGN_ID = 0x011
+
+# Sketch timing (ms)
+TEMP_PERIOD_MS = 60000.0
+SEND_INTERVAL_MS = 1000.0
+BARRIER_LOOP_MS = 500.0
+BARRIER_TIMEOUT_MS = 5000.0
+# ambient_transmitter: 250 ms reading, 250 ms, gas frame, 250 ms, air-quality frame, 1000 ms
+AMBIENT_GAS_TO_AQ_MS = 250.0
+AMBIENT_AQ_TO_GAS_MS = 1500.0
+SLOT_CYCLE_MS = 1000
+SLOT_GUARD_MS = 10  # keep the first slot clear of the sync frame
+SLOT_TAIL_MS = 30  # and the last node's reading clear of the next one
+SLOT_ASSIGNS_PER_CYCLE = 8  # first round after boot
+SLOT_REFRESH_PER_CYCLE = 1  # afterwards, mid-cycle
+# Sketch receive side (libraries/SlotSync): filters pass 0x010/0x011 only
+MCP2515_RX_BUFFERS = 2
+ULTRASONIC_MEASURE_MS = 25.0  # trigger + echo from 4 m; ultrasonic.ino's echo timeout is 30 ms
+
+EXT_INDEX_BITS = 18
+
+
+def allocate_id(base: int, index: int, mode: str, stride: int = 1) -> Tuple[int, bool]:
+    """CAN ID for node `index` of a type whose sketch uses `base`.
+
+    sketch: every node shares the sketch ID; offset: base + index * stride
+    (11-bit); extended: base in the upper 11 bits, node index in the lower 18.
+    """
+    if mode == "sketch":
+        return base, False
+    if mode == "offset":
+        cid = base + index * stride
+        if cid > 0x7FF:
+            raise ValueError(f"ID 0x{base:03X} + {index} * {stride} exceeds 0x7FF; use --id-mode extended")
+        return cid, False
+    if mode == "extended":
+        if index >= 1 << EXT_INDEX_BITS:
+            raise ValueError(f"Node index {index} does not fit in {EXT_INDEX_BITS} bits")
+        return (base << EXT_INDEX_BITS) | index, True
+    raise ValueError(f"Unknown ID mode: {mode}")
+
+
+class TimerWheel:
+    """Hashed timing wheel: O(1) schedule, expiry cost proportional to elapsed ticks plus due timers.
+
+    Timers further out than one revolution stay in their slot until their tick comes round.
+    """
+
+    def __init__(self, tick_s: float = 0.001, slots: int = 4096, start: float = 0.0):
+        if slots & (slots - 1):
+            raise ValueError("Timer wheel size must be a power of two")
+        self.tick_s = tick_s
+        self.mask = slots - 1
+        self.slots: List[list] = [[] for _ in range(slots)]
+        self.start = start
+        self.current = 0  # next tick to expire
+
+    def schedule(self, due: float, item):
+        tick = int((due - self.start) / self.tick_s)
+        if tick < self.current:
+            tick = self.current
+        self.slots[tick & self.mask].append((tick, item))
+
+    def expire(self, now: float) -> list:
+        """Pop every item due at or before `now`, in tick order."""
+        # Epsilon keeps now == next_time() from rounding down to the previous tick
+        target = int((now - self.start) / self.tick_s + 1e-9)
+        out = []
+        slots, mask = self.slots, self.mask
+        while self.current <= target:
+            idx = self.current & mask
+            slot = slots[idx]
+            if slot:
+                current = self.current
+                keep = [e for e in slot if e[0] > current]
+                if keep:
+                    out.extend(e[1] for e in slot if e[0] <= current)
+                    slots[idx] = keep
+                else:
+                    out.extend(e[1] for e in slot)
+                    slots[idx] = []
+            self.current += 1
+        return out
+
+    def next_time(self) -> float:
+        return self.start + self.current * self.tick_s
+
+
+class SimNode:
+    """Base node: own clock (boot time + drift), one preallocated CAN message."""
+
+    __slots__ = ("index", "drift", "boot", "period", "next_due", "msg", "slot", "stamp", "block", "rx",
+                 "sync_local", "sync_ref", "first_local", "first_ref", "est_drift", "seq")
+    kind = "node"
+
+    def __init__(self, index: int, can_id: int, extended: bool, dlc: int, period_ms: float,
+                 drift_ppm: float, boot: float):
+        self.index = index
+        self.drift = drift_ppm * 1e-6
+        self.boot = boot
+        # A fast clock makes the node's millis() periods shorter in real time
+        self.period = period_ms / 1000.0 / (1.0 + self.drift)
+        self.next_due = 0.0
+        self.slot: Optional[float] = None  # assigned phase offset (s of node time)
+        self.block = 0.0                   # loop() blocked this long (s) before each send
+        self.rx: list = []                 # gateway frames waiting in the RX buffers
+        self.stamp = False
+        self.first_local = None            # no time sync yet
+        self.sync_local = self.sync_ref = self.first_ref = 0.0
+        self.est_drift = 0.0
+        self.seq = 0
+        self.msg = can.Message(arbitration_id=can_id, is_extended_id=extended, dlc=dlc, data=bytes(dlc))
+
+    def millis(self, now: float) -> float:
+        return (now - self.boot) * (1.0 + self.drift) * 1000.0
+
+    def fire(self, now: float, rng: random.Random) -> can.Message:
+        """Update the payload for this send; returns the message to transmit."""
+        raise NotImplementedError
+
+    def on_time_sync(self, now: float, ref_ms: int):
+        """Sketch onTimeSync(): offset from the latest sync, drift against the first one."""
+        local = self.millis(now)
+        if self.first_local is not None and ref_ms < self.sync_ref:
+            self.first_local = None
+        if self.first_local is None:
+            self.first_local, self.first_ref, self.est_drift = local, ref_ms, 0.0
+        elif local - self.first_local > 10000.0:
+            elapsed = local - self.first_local
+            self.est_drift = ((ref_ms - self.first_ref) - elapsed) / elapsed
+        self.sync_local, self.sync_ref = local, ref_ms
+
+    def append_stamp(self, data: bytearray, offset: int, now: float):
+        """Sketch appendStamp(): network ms mod 65536, then synced flag + sequence."""
+        synced = self.first_local is not None
+        if synced:
+            dt = int(self.millis(now)) - int(self.sync_local)
+            t = int(self.sync_ref) + dt + int(dt * self.est_drift)
+        else:
+            t = int(self.millis(now))
+        data[offset] = (t >> 8) & 0xFF
+        data[offset + 1] = t & 0xFF
+        data[offset + 2] = (STAMP_SYNCED if synced else 0) | (self.seq & STAMP_SEQ_MASK)
+        self.seq += 1
+
+
+class TemperatureNode(SimNode):
+    """transmitterCAN.ino"""
+
+    __slots__ = ()
+    kind = "temp"
+
+    def fire(self, now, rng):
+        t = self.millis(now)
+        phase = (t % TEMP_PERIOD_MS) / TEMP_PERIOD_MS
+        temp = 25.0 + 3.0 * math.sin(phase * 2.0 * math.pi) + rng.randint(-20, 20) / 100.0
+        value = int(round(temp * 100.0))
+        data = self.msg.data
+        data[0] = (value >> 8) & 0xFF
+        data[1] = value & 0xFF
+        if self.stamp:
+            self.append_stamp(data, 2, now)
+        return self.msg
+
+
+class OccupancyNode(SimNode):
+    """ultrasonic.ino; cars arrive and leave with exponential vacancy/dwell times."""
+
+    __slots__ = ("busy", "change_at", "mean_busy", "mean_free")
+    kind = "occupancy"
+
+    def fire(self, now, rng):
+        if now >= self.change_at:
+            self.busy ^= 1
+            mean = self.mean_busy if self.busy else self.mean_free
+            self.change_at = now + rng.expovariate(1.0 / mean)
+        self.msg.data[0] = self.busy
+        if self.stamp:
+            self.append_stamp(self.msg.data, 1, now)
+        return self.msg
+
+
+class AmbientNode(SimNode):
+    """ambient_transmitter.ino: alternates gas and air-quality frames within one loop."""
+
+    __slots__ = ("aq_msg", "gas_adc", "aq_value", "gas_turn")
+    kind = "ambient"
+
+    def fire(self, now, rng):
+        if self.gas_turn:
+            self.gas_adc = min(max(self.gas_adc + rng.randint(-20, 20), 0), 4095)
+            volt = int(self.gas_adc / 4096.0 * 5.0 * 100.0)
+            msg = self.msg
+            msg.data[0] = (volt >> 8) & 0xFF
+            msg.data[1] = volt & 0xFF
+            self.period = AMBIENT_GAS_TO_AQ_MS / 1000.0 / (1.0 + self.drift)
+        else:
+            self.aq_value = min(max(self.aq_value + rng.randint(-5, 5), 0), 1023)
+            msg = self.aq_msg
+            msg.data[0] = (self.aq_value >> 8) & 0xFF
+            msg.data[1] = self.aq_value & 0xFF
+            self.period = AMBIENT_AQ_TO_GAS_MS / 1000.0 / (1.0 + self.drift)
+        self.gas_turn = not self.gas_turn
+        return msg
+
+
+class BarrierNode(SimNode):
+    """servoMotor.ino"""
+
+    __slots__ = ("order", "last_order_ms")
+    kind = "barrier"
+
+    def command(self, now: float, value: int):
+        if value == 0:
+            self.order = 0
+        else:
+            self.order = 1
+            self.last_order_ms = self.millis(now)
+
+    def fire(self, now, rng):
+        if self.millis(now) - self.last_order_ms > BARRIER_TIMEOUT_MS:
+            self.order = 0
+        self.msg.data[0] = self.order
+        return self.msg
+
+
+class GatewayNode(SimNode):
+    """Slot and time sync of the PIC32MZ gateway.
+
+    The gateway clock is the simulation clock, so its reference time is exact.
+    As in the firmware, every cycle opens with the sync frame; assignments go
+    round robin over the node IDs, one frame at a time, spread evenly over the
+    cycle: SLOT_ASSIGNS_PER_CYCLE until each node ID has been assigned once,
+    then SLOT_REFRESH_PER_CYCLE. The timer fires for the sync and for every
+    assignment, `period` being set to the gap to the next one.
+    """
+
+    __slots__ = ("sim", "assign_msg", "next_assign", "round_done", "cycle_start", "assigns", "assigns_sent")
+    kind = "gateway"
+
+    def fire(self, now, rng):
+        sim = self.sim
+        if self.assigns_sent >= self.assigns:
+            self.cycle_start = self.next_due
+            ref_ms = int(now * 1000.0) & 0xFFFFFFFF
+            data = self.msg.data
+            data[2] = self.seq & 0xFF
+            data[3:7] = ref_ms.to_bytes(4, "big")
+            self.seq += 1
+            sim.emit(self.msg, now, self.kind)
+            sim.slot_rx(now, (None, now, ref_ms))
+            count = SLOT_REFRESH_PER_CYCLE if self.round_done else SLOT_ASSIGNS_PER_CYCLE
+            self.assigns = min(count, len(sim.slot_nodes))
+            self.assigns_sent = 0
+        else:
+            if self.assign(now) and not self.round_done:
+                # First round complete: refreshes from the next cycle on
+                self.round_done = True
+                self.assigns = self.assigns_sent + 1
+            self.assigns_sent += 1
+        if self.assigns_sent < self.assigns:
+            spacing = SLOT_CYCLE_MS // self.assigns
+            due = self.cycle_start + (spacing // 2 + self.assigns_sent * spacing) / 1000.0
+        else:
+            due = self.cycle_start + SLOT_CYCLE_MS / 1000.0
+        self.period = due - self.next_due
+        return None
+
+    def assign(self, now: float) -> bool:
+        """Firmware sendSlotAssign(); True when it completes a round."""
+        sim = self.sim
+        msg, k = self.assign_msg, self.next_assign
+        node_id, offset_ms = k + 1, sim.slot_offsets[k]
+        msg.data[:] = bytes([node_id >> 8, node_id & 0xFF, offset_ms >> 8, offset_ms & 0xFF])
+        sim.emit(msg, now, self.kind)
+        sim.slot_rx(now, (sim.slot_nodes[k], now, offset_ms / 1000.0))
+        self.next_assign = (k + 1) % len(sim.slot_nodes)
+        return self.next_assign == 0
+
+
+class LotSimulator:
+    """Builds the node population and runs it from a timer wheel against one bus."""
+
+    def __init__(self, bus: Optional[can.BusABC], args: argparse.Namespace):
+        self.bus = bus
+        # Without a bus (analysis mode) frames are recorded for the arbitration model
+        self.records: Optional[list] = [] if bus is None else None
+        self.rng = random.Random(args.seed)
+        # Simulation time is relative to the start of run(), so building a
+        # large population does not make the first timers late
+        self.start = 0.0
+        self.elapsed = 0.0
+        self.cpu0 = time.process_time()
+        self.wheel = TimerWheel(args.tick_ms / 1000.0, start=self.start)
+        self.nodes: List[SimNode] = []
+        self.commands: Dict[Tuple[int, bool], List[BarrierNode]] = {}
+        self.slot_nodes: List[SimNode] = []   # node ID k + 1 is slot_nodes[k]
+        self.slot_offsets: List[int] = []
+        self.sent = 0
+        self.tx_errors = 0
+        self.rx_commands = 0
+        self.late = 0
+        self.max_late = 0.0
+        self.rx_lost = 0
+        self.assign_lost = 0
+        self.sync_late = 0
+        self.max_sync_late = 0.0
+        self._build(args)
+
+    def _build(self, args):
+        mode, stride, rng = args.id_mode, args.id_stride, self.rng
+        used: Dict[Tuple[int, bool], str] = {}
+
+        def alloc(base, index, kind):
+            key = allocate_id(base, index, mode, stride)
+            owner = used.setdefault(key, kind)
+            if mode != "sketch" and owner != kind:
+                raise ValueError(f"ID 0x{key[0]:X} of a {kind} node collides with a {owner} node; "
+                                 "reduce the node count or stride, or use --id-mode extended")
+            return key
+
+        def node(cls, index, base, dlc, period_ms):
+            cid, ext = alloc(base, index, cls.kind)
+            stamp = args.stamp and cls.kind in ("temp", "occupancy")
+            if stamp:
+                dlc += STAMP_LEN
+            drift = rng.uniform(-args.drift_ppm, args.drift_ppm)
+            if args.boot_spread_ms is None:
+                # Nodes were powered on at different times; the first send lands anywhere in one period
+                n = cls(index, cid, ext, dlc, period_ms, drift, self.start - rng.uniform(0, 3600))
+                n.next_due = self.start + rng.uniform(0, n.period)
+            else:
+                # Common power cycle: millis() restarts on every node, first send one period after boot
+                n = cls(index, cid, ext, dlc, period_ms, drift, self.start + rng.uniform(0, args.boot_spread_ms / 1000.0))
+                n.next_due = n.boot + n.period
+            n.stamp = stamp
+            self.nodes.append(n)
+            return n
+
+        for i in range(args.temp):
+            node(TemperatureNode, i, TEMP_ID, 2, SEND_INTERVAL_MS)
+        for i in range(args.occupancy):
+            n = node(OccupancyNode, i, OCCUPANCY_ID, 1, SEND_INTERVAL_MS)
+            n.block = (ULTRASONIC_MEASURE_MS + args.occupancy_delay_ms) / 1000.0
+            n.mean_busy, n.mean_free = args.dwell, args.vacancy
+            n.busy = 1 if rng.random() < args.dwell / (args.dwell + args.vacancy) else 0
+            n.change_at = self.start + rng.expovariate(1.0 / (args.dwell if n.busy else args.vacancy))
+        for i in range(args.ambient):
+            n = node(AmbientNode, i, GAS_ID, 2, AMBIENT_GAS_TO_AQ_MS)
+            aq_id, aq_ext = alloc(AIR_QUALITY_ID, i, AmbientNode.kind)
+            n.aq_msg = can.Message(arbitration_id=aq_id, is_extended_id=aq_ext, dlc=2, data=bytes(2))
+            n.gas_adc = rng.randint(900, 1300)
+            n.aq_value = rng.randint(50, 150)
+            n.gas_turn = True
+            if args.boot_spread_ms is None:
+                n.next_due = self.start + rng.uniform(0, (AMBIENT_GAS_TO_AQ_MS + AMBIENT_AQ_TO_GAS_MS) / 1000.0)
+        for i in range(args.barrier):
+            n = node(BarrierNode, i, BARRIER_STATE_ID, 1, BARRIER_LOOP_MS)
+            n.order = 0
+            n.last_order_ms = -BARRIER_TIMEOUT_MS
+            for base in (BARRIER_CMD_ID, BARRIER_BUTTON_ID):
+                self.commands.setdefault(alloc(base, i, BarrierNode.kind), []).append(n)
+
+        if args.slots:
+            self.slot_nodes = [n for n in self.nodes if n.kind in ("temp", "occupancy")]
+            # Gateway slotOffsetMs(): the 1 s nodes spread evenly over the cycle
+            usable = SLOT_CYCLE_MS - SLOT_GUARD_MS - SLOT_TAIL_MS
+            count = max(len(self.slot_nodes), 1)
+            self.slot_offsets = [SLOT_GUARD_MS + k * usable // count for k in range(len(self.slot_nodes))]
+            gw = GatewayNode(0, SLOT_SYNC_ID, False, SYNC_TIME_DLC, SLOT_CYCLE_MS, 0.0, self.start)
+            gw.msg.data[0:2] = bytes([SLOT_CYCLE_MS >> 8, SLOT_CYCLE_MS & 0xFF])
+            gw.sim = self
+            gw.assign_msg = can.Message(arbitration_id=SLOT_ASSIGN_ID, is_extended_id=False, dlc=4, data=bytes(4))
+            gw.next_assign = 0
+            gw.round_done = False
+            gw.assigns = gw.assigns_sent = 0
+            gw.cycle_start = self.start
+            gw.next_due = self.start
+            self.nodes.append(gw)
+
+        for n in self.nodes:
+            self.wheel.schedule(n.next_due, n)
+
+    def _dispatch(self, msg: can.Message, now: float):
+        targets = self.commands.get((msg.arbitration_id, msg.is_extended_id))
+        if not targets or msg.dlc < 1:
+            return
+        self.rx_commands += 1
+        for n in targets:
+            n.command(now, msg.data[0])
+
+    def slot_rx(self, now: float, frame: tuple):
+        """A gateway frame, (target node or None for the sync, sent at, offset s or reference ms), reaches the slotted nodes.
+
+        A node reads it at once unless its loop() is blocked before a send;
+        then it waits in one of the RX buffers until the poll after the send,
+        or is lost if both are taken (every node's filter passes every 0x011).
+        """
+        target = frame[0]
+        for n in self.slot_nodes:
+            if n.block and n.next_due - n.block <= now < n.next_due:
+                if len(n.rx) < MCP2515_RX_BUFFERS:
+                    n.rx.append(frame)
+                else:
+                    self.rx_lost += 1
+                    if n is target:
+                        self.assign_lost += 1
+            elif target is None or n is target:
+                self.slot_read(n, frame, now)
+
+    def slot_read(self, n: SimNode, frame: tuple, now: float):
+        """Sketch pollSlotSync() reading one frame at `now`: on 0x010 time sync, then next send = read time + offset."""
+        target, sent, value = frame
+        if target is not None:
+            if target is n:
+                n.slot = value
+            return
+        tick_s = self.wheel.tick_s
+        if now - sent > tick_s:
+            self.sync_late += 1
+            self.max_sync_late = max(self.max_sync_late, now - sent)
+        n.on_time_sync(now, value)
+        if n.slot is None:
+            return
+        # sendDue() turns true at the slot; the frame follows once the loop is done blocking
+        due = now + n.slot / (1.0 + n.drift) + n.block
+        if abs(due - n.next_due) > tick_s:
+            n.next_due = due
+            self.wheel.schedule(due, n)
+
+    def emit(self, msg: can.Message, now: float, kind: str):
+        if self.records is not None:
+            self.records.append((now, msg.arbitration_id, msg.is_extended_id, msg.dlc, kind, bytes(msg.data)))
+            self.sent += 1
+            return
+        try:
+            self.bus.send(msg)
+            self.sent += 1
+        except can.CanError as e:
+            if self.tx_errors == 0:
+                print(f"Send failed: {e}")
+            self.tx_errors += 1
+
+    def _tick(self, now: float):
+        wheel, rng = self.wheel, self.rng
+        tick_s = wheel.tick_s
+        for n in wheel.expire(now):
+            if n.next_due - now > tick_s:
+                # Superseded by a slot re-anchor; the node has a newer timer
+                continue
+            late = now - n.next_due
+            if late > tick_s:
+                self.late += 1
+                if late > self.max_late:
+                    self.max_late = late
+            msg = n.fire(now, rng)
+            if msg is not None:
+                self.emit(msg, now, n.kind)
+            # Reschedule from the ideal due time so tick rounding never accumulates
+            n.next_due += n.period
+            wheel.schedule(n.next_due, n)
+            if n.rx:
+                # The poll after the send drains what arrived while the loop was blocked
+                frames, n.rx = n.rx, []
+                for frame in frames:
+                    self.slot_read(n, frame, now)
+
+    def run_virtual(self, duration: float):
+        """Advance tick by tick without sleeping or a bus; frames go to self.records."""
+        self.cpu0 = time.process_time()
+        now = self.start
+        while now < duration:
+            self._tick(now)
+            now = self.wheel.next_time()
+        self.elapsed = duration
+
+    def run(self, duration: float = None, stats_interval: float = 1.0):
+        bus, wheel = self.bus, self.wheel
+        listen = bool(self.commands)
+        t0 = time.monotonic()
+        self.cpu0 = cpu0 = time.process_time()
+        next_stats = stats_interval
+        last_sent = 0
+        while True:
+            now = time.monotonic() - t0
+            self.elapsed = now
+            if duration and now >= duration:
+                break
+            self._tick(now)
+            if now >= next_stats:
+                cpu = time.process_time() - cpu0
+                print(f"[sim] {self.sent - last_sent:7d} frames/s  late={self.late}  "
+                      f"max late={self.max_late * 1000:.1f} ms  cpu={100 * cpu / now:.0f}%")
+                last_sent = self.sent
+                next_stats += stats_interval
+            timeout = wheel.next_time() - (time.monotonic() - t0)
+            if listen:
+                msg = bus.recv(timeout if timeout > 0 else 0)
+                while msg is not None:
+                    self._dispatch(msg, time.monotonic() - t0)
+                    msg = bus.recv(0)
+            elif timeout > 0:
+                time.sleep(timeout)
+
+    def summary(self):
+        elapsed = self.elapsed
+        cpu = time.process_time() - self.cpu0
+        counts: Dict[str, int] = {}
+        for n in self.nodes:
+            counts[n.kind] = counts.get(n.kind, 0) + 1
+        print("\n=== LOT SIMULATOR SUMMARY ===")
+        print("Nodes: " + ", ".join(f"{k}={v}" for k, v in counts.items()) + f" (total {len(self.nodes)})")
+        print(f"Frames: {self.sent} in {elapsed:.1f}s ({self.sent / max(elapsed, 1e-9):.0f} frames/s), "
+              f"tx errors={self.tx_errors}, barrier commands={self.rx_commands}")
+        print(f"Timers late by more than one tick: {self.late} (max {self.max_late * 1000:.1f} ms)")
+        if self.slot_nodes:
+            assigned = sum(1 for n in self.slot_nodes if n.slot is not None)
+            print(f"Slot sync: {assigned}/{len(self.slot_nodes)} nodes assigned, {self.sync_late} syncs read late "
+                  f"(max {self.max_sync_late * 1000:.1f} ms), {self.rx_lost} frames lost to full RX buffers "
+                  f"({self.assign_lost} own assignments)")
+        print(f"CPU: {cpu:.1f}s ({100 * cpu / max(elapsed, 1e-9):.0f}% of one core)")
+
+
+def build_parser() -> argparse.ArgumentParser:
+    parser = argparse.ArgumentParser(description="Virtual parking-lot CAN node simulator",
+                                     formatter_class=argparse.ArgumentDefaultsHelpFormatter)
+    parser.add_argument("--bus-type", default="socketcan", help="python-can interface (socketcan, virtual, ...)")
+    parser.add_argument("--channel", default="vcan0", help="CAN channel")
+    parser.add_argument("--bitrate", type=int, default=None, help="Bitrate (adapter-specific)")
+    parser.add_argument("--temp", type=int, default=1, help="Temperature nodes (transmitterCAN)")
+    parser.add_argument("--occupancy", type=int, default=1, help="Occupancy nodes (ultrasonic)")
+    parser.add_argument("--ambient", type=int, default=1, help="Gas/air-quality nodes (ambient_transmitter)")
+    parser.add_argument("--barrier", type=int, default=1, help="Barrier nodes (servoMotor)")
+    parser.add_argument("--id-mode", choices=["sketch", "offset", "extended"], default="sketch",
+                        help="sketch: all nodes share the sketch IDs; offset: sketch ID + index * stride; "
+                             "extended: 29-bit sketch ID << 18 | index")
+    parser.add_argument("--id-stride", type=int, default=1, help="ID step between nodes in offset mode")
+    parser.add_argument("--boot-spread-ms", type=float, default=None,
+                        help="Simulate a common power cycle: all nodes boot within this window (default: random uptimes)")
+    parser.add_argument("--slots", action="store_true", help="Emulate the gateway slot sync (per-node assignments) and phase-staggered sends")
+    parser.add_argument("--occupancy-delay-ms", type=float, default=0.0,
+                        help="Extra blocking delay per reading in the occupancy sketch "
+                             "(250 reproduces ultrasonic.ino before it polled continuously)")
+    parser.add_argument("--stamp", action="store_true",
+                        help="Temperature/occupancy frames carry a network-time stamp (3 trailing bytes)")
+    parser.add_argument("--drift-ppm", type=float, default=50.0, help="Clock drift drawn uniformly from +/- this many ppm")
+    parser.add_argument("--dwell", type=float, default=600.0, help="Mean parked time per car (s)")
+    parser.add_argument("--vacancy", type=float, default=300.0, help="Mean time a spot stays free (s)")
+    parser.add_argument("--tick-ms", type=float, default=1.0, help="Timer wheel resolution (ms)")
+    parser.add_argument("--duration", type=float, default=None, help="Seconds to run (omit for indefinite)")
+    parser.add_argument("--stats", type=float, default=1.0, help="Stats interval (s)")
+    parser.add_argument("--seed", type=int, default=None, help="Random seed")
+    parser.add_argument("--analyze", action="store_true",
+                        help="Run --duration seconds in virtual time without a bus and report bus load and latency")
+    parser.add_argument("--window-ms", type=float, default=10.0, help="Load window for --analyze (ms)")
+    parser.add_argument("--warmup", type=float, default=2.0, help="Seconds excluded from --analyze statistics")
+    parser.add_argument("--capture", default=None, help="With --analyze, write the modelled bus as a candump log")
+    return parser
+
+
+def main():
+    args = build_parser().parse_args()
+    if args.analyze:
+        bitrate = args.bitrate or 500000
+        try:
+            sim = LotSimulator(None, args)
+        except ValueError as e:
+            print(f"Error: {e}", file=sys.stderr)
+            sys.exit(2)
+        sim.run_virtual(args.duration or 30.0)
+        sim.summary()
+        latency = arbitrate(sim.records, bitrate)
+        print_report(analyze(sim.records, bitrate, args.window_ms / 1000.0, args.warmup, latency),
+                     bitrate, args.window_ms / 1000.0, args.warmup)
+        if args.capture:
+            # Frames are stamped with the end of their modelled transmission
+            rows = sorted((rec[0] + lat, rec) for rec, lat in zip(sim.records, latency))
+            with open(args.capture, "w") as f:
+                f.writelines(format_line(ts, rec[1], rec[2], rec[5], args.channel) for ts, rec in rows)
+            print(f"Capture: {args.capture} ({len(rows)} frames)")
+        return
+    bus_kwargs = {"interface": args.bus_type, "channel": args.channel}
+    if args.bitrate:
+        bus_kwargs["bitrate"] = args.bitrate
+    bus = can.Bus(**bus_kwargs)
+    try:
+        sim = LotSimulator(bus, args)
+    except ValueError as e:
+        bus.shutdown()
+        print(f"Error: {e}", file=sys.stderr)
+        sys.exit(2)
+    print(f"Simulating {len(sim.nodes)} nodes on {args.channel}")
+    try:
+        sim.run(args.duration, args.stats)
+    except KeyboardInterrupt:
+        pass
+    finally:
+        sim.summary()
+        bus.shutdown()
+
+
+if __name__ == "__main__":
+    main()
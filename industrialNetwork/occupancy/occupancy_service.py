@@ -0,0 +1,358 @@
+#!/usr/bin/env python3
+"""
+Parking occupancy service
+
+Keeps the current state of every spot from the occupancy frames (0x701
+range, data[0] = 1 busy / 0 free, ultrasonic.ino) instead of leaving it in raw
+frame logs:
+- per spot: state, time of the last change, number of stays and dwell time
+  (time busy) totals
+- per zone and for the whole lot: spots reporting, free and busy counts and
+  dwell totals, adjusted by +/-1 on each state change, so "free spots in
+  zone X" is a dictionary lookup whatever the lot size
+- a spot that has not reported for --stale-s seconds is taken out of the
+  counts until it reports again; spots are kept in last-report order so the
+  sweep only touches the ones that went quiet
+
+Each change is published as an event on gate/{gate}/occupancy/events;
+retained per-zone summaries (gate/{gate}/occupancy/zone/{zone}) and the lot
+summary (gate/{gate}/occupancy/lot) are republished at most once per
+--summary-interval, only when they changed, so a new subscriber gets
+current counts from the broker without polling anything.
+
+Spot numbers come from the CAN ID as in lot_simulator --id-mode (extended:
+low 18 bits; offset: (id - 0x701) / stride), so every occupancy node needs
+its own CAN ID. The stock ultrasonic sketch sends 0x701 from every node,
+which would collapse the lot into spot 0: --id-mode has no default and
+"sketch" is not accepted. Zones are ranges of spot numbers
+(--zones A=0-99,B=100-199) or fixed-size blocks (--zone-size).
+
+Usage:
+    python industrialNetwork/occupancy/occupancy_service.py --channel vcan0 --id-mode extended --zone-size 100
+    python industrialNetwork/occupancy/occupancy_service.py --offline lot.log --id-mode offset --zones A=0-19,B=20-39
+"""
+import argparse
+import json
+import os
+import sys
+import time
+from collections import OrderedDict
+from typing import Dict, List, Optional, Tuple
+
+sys.path.insert(0, os.path.abspath(os.path.join(os.path.dirname(__file__), "..", "bridge")))
+sys.path.insert(0, os.path.abspath(os.path.join(os.path.dirname(__file__), "..", "..")))
+from telemetry import EXT_FLAG, SIGNALS_BY_NAME, SignalMap  # noqa: E402
+
+OCCUPANCY = SIGNALS_BY_NAME["occupancy"]
+
+
+class ZoneStats:
+    __slots__ = ("name", "total", "free", "busy", "stays", "dwell_sum", "dwell_max", "dirty")
+
+    def __init__(self, name: str):
+        self.name = name
+        self.total = 0
+        self.free = 0
+        self.busy = 0
+        self.stays = 0
+        self.dwell_sum = 0.0
+        self.dwell_max = 0.0
+        self.dirty = True
+
+    def count(self, busy: bool, sign: int):
+        self.total += sign
+        if busy:
+            self.busy += sign
+        else:
+            self.free += sign
+        self.dirty = True
+
+    def stay(self, dwell: float):
+        self.stays += 1
+        self.dwell_sum += dwell
+        if dwell > self.dwell_max:
+            self.dwell_max = dwell
+
+    def summary(self) -> Dict:
+        return {"zone": self.name, "free": self.free, "busy": self.busy, "reporting": self.total,
+                "stays": self.stays, "mean_dwell_s": round(self.dwell_sum / self.stays, 1) if self.stays else None,
+                "max_dwell_s": round(self.dwell_max, 1)}
+
+
+class Spot:
+    __slots__ = ("number", "zone", "busy", "since", "last_seen", "candidate", "streak",
+                 "stays", "dwell_sum", "dwell_max")
+
+    def __init__(self, number: int, zone: ZoneStats):
+        self.number = number
+        self.zone = zone
+        self.busy: Optional[bool] = None   # None = unknown (never reported, or stale)
+        self.since = 0.0
+        self.last_seen = 0.0
+        self.candidate = None
+        self.streak = 0
+        self.stays = 0
+        self.dwell_sum = 0.0
+        self.dwell_max = 0.0
+
+
+class OccupancyStore:
+    """Spot states with incrementally maintained zone and lot counts."""
+
+    def __init__(self, zone_of, debounce: int = 1, stale_s: float = 5.0):
+        self.zone_of = zone_of
+        self.debounce = max(1, debounce)
+        self.stale_s = stale_s
+        self.spots: "OrderedDict[int, Spot]" = OrderedDict()   # oldest report first
+        self.zones: Dict[str, ZoneStats] = {}
+        self.lot = ZoneStats("lot")
+        self.changes = 0
+
+    def _zone(self, number: int) -> ZoneStats:
+        name = self.zone_of(number)
+        zone = self.zones.get(name)
+        if zone is None:
+            zone = self.zones[name] = ZoneStats(name)
+        return zone
+
+    def free(self, zone: Optional[str] = None) -> int:
+        """Free spots in `zone` (the whole lot if None); O(1)."""
+        if zone is None:
+            return self.lot.free
+        z = self.zones.get(zone)
+        return z.free if z is not None else 0
+
+    def update(self, number: int, busy: bool, ts: float) -> Optional[Dict]:
+        """Apply one report; returns a change event, or None if the state did not change."""
+        spot = self.spots.get(number)
+        if spot is None:
+            spot = self.spots[number] = Spot(number, self._zone(number))
+        else:
+            self.spots.move_to_end(number)
+        spot.last_seen = ts
+        if spot.busy is not None and busy == spot.busy:
+            spot.streak = 0
+            return None
+        if spot.busy is not None and self.debounce > 1:
+            if busy != spot.candidate:
+                spot.candidate, spot.streak = busy, 0
+            spot.streak += 1
+            if spot.streak < self.debounce:
+                return None
+            spot.streak = 0
+        return self._set(spot, busy, ts)
+
+    def _set(self, spot: Spot, busy: Optional[bool], ts: float) -> Dict:
+        previous = spot.busy
+        zone = spot.zone
+        if previous is not None:
+            zone.count(previous, -1)
+            self.lot.count(previous, -1)
+        if busy is not None:
+            zone.count(busy, +1)
+            self.lot.count(busy, +1)
+        dwell = None
+        if previous is True and busy is False and spot.since:
+            dwell = ts - spot.since
+            spot.stays += 1
+            spot.dwell_sum += dwell
+            spot.dwell_max = max(spot.dwell_max, dwell)
+            zone.stay(dwell)
+            self.lot.stay(dwell)
+        spot.busy = busy
+        # A spot first seen (or back from stale) has no known change time
+        spot.since = ts if previous is not None and busy is not None else 0.0
+        self.changes += 1
+        return {"spot": spot.number, "zone": zone.name, "state": {True: "busy", False: "free", None: "unknown"}[busy],
+                "t": round(ts, 3), "dwell_s": round(dwell, 1) if dwell is not None else None,
+                "zone_free": zone.free, "lot_free": self.lot.free}
+
+    def expire(self, now: float) -> List[Dict]:
+        """Mark spots silent for stale_s as unknown; only visits the spots that went quiet."""
+        events = []
+        limit = now - self.stale_s
+        for number, spot in self.spots.items():
+            if spot.last_seen > limit:
+                break
+            if spot.busy is not None:
+                events.append(self._set(spot, None, now))
+        return events
+
+
+def parse_zones(spec: Optional[str], zone_size: int):
+    """Spot number -> zone name function from --zones / --zone-size."""
+    ranges: List[Tuple[int, int, str]] = []
+    if spec:
+        for item in spec.split(","):
+            name, _, span = item.partition("=")
+            lo, _, hi = span.partition("-")
+            try:
+                ranges.append((int(lo), int(hi or lo), name.strip()))
+            except ValueError:
+                raise argparse.ArgumentTypeError(f"bad zone '{item}', expected NAME=FIRST-LAST")
+
+    def zone_of(number: int) -> str:
+        for lo, hi, name in ranges:
+            if lo <= number <= hi:
+                return name
+        if zone_size:
+            return f"Z{number // zone_size}"
+        return "other" if ranges else "lot"
+    return zone_of
+
+
+class OccupancyService:
+    def __init__(self, store: OccupancyStore, signals: SignalMap, client=None, gate: str = "1",
+                 summary_interval: float = 1.0):
+        self.store = store
+        self.signals = signals
+        self.client = client
+        self.base = f"gate/{gate}/occupancy"
+        self.summary_interval = summary_interval
+        self.next_summary = 0.0
+        self.next_expire = 0.0
+        self.frames = 0
+        self.events = 0
+
+    def on_frame(self, can_id: int, extended: bool, data, ts: float):
+        key = can_id | EXT_FLAG if extended else can_id
+        if self.signals.resolve(key) is not OCCUPANCY or not data:
+            return
+        self.frames += 1
+        event = self.store.update(self.signals.node_index(key, OCCUPANCY), bool(data[0]), ts)
+        if event is not None:
+            self._publish_event(event)
+
+    def _publish_event(self, event: Dict):
+        self.events += 1
+        if self.client is not None:
+            self.client.publish(f"{self.base}/events", json.dumps(event))
+
+    def tick(self, now: float):
+        if now >= self.next_expire:
+            for event in self.store.expire(now):
+                self._publish_event(event)
+            self.next_expire = now + min(1.0, self.store.stale_s / 4)
+        if now >= self.next_summary:
+            self.publish_summaries()
+            self.next_summary = now + self.summary_interval
+
+    def publish_summaries(self):
+        for zone in list(self.store.zones.values()) + [self.store.lot]:
+            if not zone.dirty:
+                continue
+            zone.dirty = False
+            if self.client is not None:
+                topic = f"{self.base}/lot" if zone is self.store.lot else f"{self.base}/zone/{zone.name}"
+                self.client.publish(topic, json.dumps(zone.summary()), retain=True)
+
+    def report(self) -> str:
+        lines = [f"=== OCCUPANCY ({self.frames} frames, {self.store.changes} changes, {self.events} events) ==="]
+        for zone in sorted(self.store.zones.values(), key=lambda z: z.name) + [self.store.lot]:
+            s = zone.summary()
+            dwell = f"mean dwell {s['mean_dwell_s']:.0f} s" if s["stays"] else "no completed stays"
+            lines.append(f"  {zone.name:8s} free {zone.free:6d} / {zone.total:6d} reporting, "
+                         f"{zone.stays} stays, {dwell}")
+        return "\n".join(lines)
+
+
+def run_live(service: OccupancyService, bus, duration: Optional[float], stats: float):
+    t0 = time.time()
+    end = t0 + duration if duration else float("inf")
+    next_stats = t0 + stats
+    while True:
+        now = time.time()
+        if now >= end:
+            break
+        msg = bus.recv(timeout=min(0.25, max(0.0, end - now)))
+        if msg is not None:
+            service.on_frame(msg.arbitration_id, msg.is_extended_id, msg.data, msg.timestamp or time.time())
+        now = time.time()
+        service.tick(now)
+        if now >= next_stats:
+            print(service.report())
+            next_stats = now + stats
+
+
+def run_offline(service: OccupancyService, path: str):
+    from canlog.candump import CandumpReader
+    reader = CandumpReader(path)
+    for frames in reader:
+        for ts, can_id, ext, dlc, data in zip(frames["ts"].tolist(), frames["id"].tolist(), frames["ext"].tolist(),
+                                              frames["dlc"].tolist(), frames["data"]):
+            service.on_frame(can_id, ext, bytes(data[:dlc]), ts)
+            if ts >= service.next_expire:
+                service.tick(ts)
+    if reader.malformed_count:
+        print(f"Skipped {reader.malformed_count} malformed lines")
+
+
+def build_parser() -> argparse.ArgumentParser:
+    parser = argparse.ArgumentParser(description="Parking occupancy service",
+                                     formatter_class=argparse.ArgumentDefaultsHelpFormatter)
+    parser.add_argument("--bus-type", default="socketcan", help="python-can interface (socketcan, virtual, ...)")
+    parser.add_argument("--channel", default="can0", help="CAN channel")
+    parser.add_argument("--offline", metavar="CANDUMP", default=None, help="Replay a candump log instead of the bus")
+    parser.add_argument("--id-mode", choices=["offset", "extended"], required=True,
+                        help="How per-node CAN IDs are allocated (same as lot_simulator --id-mode); "
+                             "spots need one CAN ID per node")
+    parser.add_argument("--id-stride", type=int, default=1, help="ID step between nodes in offset mode")
+    parser.add_argument("--zones", default=None, metavar="NAME=FIRST-LAST,...", help="Zones as spot number ranges")
+    parser.add_argument("--zone-size", type=int, default=0, help="Otherwise, zones of this many consecutive spots")
+    parser.add_argument("--debounce", type=int, default=1, help="Consecutive reports needed to accept a change")
+    parser.add_argument("--stale-s", type=float, default=5.0, help="Silence after which a spot is unknown")
+    parser.add_argument("--broker", default=None, help="MQTT broker host (omit to only print)")
+    parser.add_argument("--port", type=int, default=1883, help="MQTT broker port")
+    parser.add_argument("--username", default=None, help="MQTT username")
+    parser.add_argument("--password", default=None, help="MQTT password")
+    parser.add_argument("--gate", default="1", help="Gate ID used in the topics")
+    parser.add_argument("--summary-interval", type=float, default=1.0, help="Min seconds between zone summaries")
+    parser.add_argument("--duration", type=float, default=None, help="Seconds to run (omit for indefinite)")
+    parser.add_argument("--stats", type=float, default=10.0, help="Report interval (s)")
+    return parser
+
+
+def main():
+    args = build_parser().parse_args()
+    try:
+        zone_of = parse_zones(args.zones, args.zone_size)
+    except argparse.ArgumentTypeError as e:
+        print(f"Error: {e}", file=sys.stderr)
+        sys.exit(2)
+    client = None
+    if args.broker:
+        import paho.mqtt.client as mqtt
+        client = mqtt.Client(callback_api_version=mqtt.CallbackAPIVersion.VERSION2)
+        if args.username:
+            client.username_pw_set(args.username, args.password)
+        try:
+            client.connect(args.broker, args.port, 60)
+        except OSError as e:
+            print(f"Error: could not connect to MQTT broker {args.broker}:{args.port}: {e}", file=sys.stderr)
+            sys.exit(1)
+        client.loop_start()
+    store = OccupancyStore(zone_of, args.debounce, args.stale_s)
+    service = OccupancyService(store, SignalMap(args.id_mode, args.id_stride), client, args.gate,
+                               args.summary_interval)
+    try:
+        if args.offline:
+            run_offline(service, args.offline)
+        else:
+            import can
+            bus = can.Bus(interface=args.bus_type, channel=args.channel)
+            try:
+                run_live(service, bus, args.duration, args.stats)
+            finally:
+                bus.shutdown()
+    except KeyboardInterrupt:
+        pass
+    finally:
+        service.publish_summaries()
+        print(service.report())
+        if client is not None:
+            client.loop_stop()
+            client.disconnect()
+
+
+if __name__ == "__main__":
+    main()
@@ -17,6 +17,11 @@ const unsigned long TEMP_PERIOD_MS = 60000UL; // period for sine wave (60s)
 unsigned long lastSendMillis = 0;
 const unsigned long SEND_INTERVAL_MS = 1000UL; // send every 5 seconds
 
+// Gateway slot sync and network time: industrialNetwork/libraries/SlotSync
+#define NODE_ID 1                  // unique per board (1..SLOT_NODE_COUNT on the gateway): set before flashing
+// #define STAMP_FRAMES 1          // append network-time stamps for latency measurement
+#include <SlotSync.h>
+
 void setup() {
   Serial.begin(115200);
   delay(10);
@@ -24,6 +29,7 @@ void setup() {
   SPI.begin();
   mcp2515.reset();
   mcp2515.setBitrate(CAN_500KBPS, MCP_8MHZ);
+  setupSlotSyncFilters(mcp2515);
   mcp2515.setNormalMode();
 
   // seed random with some entropy (floating pin)
@@ -40,13 +46,14 @@ float simulatedTemperature() {
 }
 
 void loop() {
+  pollSlotSync(mcp2515, &canRx);
+
   unsigned long now = millis();
 
-  if (now - lastSendMillis < SEND_INTERVAL_MS) {
+  if (!sendDue(now, lastSendMillis, SEND_INTERVAL_MS)) {
     // nothing to do yet
     return;
   }
-  lastSendMillis = now;
 
   float temperatureC = simulatedTemperature();
   int tempInt = (int)round(temperatureC * 100.0f); // centi-degrees stored in 2 bytes
@@ -63,6 +70,9 @@ void loop() {
   unsigned int waitTime = 100;
 
 
+#if STAMP_FRAMES
+  appendStamp(&canTx);
+#endif
   if (mcp2515.sendMessage(&canTx) == MCP2515::ERROR_OK) {
       Serial.print("[CAN] Sent temperature: ");
       Serial.print(temperatureC, 2);
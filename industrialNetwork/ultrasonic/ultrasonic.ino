@@ -9,6 +9,7 @@ struct MCP2515 mcp2515(10); // CS pin is GPIO 5
 
 #define MAX_RETRIES 3
 #define CAN_TX_ID  0x701
+#define ECHO_TIMEOUT_US 30000UL     // 5 m and back; no echo counts as 0 cm, as before
 
 Ultrasonic ultrasonic(7);
 
@@ -17,6 +18,11 @@ const unsigned long TEMP_PERIOD_MS = 60000UL; // period for sine wave (60s)
 unsigned long lastSendMillis = 0;
 const unsigned long SEND_INTERVAL_MS = 1000UL; // send every 5 seconds
 
+// Gateway slot sync and network time: industrialNetwork/libraries/SlotSync
+#define NODE_ID 2                  // unique per board (1..SLOT_NODE_COUNT on the gateway): set before flashing
+// #define STAMP_FRAMES 1          // append network-time stamps for latency measurement
+#include <SlotSync.h>
+
 void setup() {
   Serial.begin(115200);
   delay(10);
@@ -24,17 +30,19 @@ void setup() {
   SPI.begin();
   mcp2515.reset();
   mcp2515.setBitrate(CAN_500KBPS, MCP_8MHZ);
+  setupSlotSyncFilters(mcp2515);
   mcp2515.setNormalMode();
 }
 
 void loop() {
+  pollSlotSync(mcp2515, &canRx);
+
   unsigned long now = millis();
 
-  if (now - lastSendMillis < SEND_INTERVAL_MS) {
+  if (!sendDue(now, lastSendMillis, SEND_INTERVAL_MS)) {
     // nothing to do yet
     return;
   }
-  lastSendMillis = now;
 
 
   unsigned int waitTime = 100;
@@ -51,15 +59,18 @@ void loop() {
 
   Serial.println("The distance to obstacles in front is: ");
 
-  RangeInCentimeters = ultrasonic.MeasureInCentimeters(); // two measurements should keep an interval
+  // Nothing is read from the bus while measuring: the echo timeout bounds it (slot tail on the gateway)
+  RangeInCentimeters = ultrasonic.MeasureInCentimeters(ECHO_TIMEOUT_US); // two measurements should keep an interval
   Serial.print(RangeInCentimeters);//0~400cm
   Serial.println(" cm");
 
   busy =  RangeInCentimeters < 100 ? 1:0;
   canTx.data[0] = (byte)busy;
-  delay(250);
 
 
+#if STAMP_FRAMES
+  appendStamp(&canTx);
+#endif
   if (mcp2515.sendMessage(&canTx) == MCP2515::ERROR_OK) {
       Serial.print("[CAN] Sent occupation: ");
       Serial.println(busy ? "Ocupado" : "Libre");
@@ -0,0 +1,88 @@
+"""
+Local stand-in for the YOLO ANPR API, for benchmarking access/anpr_client.py
+
+Serves POST /api/anpr (one "image" part) and POST /api/anpr/batch (several
+"image" parts, answered as {"results": [...]} in part order) over keep-alive
+HTTP/1.1. Inference is modelled as one model shared by all requests: each
+call holds the model for --fixed-ms plus --per-image-ms per image, which is
+the cost structure batching amortizes.
+"""
+import argparse
+import json
+import re
+import threading
+import time
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+
+_FILENAME_RE = re.compile(rb'filename="([^"]*)"')
+
+
+def split_images(body: bytes, boundary: bytes):
+    """(filename, size) per multipart part."""
+    parts = []
+    for part in body.split(b"--" + boundary)[1:]:
+        if part.startswith(b"--"):
+            break
+        head, _, data = part.partition(b"\r\n\r\n")
+        m = _FILENAME_RE.search(head)
+        parts.append((m.group(1).decode() if m else "", len(data) - 2))
+    return parts
+
+
+class StubHandler(BaseHTTPRequestHandler):
+    protocol_version = "HTTP/1.1"
+    disable_nagle_algorithm = True  # headers and body go out in separate writes
+    model_lock = threading.Lock()
+    fixed_s = 0.008
+    per_image_s = 0.002
+    batch_endpoint = True
+
+    def log_message(self, fmt, *args):
+        pass
+
+    def _reply(self, status: int, obj):
+        data = json.dumps(obj).encode()
+        self.send_response(status)
+        self.send_header("Content-Type", "application/json")
+        self.send_header("Content-Length", str(len(data)))
+        self.end_headers()
+        self.wfile.write(data)
+
+    def do_POST(self):
+        body = self.rfile.read(int(self.headers.get("Content-Length", 0)))
+        batch = self.path == "/api/anpr/batch"
+        if self.path != "/api/anpr" and not (batch and self.batch_endpoint):
+            self._reply(404, {"error": "not found"})
+            return
+        m = re.search(r"boundary=([^;]+)", self.headers.get("Content-Type", ""))
+        images = split_images(body, m.group(1).encode()) if m else []
+        if not images or (not batch and len(images) != 1):
+            self._reply(400, {"error": "expected multipart image parts"})
+            return
+        with self.model_lock:
+            time.sleep(self.fixed_s + self.per_image_s * len(images))
+        results = [{"plate_text": f"STUB{size % 10000:04d}", "confidence": 0.9, "image_id": name}
+                   for name, size in images]
+        self._reply(200, {"results": results} if batch else results[0])
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Stub ANPR API server")
+    parser.add_argument("--port", type=int, default=4000)
+    parser.add_argument("--fixed-ms", type=float, default=8.0, help="Model cost per request")
+    parser.add_argument("--per-image-ms", type=float, default=2.0, help="Model cost per image")
+    parser.add_argument("--no-batch-endpoint", action="store_true", help="Answer /api/anpr/batch with 404")
+    args = parser.parse_args()
+    StubHandler.fixed_s = args.fixed_ms / 1000.0
+    StubHandler.per_image_s = args.per_image_ms / 1000.0
+    StubHandler.batch_endpoint = not args.no_batch_endpoint
+    server = ThreadingHTTPServer(("127.0.0.1", args.port), StubHandler)
+    print(f"Stub ANPR API on http://127.0.0.1:{args.port}/api/anpr")
+    try:
+        server.serve_forever()
+    except KeyboardInterrupt:
+        pass
+
+
+if __name__ == "__main__":
+    main()
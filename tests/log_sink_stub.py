@@ -0,0 +1,102 @@
+"""
+Local stand-in for the server's access-log batch endpoint (access/log_sync.py)
+
+Stores each record once per idempotency key and answers
+{"accepted": n, "duplicates": m}. Faults can be injected to exercise retries:
+--fail-every N answers every Nth request with 503 before storing anything,
+--drop-ack-every N stores the batch and then closes the connection without
+replying (the client must retry, and the retry must come back as duplicates).
+"""
+import argparse
+import json
+import threading
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+
+
+class LogSinkServer(ThreadingHTTPServer):
+    daemon_threads = True
+
+    def __init__(self, port: int = 0, fail_every: int = 0, drop_ack_every: int = 0):
+        super().__init__(("127.0.0.1", port), LogSinkHandler)
+        self.fail_every = fail_every
+        self.drop_ack_every = drop_ack_every
+        self.records = {}       # key -> record
+        self.requests = 0
+        self.duplicates = 0
+        self.lock = threading.Lock()
+
+    @property
+    def url(self) -> str:
+        return f"http://127.0.0.1:{self.server_address[1]}/api/logs/batch"
+
+    def start(self) -> threading.Thread:
+        thread = threading.Thread(target=self.serve_forever, daemon=True)
+        thread.start()
+        return thread
+
+
+class LogSinkHandler(BaseHTTPRequestHandler):
+    protocol_version = "HTTP/1.1"
+    disable_nagle_algorithm = True
+
+    def log_message(self, fmt, *args):
+        pass
+
+    def _reply(self, status: int, obj):
+        data = json.dumps(obj).encode()
+        self.send_response(status)
+        self.send_header("Content-Type", "application/json")
+        self.send_header("Content-Length", str(len(data)))
+        self.end_headers()
+        self.wfile.write(data)
+
+    def do_POST(self):
+        body = self.rfile.read(int(self.headers.get("Content-Length", 0)))
+        srv = self.server
+        with srv.lock:
+            srv.requests += 1
+            n = srv.requests
+        if self.path != "/api/logs/batch":
+            self._reply(404, {"error": "not found"})
+            return
+        if srv.fail_every and n % srv.fail_every == 0:
+            self._reply(503, {"error": "injected failure"})
+            return
+        try:
+            logs = json.loads(body)["logs"]
+        except (ValueError, KeyError):
+            self._reply(400, {"error": "expected {\"logs\": [...]}"})
+            return
+        accepted = duplicates = 0
+        with srv.lock:
+            for rec in logs:
+                if rec["key"] in srv.records:
+                    duplicates += 1
+                else:
+                    srv.records[rec["key"]] = rec
+                    accepted += 1
+            srv.duplicates += duplicates
+        if srv.drop_ack_every and n % srv.drop_ack_every == 0:
+            self.close_connection = True
+            return
+        self._reply(200, {"accepted": accepted, "duplicates": duplicates})
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Stub access-log sync server")
+    parser.add_argument("--port", type=int, default=5000)
+    parser.add_argument("--fail-every", type=int, default=0, help="Answer every Nth request with 503")
+    parser.add_argument("--drop-ack-every", type=int, default=0,
+                        help="Store every Nth batch but drop the connection before replying")
+    args = parser.parse_args()
+    server = LogSinkServer(args.port, args.fail_every, args.drop_ack_every)
+    print(f"Stub log sink on {server.url}")
+    try:
+        server.serve_forever()
+    except KeyboardInterrupt:
+        pass
+    print(f"{len(server.records)} records stored, {server.duplicates} duplicates, {server.requests} requests")
+
+
+if __name__ == "__main__":
+    main()
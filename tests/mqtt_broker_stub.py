@@ -0,0 +1,177 @@
+"""
+Local stand-in for the Mosquitto broker, for benchmarking the MQTT bridges
+
+Speaks the MQTT 3.1.1 subset the bridges use: CONNECT (no authentication:
+any credentials are accepted), SUBSCRIBE with + and # wildcards, PUBLISH at
+QoS 0 and 1 (acknowledged to the publisher, forwarded at QoS 0), PINGREQ and
+DISCONNECT. Nothing is retained or queued for offline clients.
+
+stop() closes the listening socket and every client connection, as a broker
+restart does; start() listens again on the same port.
+"""
+import argparse
+import socket
+import threading
+
+CONNECT, CONNACK, PUBLISH, PUBACK, SUBSCRIBE, SUBACK, PINGREQ, PINGRESP, DISCONNECT = 1, 2, 3, 4, 8, 9, 12, 13, 14
+
+
+def topic_matches(pattern: str, topic: str) -> bool:
+    pp, tp = pattern.split("/"), topic.split("/")
+    for i, p in enumerate(pp):
+        if p == "#":
+            return True
+        if i >= len(tp) or (p != "+" and p != tp[i]):
+            return False
+    return len(pp) == len(tp)
+
+
+def encode_length(n: int) -> bytes:
+    out = bytearray()
+    while True:
+        n, digit = divmod(n, 128)
+        out.append(digit | (0x80 if n else 0))
+        if not n:
+            return bytes(out)
+
+
+def _recv_exact(sock: socket.socket, n: int) -> bytes:
+    buf = b""
+    while len(buf) < n:
+        chunk = sock.recv(n - len(buf))
+        if not chunk:
+            raise EOFError
+        buf += chunk
+    return buf
+
+
+def _recv_packet(sock: socket.socket):
+    """(packet type, flags, body) of the next control packet."""
+    header = _recv_exact(sock, 1)[0]
+    length, shift = 0, 0
+    while True:
+        b = _recv_exact(sock, 1)[0]
+        length |= (b & 0x7F) << shift
+        shift += 7
+        if not b & 0x80:
+            break
+    return header >> 4, header & 0x0F, _recv_exact(sock, length) if length else b""
+
+
+class MqttBrokerStub:
+    def __init__(self, port: int = 0):
+        self.port = port
+        self.listener = None
+        self.clients = set()
+        self.subscriptions = []     # (client socket, topic filter)
+        self.published = 0
+        self.forwarded = 0
+        self.lock = threading.Lock()
+
+    def start(self) -> threading.Thread:
+        self.listener = socket.socket()
+        self.listener.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+        self.listener.bind(("127.0.0.1", self.port))
+        self.port = self.listener.getsockname()[1]
+        self.listener.listen(16)
+        thread = threading.Thread(target=self._accept_loop, args=(self.listener,), daemon=True)
+        thread.start()
+        return thread
+
+    def stop(self):
+        """Drop the listener and every connection, as a broker restart does."""
+        listener, self.listener = self.listener, None
+        if listener is not None:
+            try:
+                listener.shutdown(socket.SHUT_RDWR)
+            except OSError:
+                pass
+            listener.close()
+        with self.lock:
+            clients = list(self.clients)
+            self.clients.clear()
+            self.subscriptions.clear()
+        for sock in clients:
+            try:
+                sock.shutdown(socket.SHUT_RDWR)
+            except OSError:
+                pass
+
+    def _accept_loop(self, listener: socket.socket):
+        while True:
+            try:
+                sock, _ = listener.accept()
+            except OSError:
+                return
+            sock.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+            with self.lock:
+                self.clients.add(sock)
+            threading.Thread(target=self._serve_client, args=(sock,), daemon=True).start()
+
+    def _serve_client(self, sock: socket.socket):
+        try:
+            while True:
+                kind, flags, body = _recv_packet(sock)
+                if kind == CONNECT:
+                    sock.sendall(bytes([CONNACK << 4, 2, 0, 0]))
+                elif kind == PUBLISH:
+                    self._publish(sock, flags, body)
+                elif kind == SUBSCRIBE:
+                    packet_id, i, codes = body[:2], 2, bytearray()
+                    while i < len(body):
+                        n = int.from_bytes(body[i:i + 2], "big")
+                        with self.lock:
+                            self.subscriptions.append((sock, body[i + 2:i + 2 + n].decode()))
+                        i += 3 + n
+                        codes.append(0)     # granted QoS 0
+                    rest = packet_id + bytes(codes)
+                    sock.sendall(bytes([SUBACK << 4 | 0]) + encode_length(len(rest)) + rest)
+                elif kind == PINGREQ:
+                    sock.sendall(bytes([PINGRESP << 4, 0]))
+                elif kind == DISCONNECT:
+                    break
+        except (EOFError, OSError):
+            pass
+        with self.lock:
+            self.clients.discard(sock)
+            self.subscriptions = [s for s in self.subscriptions if s[0] is not sock]
+        sock.close()
+
+    def _publish(self, sock: socket.socket, flags: int, body: bytes):
+        qos = (flags >> 1) & 3
+        n = int.from_bytes(body[:2], "big")
+        topic = body[2:2 + n].decode()
+        i = 2 + n
+        if qos:
+            sock.sendall(bytes([PUBACK << 4, 2]) + body[i:i + 2])
+            i += 2
+        packet = body[:2 + n] + body[i:]
+        frame = bytes([PUBLISH << 4]) + encode_length(len(packet)) + packet
+        with self.lock:
+            self.published += 1
+            targets = [s for s, pattern in self.subscriptions if topic_matches(pattern, topic)]
+        for target in targets:
+            try:
+                target.sendall(frame)
+                self.forwarded += 1
+            except OSError:
+                pass
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Stub MQTT broker (3.1.1, QoS 0/1, no retain)")
+    parser.add_argument("--port", type=int, default=1883)
+    args = parser.parse_args()
+    broker = MqttBrokerStub(args.port)
+    broker.start()
+    print(f"Stub MQTT broker on 127.0.0.1:{broker.port}")
+    try:
+        threading.Event().wait()
+    except KeyboardInterrupt:
+        pass
+    broker.stop()
+    print(f"{broker.published} messages published, {broker.forwarded} forwarded")
+
+
+if __name__ == "__main__":
+    main()
@@ -4,11 +4,15 @@ from datetime import datetime
 import time
 import logging
 import sqlite3
+import argparse
 
-# Añadir el directorio raíz del proyecto al path de Python
+# Añadir el directorio raíz del proyecto y access/ al path de Python
 sys.path.insert(0, os.path.abspath(os.path.join(os.path.dirname(__file__), '..')))
+sys.path.insert(0, os.path.abspath(os.path.join(os.path.dirname(__file__), '..', 'access')))
 
-from app.database.sqlite_db import SQLiteDB
+from log_store import SQLiteDB
+from log_sync import LogSyncEngine, format_metrics
+from log_sink_stub import LogSinkServer
 
 # Configurar logging
 logging.basicConfig(level=logging.INFO)
@@ -29,8 +33,15 @@ def check_sqlite_logs():
         logger.error(f"Error verificando logs en SQLite: {e}")
         return []
 
-def test_log_sync():
-    """Probar la sincronización de logs"""
+def test_log_sync(count=3, url=None, fail_every=0, drop_ack_every=0, batch_rows=200):
+    """Probar la sincronización de logs (contra un servidor local de prueba si no se da --url)"""
+    sink = None
+    if url is None:
+        sink = LogSinkServer(0, fail_every=fail_every, drop_ack_every=drop_ack_every)
+        sink.start()
+        url = sink.url
+        logger.info(f"Servidor de prueba en {url}")
+
     # Verificar estado inicial
     logger.info("=== Estado inicial de los logs en SQLite ===")
     check_sqlite_logs()
@@ -38,9 +49,12 @@ def test_log_sync():
     # Crear algunos logs de prueba
     sqlite_db = SQLiteDB('instance/local_gate.db')
     
-    # Crear 3 logs de prueba
+    engine = LogSyncEngine(sqlite_db, url, batch_rows=batch_rows)
+    watermark_before = engine.watermark
+
+    # Crear los logs de prueba
     test_logs = []
-    for i in range(3):
+    for i in range(count):
         log_id = sqlite_db.create_access_log(
             plate_number=f"TEST{int(time.time())}-{i}",
             gate_id="EC:64:C9:AC:C9:A4",
@@ -48,30 +62,53 @@ def test_log_sync():
             confidence_score=0.95
         )
         test_logs.append(log_id)
-        logger.info(f"Creado log de prueba {i+1} con ID: {log_id}")
+        if count <= 10:
+            logger.info(f"Creado log de prueba {i+1} con ID: {log_id}")
     
     # Verificar que se crearon los logs
     logger.info("\n=== Estado después de crear logs ===")
-    check_sqlite_logs()
+    if count <= 10:
+        check_sqlite_logs()
+    logger.info(f"Métricas: {format_metrics(engine.metrics())}")
     
-    # Esperar a que ocurra la sincronización
-    logger.info("\nEsperando 30 segundos para que ocurra la sincronización...")
-    time.sleep(30)
+    # Sincronizar hasta vaciar la cola (sin esperas fijas)
+    t0 = time.perf_counter()
+    caught_up = engine.sync_until_idle(timeout=30)
+    logger.info(f"\nSincronización {'completa' if caught_up else 'INCOMPLETA'} en {time.perf_counter() - t0:.2f} s")
+    logger.info(f"Métricas: {format_metrics(engine.metrics())}")
     
     # Verificar estado final
     logger.info("\n=== Estado final de los logs ===")
-    final_logs = check_sqlite_logs()
+    final_logs = check_sqlite_logs() if count <= 10 else sqlite3.connect('instance/local_gate.db').execute(
+        'SELECT * FROM pending_logs').fetchall()
     
     # Verificar si los logs se sincronizaron
     synced_count = 0
     for log in final_logs:
-        if log[6] == 'synced':  # sync_status está en el índice 6
+        if log[0] in test_logs and log[6] == 'synced':  # sync_status está en el índice 6
             synced_count += 1
     
     logger.info(f"\nLogs sincronizados: {synced_count} de {len(test_logs)}")
+    assert synced_count == len(test_logs), "no se sincronizaron todos los logs"
+    assert engine.watermark >= max(test_logs) > watermark_before
+    if sink is not None:
+        stored = sum(1 for rec in sink.records.values() if int(rec["key"].split(":")[1]) in test_logs)
+        logger.info(f"Servidor: {stored} logs almacenados una sola vez, {sink.duplicates} duplicados descartados, "
+                    f"{sink.requests} peticiones")
+        assert stored == len(test_logs)
+        sink.shutdown()
+    engine.stop()
 
 if __name__ == "__main__":
-    test_log_sync()
+    parser = argparse.ArgumentParser(description='Prueba de sincronización de logs de acceso')
+    parser.add_argument('--count', type=int, default=3, help='Logs de prueba a crear')
+    parser.add_argument('--url', default=None, help='Endpoint real (por defecto, servidor local de prueba)')
+    parser.add_argument('--fail-every', type=int, default=0, help='El servidor de prueba falla cada N peticiones')
+    parser.add_argument('--drop-ack-every', type=int, default=0,
+                        help='El servidor de prueba guarda pero no responde cada N peticiones')
+    parser.add_argument('--batch-rows', type=int, default=200, help='Filas por lote')
+    args = parser.parse_args()
+    test_log_sync(args.count, args.url, args.fail_every, args.drop_ack_every, args.batch_rows)
     # conn = sqlite3.connect('instance/local_gate.db')
     # cursor = conn.execute('SELECT * FROM authorized_vehicles')
     # vehicles = cursor.fetchall()
@@ -0,0 +1,162 @@
+"""
+Latency bench for the MQTT-to-CAN actuator bridge (industrialNetwork/bridge/mqtt_can_bridge.py)
+
+Runs the bridge's message handler and MQTT loop against a local broker
+stand-in (mqtt_broker_stub.py). A non-blocking SOCK_SEQPACKET socket pair
+replaces the CAN_RAW socket: the bridge writes 16-byte struct can_frame
+records to one end, and this script reads them from the other and checks
+every command arrived with the right ID and data. Phases:
+1. --count commands at --rate/s, half of them carrying a publisher
+   timestamp, to gates 1 and 2 -> p50/p95/p99/max from MQTT receipt to send;
+2. the broker restarts (all connections dropped for --down seconds); the
+   bridge must reconnect, subscribe again and deliver the next commands;
+3. the CAN end stops reading: once the socket buffer is full, commands must
+   be dropped and counted without stalling the MQTT loop.
+"""
+import argparse
+import json
+import os
+import socket
+import struct
+import sys
+import threading
+import time
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+sys.path.insert(0, os.path.abspath(os.path.join(os.path.dirname(__file__), "..", "industrialNetwork", "bridge")))
+
+import paho.mqtt.client as mqtt  # noqa: E402
+
+import mqtt_can_bridge as mcb  # noqa: E402
+from mqtt_broker_stub import MqttBrokerStub  # noqa: E402
+
+GATES = {"1": 0x201, "2": 0x202}
+
+
+class CanEnd:
+    """Reads the frames the bridge sends; pause() stops reading so the socket buffer fills."""
+
+    def __init__(self, sock: socket.socket):
+        self.sock = sock
+        self.frames = []
+        self.reading = threading.Event()
+        self.reading.set()
+        threading.Thread(target=self._read_loop, daemon=True).start()
+
+    def _read_loop(self):
+        while True:
+            self.reading.wait()
+            try:
+                frame = self.sock.recv(16)
+            except OSError:
+                return
+            if not frame:
+                return
+            self.frames.append(struct.unpack("=IB3x8s", frame))
+
+    def pause(self):
+        self.reading.clear()
+
+
+def publish_commands(pub, count: int, rate: float, start: int = 0):
+    """Publish `count` commands to gates 1/2; returns the (CAN ID, data byte) each must produce."""
+    expected = []
+    for i in range(start, start + count):
+        gate = "1" if i % 2 == 0 else "2"
+        command = bool(i % 3)
+        obj = {"barrierCommand": command}
+        if i % 4 < 2:
+            obj["t"] = time.time()
+        pub.publish(f"gate/{gate}/actuators", json.dumps(obj), qos=1)
+        expected.append((GATES[gate], int(command)))
+        time.sleep(1.0 / rate)
+    return expected
+
+
+def wait_for(predicate, timeout: float) -> bool:
+    end = time.time() + timeout
+    while time.time() < end:
+        if predicate():
+            return True
+        time.sleep(0.01)
+    return predicate()
+
+
+def main():
+    parser = argparse.ArgumentParser(description="MQTT-to-CAN bridge latency bench against a local broker stand-in")
+    parser.add_argument("--count", type=int, default=2000, help="Commands in the latency phase")
+    parser.add_argument("--rate", type=float, default=200.0, help="Commands per second")
+    parser.add_argument("--down", type=float, default=2.0, help="Seconds the broker stays down when restarted")
+    args = parser.parse_args()
+
+    broker = MqttBrokerStub(0)
+    broker.start()
+    tx, rx = socket.socketpair(socket.AF_UNIX, socket.SOCK_SEQPACKET)
+    tx.setblocking(False)
+    can_end = CanEnd(rx)
+    bridge = mcb.ActuatorBridge(GATES, tx.send)
+
+    client = mqtt.Client(callback_api_version=mqtt.CallbackAPIVersion.VERSION2)
+    client.on_message = bridge.on_message
+    client.on_connect = lambda c, u, f, rc, p=None: c.subscribe(mcb.TOPIC_FILTER, qos=1)
+    client.connect("127.0.0.1", broker.port, 60)
+    stop_at = [float("inf")]
+    loop = threading.Thread(target=_serve_until, args=(client, bridge, stop_at), daemon=True)
+    loop.start()
+
+    pub = mqtt.Client(callback_api_version=mqtt.CallbackAPIVersion.VERSION2)
+    pub.reconnect_delay_set(0.1, 1.0)
+    pub.connect("127.0.0.1", broker.port, 60)
+    pub.loop_start()
+    assert wait_for(lambda: broker.subscriptions, 5.0), "bridge did not subscribe"
+
+    # 1. Latency
+    expected = publish_commands(pub, args.count, args.rate)
+    assert wait_for(lambda: len(can_end.frames) >= len(expected), 10.0), \
+        f"{len(can_end.frames)} of {len(expected)} commands reached the CAN end"
+    got = [(can_id, data[0]) for can_id, _, data in can_end.frames]
+    assert got == expected, "frames differ from the commands sent"
+    print(f"Phase 1: {len(expected)} commands at {args.rate:.0f}/s")
+    print(bridge.report())
+
+    # 2. Broker restart
+    broker.stop()
+    time.sleep(args.down)
+    broker.start()
+    assert wait_for(lambda: broker.subscriptions and pub.is_connected(), 10 * (1 + args.down)), \
+        "bridge did not reconnect and subscribe again"
+    before = len(can_end.frames)
+    expected = publish_commands(pub, 100, args.rate, start=args.count)
+    assert wait_for(lambda: len(can_end.frames) - before >= len(expected), 10.0), \
+        f"after the restart {len(can_end.frames) - before} of {len(expected)} commands reached the CAN end"
+    print(f"Phase 2: broker down {args.down:.1f} s, {bridge.reconnects} reconnect(s), "
+          f"{len(expected)} commands delivered afterwards")
+
+    # 3. Full TX queue
+    can_end.pause()
+    time.sleep(0.1)
+    sent_before = bridge.sent
+    t0 = time.perf_counter()
+    publish_commands(pub, 1000, 1000.0, start=args.count + 100)
+    assert wait_for(lambda: bridge.sent + bridge.dropped - sent_before >= 1000, 10.0), "the MQTT loop stalled"
+    print(f"Phase 3: CAN end not reading: {bridge.sent - sent_before} sent, {bridge.dropped} dropped, "
+          f"MQTT loop kept up ({time.perf_counter() - t0:.2f} s for 1000 commands)")
+    assert bridge.dropped > 0
+
+    stop_at[0] = 0.0
+    loop.join()
+    pub.loop_stop()
+    pub.disconnect()
+    client.disconnect()
+    broker.stop()
+    print(bridge.report())
+
+
+def _serve_until(client, bridge, stop_at):
+    """Bridge MQTT loop; serve() takes a fixed end time, so it runs in short rounds until stop_at[0]."""
+    while time.time() < stop_at[0]:
+        mcb.serve(client, bridge, min(stop_at[0], time.time() + 0.5), 3600.0)
+
+
+if __name__ == "__main__":
+    main()
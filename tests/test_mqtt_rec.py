@@ -1,6 +1,11 @@
+import os
+import sys
 import time
 import paho.mqtt.client as mqtt
 
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "industrialNetwork", "bridge"))
+from telemetry import decode_payload, format_record  # noqa: E402
+
 BROKER = "localhost"
 PORT = 1883
 USERNAME = "user"  # Replace with actual username
@@ -19,7 +24,7 @@ def on_connect(client, userdata, flags, rc, properties=None):
     client.subscribe(TOPIC_GATE_STATUS)
     client.subscribe(TOPIC_GATE_SYNC)
     client.subscribe(TOPIC_SERVER_RESPONSE)
-    client.subscribe(TOPIC_SENSOR_DATA)
+    client.subscribe(TOPIC_SENSOR_DATA + "/#")  # also matches gate/1/sensors itself
     client.subscribe(TOPIC_ACTUATORS)
     print(f"Subscribed to {TOPIC_SERVER_RESPONSE}")
     print(f"Subscribed to {TOPIC_GATE_ACCESS}")
@@ -29,7 +34,17 @@ def on_connect(client, userdata, flags, rc, properties=None):
     print(f"Subscribed to {TOPIC_ACTUATORS}")
 
 def on_message(client, userdata, msg):
-    print(f"Received message on {msg.topic}: {msg.payload.decode()}")
+    if msg.topic.startswith(TOPIC_SENSOR_DATA):
+        # Binary/CBOR telemetry from industrialNetwork/bridge/can_mqtt_bridge.py
+        try:
+            seq, ts, records = decode_payload(msg.payload)
+            print(f"Received {len(records)} signals on {msg.topic} (seq {seq}):")
+            for rec in records:
+                print(f"  {format_record(rec)}")
+            return
+        except ValueError:
+            pass
+    print(f"Received message on {msg.topic}: {msg.payload.decode(errors='replace')}")
 
 def main():
     client = mqtt.Client(callback_api_version=mqtt.CallbackAPIVersion.VERSION2)
@@ -1,3 +1,5 @@
+import os
+import sys
 import time
 import json
 import base64
@@ -18,6 +20,9 @@ TOPIC_SERVER_RESPONSE = "server/response/{gate_id}"
 USERNAME = "user"  # Replace with actual username
 PASSWORD = "user123"  # Replace with actual password
 
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "access"))
+from image_transport import encode_image  # noqa: E402
+
 def test_yolo_api(image_url):
     """Test the YOLO API directly"""
     try:
@@ -40,8 +45,8 @@ def test_yolo_api(image_url):
         print(f"Error testing YOLO API: {e}")
         return None
 
-def test_mqtt(image_url):
-    """Test sending image through MQTT"""
+def test_mqtt(image_url, fmt="binary"):
+    """Test sending image through MQTT (binary header + JPEG, or legacy base64 JSON)"""
     client = mqtt.Client()
     client.username_pw_set(USERNAME, PASSWORD)
 
@@ -53,10 +58,13 @@ def test_mqtt(image_url):
         response.raise_for_status()
         
         image_bytes = response.content
-        msg = base64.b64encode(image_bytes).decode('utf-8')
-        payload = json.dumps({"image": msg})
+        if fmt == "binary":
+            payload = encode_image(1, 0, image_bytes)
+        else:
+            msg = base64.b64encode(image_bytes).decode('utf-8')
+            payload = json.dumps({"image": msg})
         client.publish(TOPIC_GATE_ACCESS, payload)
-        print(f"Sent image through MQTT")
+        print(f"Sent image through MQTT ({fmt}, {len(payload)} bytes for a {len(image_bytes)}-byte image)")
         time.sleep(1)
     except Exception as e:
         print(f"Error in MQTT test: {e}")
@@ -68,6 +76,8 @@ def main():
     parser = argparse.ArgumentParser(description='Test ANPR system')
     parser.add_argument('--mode', choices=['mqtt', 'api', 'both'], default='both',
                       help='Test mode: mqtt, api, or both')
+    parser.add_argument('--format', choices=['binary', 'json'], default='binary',
+                      help='MQTT image payload: binary header + raw JPEG, or legacy base64 JSON')
     args = parser.parse_args()
 
     image_url = "https://external-content.duckduckgo.com/iu/?u=https%3A%2F%2Fwww.articulo14.es%2Fmain-files%2Fuploads%2F2025%2F03%2Fmatricula-espana-162x95.jpg&f=1&nofb=1&ipt=aa1d633da11e464a5c28d0e3f10dba0a3a33f415e7b96c48609bdbafb42841d1"
@@ -78,7 +88,7 @@ def main():
 
     if args.mode in ['mqtt', 'both']:
         print("\n=== Testing MQTT ===")
-        test_mqtt(image_url)
+        test_mqtt(image_url, args.format)
 
 if __name__ == "__main__":
     main()
\ No newline at end of file